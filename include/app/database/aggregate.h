@@ -0,0 +1,106 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stddef.h>
+	#include <stdint.h>
+#endif
+
+#include "app/database/database.h"
+#include "app/database/operators.h"
+
+// GROUP_BY: one row per combination of values of the group columns that occurs in t,
+// with those values followed by one column per aggregate.
+// Every result is a val_t: SUM keeps the low 32 bits, and AVG rounds down the full sum over the count.
+// t is not consumed; NULL on failure.
+
+// one aggregate of a GROUP_BY: agg over column col, which AGG_COUNT ignores
+typedef struct {
+	agg_op_t agg;
+	size_t col;
+} aggregate_t;
+
+// Group columns whose domains multiply to at most this are grouped by direct-indexed arrays.
+// Beyond it, the arrays would be too sparse to scan and fall out of cache, so groups go into a hash table.
+#define GROUP_DIRECT_MAX_GROUPS (1 << 16)
+
+// Partial aggregates of some of the chunks of a table.
+// Each chunk is aggregated on its own, a column at a time: first the group of every row, then every aggregate.
+// Partials of the same GROUP_BY can be merged, so chunks can be aggregated on separate threads.
+typedef struct {
+	const size_t *group_cols;
+	size_t num_group_cols;
+	const aggregate_t *aggs;
+	size_t num_aggs;
+
+	// Direct: group g is the combination of values with g = (v_0 * domains[1] + v_1) * domains[2] + ...,
+	// and every possible group has its place.
+	// Otherwise, groups are numbered as they first appear, and found through an open-addressing hash table.
+	const size_t *domains;
+	size_t num_groups;
+	size_t cap;
+	// Group g has its count at vals[g * width], aggregate a at vals[g * width + 1 + a], which AGG_COUNT leaves unused,
+	// and, if hashed, the value of group column k at vals[g * width + 1 + num_aggs + k].
+	// So a row finds everything of its group on the same cache line or two.
+	size_t width;
+	uint64_t *vals;
+
+	uint32_t *slots;   // g + 1 for group g, 0 for an empty slot; at most half full
+	size_t num_slots;  // a power of 2
+
+	// scratch for one chunk
+	uint32_t *gids;    // the group of every row
+	val_t **cols;      // the chunk's group columns
+	val_t *key;        // the group values of one row
+} group_partial_t;
+
+// Prepares an empty partial for grouping the chunks of t, with direct arrays if domains is not NULL,
+// where domains[k] bounds the values of column group_cols[k]. group_cols, aggs and domains must outlive it.
+// Returns 0 on success and -1 on failure.
+int group_partial_init(group_partial_t *gp, col_table_t *t, const size_t *group_cols, size_t num_group_cols,
+                       const aggregate_t *aggs, size_t num_aggs, const size_t *domains);
+void group_partial_free(group_partial_t *gp);
+// adds chunk chunk_no of t to gp; returns 0 on success and -1 on failure
+int group_partial_chunk(group_partial_t *gp, col_table_t *t, size_t chunk_no);
+// adds src to dst, which must be prepared alike; returns 0 on success and -1 on failure
+int group_partial_merge(group_partial_t *dst, group_partial_t *src);
+// The groups of gp, as a table in chunks of chunk_size; direct groups come out in order of their values.
+col_table_t *group_partial_table(group_partial_t *gp, size_t chunk_size);
+
+// Whether GROUP_BY on group_cols of t takes direct arrays, with domains[k] set to bound column group_cols[k].
+bool group_direct_domains(col_table_t *t, const size_t *group_cols, size_t num_group_cols, size_t *domains);
+
+// GROUP_BY, one chunk after the other into a single partial
+col_table_t *group_by(col_table_t *t, const size_t *group_cols, size_t num_group_cols, const aggregate_t *aggs, size_t num_aggs);
+// GROUP_BY on par_threads threads (see parallel.h), which claim chunks one at a time into partials of their own,
+// merged at the end
+col_table_t *parallel_group_by(col_table_t *t, const size_t *group_cols, size_t num_group_cols, const aggregate_t *aggs, size_t num_aggs);
+
+// DISTINCT: one row per combination of values of cols that occurs in t, with just those columns.
+// There must be at least one column. t is not consumed; NULL on failure.
+
+// Columns whose domains multiply to at most this, or to at most DISTINCT_BITMAP_BITS_PER_ROW bits per row of t,
+// are deduplicated with one bit per possible combination in a bitmap that is filled in one scan;
+// the result is then sorted on column 0.
+// Setting a bit is far cheaper than a hash lookup even out of cache, and 64 bits per row are only 8 bytes,
+// less than a hashed group takes.
+#define DISTINCT_BITMAP_MAX_VALUES (1 << 24)
+#define DISTINCT_BITMAP_BITS_PER_ROW 64
+
+// DISTINCT through the hash table of a GROUP_BY, in order of first occurrence
+col_table_t *hash_distinct(col_table_t *t, const size_t *cols, size_t num_cols);
+// DISTINCT with the bitmap if the domains of cols are small enough, and hash_distinct otherwise
+col_table_t *distinct(col_table_t *t, const size_t *cols, size_t num_cols);
+
+// Ungrouped aggregates over every row of column col of t, with the results of poslist_aggregate,
+// so unlike GROUP_BY, AGG_SUM is the full 64-bit sum. t is not consumed.
+// Each aggregate has a kernel of its own, which keeps several independent accumulators
+// so that no value waits on the one before it, with vector kernels in -DDB_SIMD builds (see simd.h).
+uint64_t column_reduce(col_table_t *t, size_t col, agg_op_t agg);
+// column_reduce on up to par_threads threads (see parallel.h), each over a contiguous range of chunks,
+// whose partial results are combined at the end; small tables take fewer threads
+uint64_t parallel_column_reduce(col_table_t *t, size_t col, agg_op_t agg);
+
+#endif
@@ -18,6 +18,9 @@ typedef struct {
 	bit_vec_t* bit_vec;
 } bit_vec_iter_t;
 
+// bits per bit_unit_t; bit i of a bit_vec_t is bit i % BV_UNIT_BITS of data[i / BV_UNIT_BITS]
+#define BV_UNIT_BITS (sizeof(bit_unit_t) * 8)
+
 void bv_init(bit_vec_t*, size_t n_bits);
 void bv_free(bit_vec_t* bv);
 void bv_reset(bit_vec_t* bv);
@@ -28,6 +31,16 @@ void bv_iter_set_rest(bit_vec_iter_t* bv, bit_t val);
 void bv_iter_skip(bit_vec_iter_t* it, unsigned long n_bits);
 void bv_test();
 
+// word-at-a-time operations; dst and src must have the same n_bits
+void bv_and(bit_vec_t* dst, const bit_vec_t* src);
+void bv_or(bit_vec_t* dst, const bit_vec_t* src);
+size_t bv_count(const bit_vec_t* bv);
+
+// number of bit_units holding n_bits bits
+static inline __attribute__((always_inline)) size_t bv_num_units(size_t n_bits) {
+	return (n_bits + BV_UNIT_BITS - 1) / BV_UNIT_BITS;
+}
+
 static inline __attribute__((always_inline)) void bv_iter_next(bit_vec_iter_t* it) {
 	--it->n_bits_left;
 	it->bit_mask <<= 1;
@@ -44,8 +44,8 @@
 
 #include "app/database/my_malloc.h"
 #define NEW(typ)  ((typ *) my_malloc(sizeof(typ)))
-#define NEWA(typ,size) ((typ *) my_malloc(sizeof(typ) * size))
-#define NEWPA(typ,size) ((typ **) my_malloc(sizeof(typ*) * size))
+#define NEWA(typ,size) ((typ *) my_malloc(sizeof(typ) * (size)))
+#define NEWPA(typ,size) ((typ **) my_malloc(sizeof(typ*) * (size)))
 
 #define MALLOC_NO_RET(pointer, mes) \
 	do { \
@@ -0,0 +1,52 @@
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include "app/database/database.h"
+
+// Row cursors: a walk down one column of a table, keeping the current chunk and a pointer into the column,
+// so stepping to the next row costs no division.
+
+static inline __attribute__((always_inline)) void
+compute_offset(size_t chunk_size, size_t row,
+			   size_t *chunk_no, size_t *chunk_offset) {
+	*chunk_no     = row / chunk_size;
+	*chunk_offset = row % chunk_size;
+}
+
+static inline __attribute__((always_inline)) void
+load_row(col_table_t *table, size_t chunk_size, size_t row, size_t column,
+		 size_t *chunk_no, size_t *chunk_offset, table_chunk_t *chunk, val_t **chunk_col, val_t *val) {
+
+	// chunk_no and chunk_offset are always set such that they point to the row'th row.
+	// If chunk is provided, the chunk is set.
+	// If col is provided, col and val are set based on column.
+	// col points at the row'th row, so load_next_row can continue from any offset.
+
+	compute_offset(chunk_size, row, chunk_no, chunk_offset);
+	if (*chunk_no < table->num_chunks) {
+		*chunk = *table->chunks[*chunk_no];
+		*chunk_col = chunk->columns[column]->data + *chunk_offset;
+		*val = **chunk_col;
+	}
+}
+
+static inline __attribute__((always_inline)) void
+load_next_row(col_table_t *table, size_t chunk_size, size_t column,
+			  size_t *chunk_no, size_t *chunk_offset, table_chunk_t *chunk, val_t **col, val_t *val) {
+	++*chunk_offset;
+	if (__builtin_expect(*chunk_offset < chunk_size, 1)) {
+		++*col;
+		*val = **col;
+	} else {
+		// reset chunk offset and move to next chunk
+		*chunk_offset = 0;
+		++*chunk_no;
+		if (__builtin_expect(*chunk_no < table->num_chunks, 1)) {
+			*chunk = *table->chunks[*chunk_no];
+			*col = chunk->columns[column]->data;
+			*val = **col;
+		}
+	}
+}
+
+#endif
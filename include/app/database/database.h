@@ -1,6 +1,8 @@
 #ifndef __DATABASE_H__
 #define __DATABASE_H__
 
+#include <stdbool.h>
+
 #include "common.h"
 
 typedef enum table_type
@@ -29,24 +31,51 @@ typedef struct row_table {
 
 typedef uint32_t val_t;
 
+// A zone map bounds the values of a column chunk: if has_zone, every value in use lies in [min, max].
+// The bounds may be loose, but code that writes data must keep them or clear has_zone.
 typedef struct column_chunk {
 	size_t chunk_size;
 	val_t *data;
+	bool has_zone;
+	val_t min;
+	val_t max;
 } column_chunk_t;
 
 typedef struct table_chunk {
 	column_chunk_t ** columns;
 } table_chunk_t;
 
+// sorted_col is a column the rows are known to be in ascending order of, or TABLE_UNSORTED.
+// Sorts set it, operators that keep the order of their input pass it on,
+// and code that writes rows must clear it unless it keeps them in order.
 typedef struct col_table {
 	size_t num_chunks;
 	size_t num_cols;
 	size_t num_rows;
 	table_chunk_t ** chunks;
+	size_t sorted_col;
 } col_table_t;
 
+#define TABLE_UNSORTED ((size_t) -1)
+
 typedef col_table_t* (*op_implementation_t) ();
 
+// A row's position as (chunk_no, chunk_offset) packed into one word,
+// so gathering a row costs no division.
+typedef uint64_t row_loc_t;
+#define ROW_LOC(chunk_no, chunk_offset) ((((row_loc_t) (chunk_no)) << 32) | (row_loc_t) (chunk_offset))
+#define ROW_LOC_CHUNK(loc) ((size_t) ((loc) >> 32))
+#define ROW_LOC_OFFSET(loc) ((size_t) ((loc) & 0xFFFFFFFF))
+
+// A position list (selection vector): the rows of table that passed a selection, by location, in order.
+// The list only references table, which must stay alive until the list is freed,
+// so operators on the list gather just the columns they use.
+typedef struct pos_list {
+	col_table_t *table;
+	size_t num_rows;
+	row_loc_t *locs;
+} pos_list_t;
+
 void print_table_info (col_table_t *t);
 col_table_t *create_col_table (size_t num_chunks, size_t chunk_size, size_t num_cols, unsigned int domain_size);
 void free_col_table (col_table_t *t);
@@ -54,11 +83,22 @@ column_chunk_t *create_col_chunk(size_t chunksize);
 void free_table_chunk(table_chunk_t *tc, size_t num_cols);
 void free_col_chunk (column_chunk_t *c);
 size_t get_chunk_size(col_table_t *t);
+size_t get_chunk_rows(col_table_t *t, size_t chunk_no);
+table_chunk_t *create_table_chunk(size_t chunk_size, size_t num_cols);
 col_table_t *copy_col_table (col_table_t *in);
 void copy_col_table_noalloc(col_table_t* in, col_table_t* out);
 col_table_t *create_col_table_like (col_table_t *in);
+col_table_t *create_col_table_empty (size_t num_rows, size_t chunk_size, size_t num_cols);
 void copy_table_chunk(table_chunk_t in_chunk, table_chunk_t out_chunk, size_t num_cols);
 table_chunk_t new_copy_table_chunk(table_chunk_t in_chunk, size_t num_cols);
+void gather_rows(col_table_t *in, row_loc_t *locs, size_t num_locs, col_table_t *out);
+void gather_cols(col_table_t *in, const size_t *cols, size_t num_cols, row_loc_t *locs, size_t num_locs, col_table_t *out, size_t out_col);
+void copy_rows(col_table_t *in, size_t in_row, col_table_t *out, size_t out_row, size_t num_rows);
+void copy_cols(col_table_t *in, const size_t *cols, size_t num_cols, size_t in_row, col_table_t *out, size_t out_row, size_t num_rows);
+size_t projected_sorted_col(size_t sorted_col, const size_t *cols, size_t num_cols);
+void set_col_chunk_zone(column_chunk_t *c, size_t num_rows);
+void set_zone_maps(col_table_t *t);
+size_t col_domain_size(col_table_t *t, size_t col);
 void print_db(col_table_t* db);
 void print_chunk(table_chunk_t chunk, size_t chunk_start, size_t chunk_size, size_t num_cols);
 
@@ -0,0 +1,27 @@
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+// External sort: Linux only, since it needs files and mmap.
+#ifndef __NAUTILUS__
+
+#include <stddef.h>
+
+#include "app/database/database.h"
+
+// Receives the sorted rows in order, one block at a time:
+// cols[col][0:num_rows] are the values of column col. The buffers are reused after the call returns.
+typedef void (*ext_consumer_t)(void *arg, val_t **cols, size_t num_rows);
+
+// Sorts in on col, using about mem_budget bytes on top of the input:
+// groups of chunks are sorted in memory and written to run files in tmp_dir (TMPDIR or /tmp if NULL),
+// then the runs are merged and passed to consumer.
+// Each group's input chunks are freed once they are spilled, and in is consumed even on failure.
+// Returns 0 on success and -1 on failure.
+int ext_sort(col_table_t *in, size_t col, size_t mem_budget, const char *tmp_dir, ext_consumer_t consumer, void *arg);
+
+// ext_sort into a new table with the chunk size of in; NULL on failure.
+col_table_t *externalsort(col_table_t *in, size_t col, size_t mem_budget);
+
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stddef.h>
+#endif
+
+#include "app/database/database.h"
+
+// Equi-joins of build and probe on build[build_col] = probe[probe_col]:
+// every pair of matching rows becomes a row of a new table with the chunk size of probe,
+// with the columns of build followed by the columns of probe.
+// Both inputs are consumed, and each must have fewer than 2^32 rows.
+
+// JOIN by radix hash join: the keys of both sides are hashed and partitioned on the top bits of the hash,
+// in passes of radix_sort_pairs, until a build partition's hash table fits in L2;
+// then each partition's hash table is built and probed while it stays there.
+// The result is grouped by partition, and in probe order within one.
+col_table_t *radix_hash_join(col_table_t *build, size_t build_col, col_table_t *probe, size_t probe_col);
+
+// JOIN by sort-merge join: each side not already sorted on its key is sorted, with the default sort
+// if its keys are small enough for counting and with radixsort otherwise, and then both are merged.
+// The result is in key order, and sorted on build_col.
+col_table_t *sortmerge_join(col_table_t *build, size_t build_col, col_table_t *probe, size_t probe_col);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef LOSERTREE_H
+#define LOSERTREE_H
+
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stdint.h>
+	#include <stddef.h>
+#endif
+
+// Tournament tree of losers over k sorted runs.
+// Each run is represented by the key of its current head;
+// an exhausted run has key LT_KEY_DONE, which loses to everything.
+// Keys must be distinct (except for LT_KEY_DONE), eg. by packing the run number into the low bits.
+typedef uint64_t lt_key_t;
+#define LT_KEY_DONE UINT64_MAX
+
+typedef struct {
+	size_t k;       // number of leaves, a power of two
+	size_t *tree;   // tree[0] is the winner, tree[node] is the loser at node
+	size_t *winners;// scratch for lt_build
+	lt_key_t *keys; // keys[run] is the head of run
+} loser_tree_t;
+
+void lt_init(loser_tree_t *lt, size_t num_runs);
+void lt_free(loser_tree_t *lt);
+void lt_build(loser_tree_t *lt);
+
+static inline __attribute__((always_inline)) size_t lt_winner(loser_tree_t *lt) {
+	return lt->tree[0];
+}
+
+// the winner's run has a new head (key); play it back up to the root
+static inline __attribute__((always_inline)) void lt_replay(loser_tree_t *lt, lt_key_t key) {
+	size_t winner = lt->tree[0];
+	lt->keys[winner] = key;
+	for(size_t node = (winner + lt->k) >> 1; node > 0; node >>= 1) {
+		size_t loser = lt->tree[node];
+		if(lt->keys[loser] < lt->keys[winner]) {
+			lt->tree[node] = winner;
+			winner = loser;
+		}
+	}
+	lt->tree[0] = winner;
+}
+
+#endif
@@ -14,10 +14,18 @@ typedef enum operator {
 	SELECTION_ATT,
 	PROJECTION,
 	SORT,
+	MULTI_SORT,
+	TOPK,
+	SELECTION_PRED,
+	FILTER,
+	SELECT_PROJECT,
+	JOIN,
+	GROUP_BY,
+	DISTINCT,
 	NUM_OPS
 } operator_t;
 
-#define MAX_IMPL 5
+#define MAX_IMPL 16
 
 typedef struct op_implementation_info {
 	operator_t op;
@@ -31,17 +39,126 @@ extern op_implementation_info_t impl_infos[];
 extern op_implementation_t default_impls[];
 extern const char * op_names[];
 
-/*
-src/app/database/operators.c:1280:1: error: conflicting types for ‘check_sorted’
- check_sorted(col_table_t *result, size_t sort_col, size_t domain_size, col_table_t *copy) {
- ^~~~~~~~~~~~
-In file included from src/app/database/operators.c:15:
-include/app/database/operators.h:34:6: note: previous declaration of ‘check_sorted’ was here
- bool check_sorted(col_table_t *result, size_t col, size_t domain_size, col_table_t *copy);
-      ^~~~~~~~~~~~
-*/
-//bool check_sorted(col_table_t *result, size_t col, size_t domain_size, col_table_t *copy);
+// comparison of a selection predicate: col <cmp> val or col_a <cmp> col_b
+typedef enum {
+	CMP_EQ = 0,
+	CMP_NE,
+	CMP_LT,
+	CMP_LE,
+	CMP_GT,
+	CMP_GE,
+	NUM_CMPS
+} cmp_op_t;
+
+extern const char *cmp_op_names[];
+
+// x <cmp> y; selection kernels are stamped out once per comparison with these,
+// so the comparison is a compile time constant in every loop
+#define CMP_EQ_OP(x, y) ((x) == (y))
+#define CMP_NE_OP(x, y) ((x) != (y))
+#define CMP_LT_OP(x, y) ((x) <  (y))
+#define CMP_LE_OP(x, y) ((x) <= (y))
+#define CMP_GT_OP(x, y) ((x) >  (y))
+#define CMP_GE_OP(x, y) ((x) >= (y))
+
+// predicate of a SELECTION_PRED on one column
+typedef enum {
+	PRED_CMP = 0, // col <cmp> val
+	PRED_BETWEEN, // lo <= col <= hi
+	PRED_IN,      // col is one of vals[0:num_vals]
+	NUM_PRED_KINDS
+} pred_kind_t;
+
+typedef struct {
+	pred_kind_t kind;
+	cmp_op_t cmp;
+	val_t val;
+	val_t lo;
+	val_t hi;
+	const val_t *vals;
+	size_t num_vals;
+} predicate_t;
+
+// an aggregate over the values of one column
+typedef enum {
+	AGG_COUNT = 0,
+	AGG_SUM,
+	AGG_MIN, // the largest val_t for no rows
+	AGG_MAX, // 0 for no rows
+	AGG_AVG, // rounded down, 0 for no rows
+	NUM_AGGS
+} agg_op_t;
+
+// acc = acc <agg> val, where AGG_AVG accumulates the sum
+#define AGG_SUM_OP(acc, val) ((acc) += (val))
+#define AGG_MIN_OP(acc, val) ((acc) = MIN((acc), (val)))
+#define AGG_MAX_OP(acc, val) ((acc) = MAX((acc), (val)))
+
+// Late materialization: a selection returns a position list into its input instead of a copy of every column,
+// and the operators on the list gather only the columns they use.
+// The rows of t where pred holds on col; t is not consumed. NULL on failure.
+pos_list_t *poslist_selection_pred(col_table_t *t, size_t col, const predicate_t *pred);
+void free_pos_list(pos_list_t *pl);
+// PROJECTION of the listed rows onto columns pos[0:num_proj], as a new table with the chunk size of pl->table
+col_table_t *poslist_projection(pos_list_t *pl, size_t *pos, size_t num_proj);
+// the listed rows sorted on col (stable), projected onto columns pos[0:num_proj]; col need not be one of them
+col_table_t *poslist_sort(pos_list_t *pl, size_t col, size_t *pos, size_t num_proj);
+// agg over column col of the listed rows
+uint64_t poslist_aggregate(pos_list_t *pl, size_t col, agg_op_t agg);
+
+// SELECTION_CONST and SELECTION_PRED switching between the rowise, colwise and bitmap strategies as they scan,
+// after whichever a cost model calibrated on the first call says is cheapest at the selectivity seen so far
+col_table_t *adaptive_selection_const(col_table_t *t, size_t col, val_t val);
+col_table_t *adaptive_selection_pred(col_table_t *t, size_t col, const predicate_t *pred);
+// calibrates that cost model unless a call already has, so that no timed call pays for it; it allocates from my_malloc
+void adaptive_selection_calibrate(void);
+
+// SELECT_PROJECT: the rows of t where pred holds on col, projected onto columns pos[0:num_proj]; t is consumed.
+// As the default SELECTION_PRED followed by the default PROJECTION, which copies every column first.
+col_table_t *pipeline_select_project(col_table_t *t, size_t col, const predicate_t *pred, size_t *pos, size_t num_proj);
+
+// (key, row) pairs for sorts which only move the key column around.
+// The key is in the upper half, so comparing two pairs compares their keys first,
+// and pairs with equal keys stay in their original row order.
+typedef uint64_t sort_pair_t;
+#define SORT_PAIR(key, row) ((((sort_pair_t) (key)) << 32) | (sort_pair_t) (row))
+#define SORT_PAIR_KEY(pair) ((val_t) ((pair) >> 32))
+#define SORT_PAIR_ROW(pair) ((size_t) ((pair) & 0xFFFFFFFF))
+
+sort_pair_t *radix_sort_pairs(sort_pair_t *pairs, sort_pair_t *tmp, size_t n, unsigned lo_bit, unsigned hi_bit);
+
+typedef enum {
+	SORT_ASC = 0,
+	SORT_DESC,
+} sort_dir_t;
+
+// one ORDER BY term
+typedef struct {
+	size_t col;
+	sort_dir_t dir;
+} sort_key_t;
+
+bool check_sorted(col_table_t *result, size_t col, size_t domain_size, col_table_t *copy);
+size_t sorted_run_end(col_table_t *table, size_t start_row, size_t stop_row, size_t sort_col);
+bool check_multikey_sorted(col_table_t *result, const sort_key_t *keys, size_t num_keys, col_table_t *copy);
 col_table_t* countingmergesort(col_table_t *in, size_t col, size_t domain_size);
 col_table_t* countingmergesort2(col_table_t *in, size_t col, size_t domain_size);
+// uses par_threads threads (see parallel.h)
+col_table_t* parallelcountingmergesort(col_table_t *in, size_t col, size_t domain_size);
+// handles the full range of val_t; domain_size is ignored
+col_table_t* radixsort(col_table_t *in, size_t col, size_t domain_size);
+// uses par_threads threads (see parallel.h)
+col_table_t* globalcountingsort(col_table_t *in, size_t col, size_t domain_size);
+col_table_t* countingkwaymergesort(col_table_t *in, size_t col, size_t domain_size);
+// moves only (key, row) pairs while merging; drop-in for countingmergesort
+col_table_t* latecountingmergesort(col_table_t *in, size_t col, size_t domain_size);
+// ORDER BY keys[0].col keys[0].dir, keys[1].col keys[1].dir, ...; stable
+col_table_t* multikeysort(col_table_t *in, const sort_key_t *keys, size_t num_keys);
+// returns sorted input as is and merges only natural runs otherwise; domain_size is ignored
+col_table_t* adaptivesort(col_table_t *in, size_t col, size_t domain_size);
+// the default sort: globalcountingsort when domain_size is small next to the table, countingmergesort otherwise
+col_table_t* autocountingsort(col_table_t *in, size_t col, size_t domain_size);
+// ORDER BY col LIMIT k; domain_size may be 0 if unknown
+col_table_t* topk(col_table_t *in, size_t col, size_t domain_size, size_t k);
 
 #endif
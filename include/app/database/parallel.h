@@ -0,0 +1,31 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stddef.h>
+#endif
+
+// Upper bound on the number of workers in one par_run().
+// Callers keep per-thread scratch in arrays of this size.
+#define MAX_THREADS 64
+
+// fn(arg, thread_no, num_threads) is run once by every worker.
+typedef void (*par_fn_t)(void *arg, size_t thread_no, size_t num_threads);
+
+// Number of threads used by the operators which take no explicit thread count.
+extern size_t par_threads;
+
+void par_set_threads(size_t num_threads);
+size_t par_num_cpus();
+void par_run(size_t num_threads, par_fn_t fn, void *arg);
+
+static inline __attribute__((always_inline)) void
+par_range(size_t n, size_t thread_no, size_t num_threads, size_t *start, size_t *stop) {
+	// splits [0:n] into num_threads contiguous pieces which differ in size by at most one
+	*start = n *  thread_no      / num_threads;
+	*stop  = n * (thread_no + 1) / num_threads;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stddef.h>
+#endif
+
+#include "app/database/common.h"
+#include "app/database/database.h"
+#include "app/database/operators.h"
+#include "app/database/bitvec.h"
+
+// Two-phase selection: predicates are evaluated over whole column chunks into a bitmap,
+// then every column is compacted from the bitmap in one pass.
+// Until sel_compact, any number of predicates can be combined into the same bitmap.
+
+// One bit per row of a table: bit i of chunks[c] is row i of chunk c.
+// chunks[c].n_bits is the number of rows of chunk c, so only the last one can be shorter than chunk_size.
+typedef struct {
+	size_t num_chunks;
+	size_t chunk_size;
+	bit_vec_t *chunks;
+} sel_bitmap_t;
+
+// how a predicate's result is combined with what the bitmap already holds
+typedef enum {
+	SEL_SET = 0, // overwrite
+	SEL_AND,
+	SEL_OR,
+} sel_combine_t;
+
+// IN-lists whose largest value is at most this are looked up in a bitmap of their values
+#define PRED_LOOKUP_MAX_VAL (1 << 16)
+
+// how a prepared predicate is evaluated
+typedef enum {
+	PRED_FORM_CMP = 0,   // col <cmp> val
+	PRED_FORM_BETWEEN,   // col - lo <= range, which is false below lo since val_t is unsigned
+	PRED_FORM_IN_LOOKUP, // bit col of lookup
+	PRED_FORM_IN_LIST,   // col == vals[0] || col == vals[1] || ...
+	NUM_PRED_FORMS
+} pred_form_t;
+
+// a predicate_t in the form its kernels evaluate
+typedef struct {
+	pred_form_t form;
+	cmp_op_t cmp;
+	val_t val;
+	val_t lo;
+	val_t range;
+	bit_vec_t lookup; // lookup_max + 2 bits, so lookup_max + 1 stands for every larger value
+	val_t lookup_max;
+	const val_t *vals;
+	size_t num_vals;
+} pred_args_t;
+
+// Returns 0 on success and -1 on failure; pred->vals must outlive args.
+int pred_prepare(const predicate_t *pred, pred_args_t *args);
+void pred_release(pred_args_t *args);
+
+static inline __attribute__((always_inline)) bool
+pred_in_lookup(val_t x, const pred_args_t *p) {
+	val_t bit = MIN(x, p->lookup_max + 1);
+	return (p->lookup.data[bit / BV_UNIT_BITS] >> (bit % BV_UNIT_BITS)) & 1;
+}
+
+static inline __attribute__((always_inline)) bool
+pred_in_list(val_t x, const pred_args_t *p) {
+	bool match = false;
+	for(size_t k = 0; k < p->num_vals; ++k) {
+		match |= x == p->vals[k];
+	}
+	return match;
+}
+
+// x matches a prepared predicate p, where y is the other operand of a comparison.
+// Kernels are stamped out once per form with these, so no loop switches on the predicate.
+#define PRED_EQ_MATCH(x, y, p) CMP_EQ_OP(x, y)
+#define PRED_NE_MATCH(x, y, p) CMP_NE_OP(x, y)
+#define PRED_LT_MATCH(x, y, p) CMP_LT_OP(x, y)
+#define PRED_LE_MATCH(x, y, p) CMP_LE_OP(x, y)
+#define PRED_GT_MATCH(x, y, p) CMP_GT_OP(x, y)
+#define PRED_GE_MATCH(x, y, p) CMP_GE_OP(x, y)
+#define PRED_BETWEEN_MATCH(x, y, p) ((val_t) ((x) - (p)->lo) <= (p)->range)
+#define PRED_IN_LOOKUP_MATCH(x, y, p) pred_in_lookup((x), (p))
+#define PRED_IN_LIST_MATCH(x, y, p) pred_in_list((x), (p))
+
+// Which rows of a chunk match, as far as its zone maps tell.
+typedef enum {
+	ZONE_NONE = 0, // no row matches, so the chunk is skipped
+	ZONE_SOME,     // the chunk has to be scanned
+	ZONE_ALL,      // every row matches, so the chunk is copied whole
+} zone_match_t;
+
+// for values in [min, max] against p
+zone_match_t zone_match_pred(const pred_args_t *p, val_t min, val_t max);
+// for a in [a_min, a_max] <cmp> b in [b_min, b_max]
+zone_match_t zone_match_cmp(cmp_op_t cmp, val_t a_min, val_t a_max, val_t b_min, val_t b_max);
+// for a chunk's column a against p, or against column b with p->cmp if att;
+// ZONE_SOME if a column involved has no zone map
+zone_match_t chunk_zone_match(const pred_args_t *p, const column_chunk_t *a, const column_chunk_t *b, bool att);
+
+// a bitmap for the rows of t with no row selected
+sel_bitmap_t *sel_bitmap_create(col_table_t *t);
+void sel_bitmap_free(sel_bitmap_t *bm);
+// number of selected rows
+size_t sel_bitmap_count(sel_bitmap_t *bm);
+// dst = dst & src and dst = dst | src; both must be for the same table
+void sel_bitmap_and(sel_bitmap_t *dst, sel_bitmap_t *src);
+void sel_bitmap_or(sel_bitmap_t *dst, sel_bitmap_t *src);
+
+// evaluates t[col] <cmp> val into bm
+void sel_cmp_const(col_table_t *t, size_t col, cmp_op_t cmp, val_t val, sel_bitmap_t *bm, sel_combine_t combine);
+// evaluates pred on t[col] into bm; returns 0 on success and -1 on failure
+int sel_pred(col_table_t *t, size_t col, const predicate_t *pred, sel_bitmap_t *bm, sel_combine_t combine);
+// evaluates t[col_a] <cmp> t[col_b] into bm
+void sel_cmp_att(col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b, sel_bitmap_t *bm, sel_combine_t combine);
+
+// The rows of t selected in bm, in order, in a new table with the chunk size of t and its zone maps set.
+// t is consumed, bm is not.
+col_table_t *sel_compact(col_table_t *t, sel_bitmap_t *bm);
+
+// One chunk at a time, with bv as scratch space for chunk_size bits:
+// the number of rows of chunk chunk_no of t where p holds on col,
+size_t sel_count_chunk(col_table_t *t, size_t chunk_no, size_t col, const pred_args_t *p, bit_vec_t *bv);
+// and those rows appended to out, whose chunks are full but the last one, which is used up to out->num_rows.
+// out gets new chunks as needed, so its chunks array needs room for as many as t has; returns the number of rows.
+size_t sel_append_chunk(col_table_t *t, size_t chunk_no, size_t col, const pred_args_t *p, bit_vec_t *bv, col_table_t *out);
+
+// When t is sorted on col (see database.h) and pred is a comparison or BETWEEN, the rows where pred holds
+// are one range of t, or two for <>, found by binary search: a table of them, copied a slice at a time,
+// or t itself cut down to them if they are one range from a chunk boundary, with t consumed.
+// Otherwise NULL, with t left alone. Every SELECTION_PRED tries this first, as do the bitmap and adaptive SELECTION_CONST.
+col_table_t *sorted_selection(col_table_t *t, size_t col, const predicate_t *pred);
+
+// SELECTION_CONST as sel_cmp_const followed by sel_compact
+col_table_t *bitmap_selection_const(col_table_t *t, size_t col, val_t val);
+// SELECTION_ATT as sel_cmp_att followed by sel_compact
+col_table_t *bitmap_selection_att(col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b);
+// SELECTION_PRED as sel_pred followed by sel_compact
+col_table_t *bitmap_selection_pred(col_table_t *t, size_t col, const predicate_t *pred);
+
+// SELECTION_PRED on num_threads threads, which claim input chunks one at a time and compact them into chunks of their own.
+// The result has the rows in input order if keep_order, and grouped by thread otherwise, which copies less.
+col_table_t *morsel_selection_pred(col_table_t *t, size_t col, const predicate_t *pred, size_t num_threads, bool keep_order);
+// morsel_selection_pred on par_threads threads (see parallel.h), keeping the order
+col_table_t *parallel_selection_pred(col_table_t *t, size_t col, const predicate_t *pred);
+
+// A boolean expression of predicates on the columns of a table
+typedef enum {
+	FILTER_PRED = 0, // pred on column col
+	FILTER_AND,      // every one of children[0:num_children], true if there are none
+	FILTER_OR,       // any of children[0:num_children], false if there are none
+} filter_kind_t;
+
+typedef struct filter_expr {
+	filter_kind_t kind;
+	size_t col;
+	predicate_t pred;
+	const struct filter_expr *children;
+	size_t num_children;
+} filter_expr_t;
+
+// FILTER: the rows of t where expr holds, in order, in a new table with the chunk size of t.
+// The children of each AND and OR are evaluated one chunk at a time into bitmaps, in an order which adapts
+// to their selectivity and cost as the scan goes, and no more of them once the chunk's result is known.
+// t is consumed; NULL on failure.
+col_table_t *filter(col_table_t *t, const filter_expr_t *expr);
+
+// SELECT_PROJECT in one pass: each chunk's predicate column is evaluated into a bitmap,
+// and only the columns pos[0:num_proj] are compacted from it, so no other column is read or written.
+// On a table sorted on col, the matching range is found as in sorted_selection and only those columns copied.
+// A projection onto every column in order is just the default SELECTION_PRED.
+col_table_t *bitmap_select_project(col_table_t *t, size_t col, const predicate_t *pred, size_t *pos, size_t num_proj);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stddef.h>
+#endif
+
+#include "app/database/operators.h"
+
+#ifdef __NAUTILUS__
+	// Nautilus builds always use the scalar kernels
+	#undef DB_SIMD
+#endif
+
+// Vector kernels are only compiled with -DDB_SIMD (make main_simd).
+// Everything else is built with -mno-sse2, so each kernel enables its instruction set itself
+// and is only called after the CPU is checked at runtime.
+typedef enum {
+	SIMD_NONE = 0,
+	SIMD_SSE42,
+	SIMD_AVX2,
+	NUM_SIMD_LEVELS
+} simd_level_t;
+
+extern char *simd_level_names[];
+
+// merges sorted a[0:na] and b[0:nb] into out[0:na + nb]; pairs must be distinct
+typedef void (*merge_pairs_fn_t)(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out);
+
+// best level this build and this CPU support
+simd_level_t simd_detect();
+// the level in use (initially simd_detect())
+simd_level_t simd_get_level();
+// uses the given level, or the best supported one below it
+void simd_set_level(simd_level_t level);
+
+// Merges sorted a[0:na] and b[0:nb] into out[0:na + nb] with the kernel of the current level.
+// out may overlap b as long as out + na == b (a was moved out of the way first).
+void merge_pairs(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out);
+void merge_pairs_scalar(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out);
+#ifdef DB_SIMD
+void merge_pairs_sse42(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out);
+void merge_pairs_avx2(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out);
+#endif
+
+#endif
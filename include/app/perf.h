@@ -36,6 +36,8 @@ typedef struct {
 #endif
 
 void timer_initialize(timer_data_t* obj);
+// cycles between the last timer_start and timer_stop
+uint64_t timer_elapsed(timer_data_t* obj);
 void timer_print(timer_data_t* obj);
 void timer_print_header(char* name);
 void timer_finalize(timer_data_t* obj);
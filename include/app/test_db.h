@@ -1,5 +1,13 @@
 #ifndef TEST_DB_H
 
 void test_db();
+void test_sort_threads();
+void test_sort();
+void test_selection();
+void test_selection_threads();
+void test_join();
+void test_group_by();
+void test_reduce();
+void test_distinct();
 
 #endif
@@ -0,0 +1,810 @@
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <assert.h>
+	#include <string.h>
+#endif
+
+#include "app/database/common.h"
+#include "app/database/aggregate.h"
+#include "app/database/bitvec.h"
+#include "app/database/parallel.h"
+#include "app/database/simd.h"
+
+#ifdef DB_SIMD
+	#include <immintrin.h>
+#endif
+
+// a hashed partial starts out with room for this many groups, in twice as many slots
+#define GROUP_HASH_MIN_CAP 1024
+// how far ahead a hashed partial's lookups are prefetched
+#define GROUP_PREFETCH_ROWS 16
+// parallel_column_reduce gives every thread at least this many rows
+#define REDUCE_MIN_THREAD_ROWS (1 << 16)
+
+// The hash of a row mixes in its group values one column at a time.
+// Multiplying leaves the high bits well mixed, so they are folded down onto the slot bits.
+#define GROUP_HASH_STEP(hash, val) ((uint32_t) (((hash) ^ (val)) * 2654435761u))
+#define GROUP_HASH_SLOT(hash, mask) (((hash) ^ ((hash) >> 16)) & (mask))
+
+// vals[gids[i] * width] = vals[gids[i] * width] <agg> data[i] for every row of a chunk,
+// where vals points at the aggregate in the first group
+#define GROUP_AGGREGATE(vals, width, gids, data, n, AGG_OP) \
+	for(size_t i = 0; i < (n); ++i) { \
+		AGG_OP((vals)[(gids)[i] * (width)], (data)[i]); \
+	}
+
+// the starting value of one group's accumulators
+static void
+group_init_vals(group_partial_t *gp, uint64_t *vals) {
+	vals[0] = 0;
+	for(size_t a = 0; a < gp->num_aggs; ++a) {
+		vals[1 + a] = gp->aggs[a].agg == AGG_MIN ? (val_t) -1 : 0;
+	}
+}
+
+// the group values of hashed group g
+static inline __attribute__((always_inline)) uint64_t *
+group_keys(group_partial_t *gp, size_t g) {
+	return gp->vals + g * gp->width + 1 + gp->num_aggs;
+}
+
+static inline __attribute__((always_inline)) uint32_t
+group_hash(const uint64_t *keys, size_t num_group_cols) {
+	uint32_t hash = 0;
+	for(size_t k = 0; k < num_group_cols; ++k) {
+		hash = GROUP_HASH_STEP(hash, keys[k]);
+	}
+	return hash;
+}
+
+// puts group g with the given hash into slots which do not have it yet
+static inline __attribute__((always_inline)) void
+group_insert_slot(uint32_t *slots, size_t mask, uint32_t hash, size_t g) {
+	size_t slot = GROUP_HASH_SLOT(hash, mask);
+	while(slots[slot]) {
+		slot = (slot + 1) & mask;
+	}
+	slots[slot] = g + 1;
+}
+
+int
+group_partial_init(group_partial_t *gp, col_table_t *t, const size_t *group_cols, size_t num_group_cols,
+                   const aggregate_t *aggs, size_t num_aggs, const size_t *domains) {
+	gp->group_cols = group_cols;
+	gp->num_group_cols = num_group_cols;
+	gp->aggs = aggs;
+	gp->num_aggs = num_aggs;
+	gp->domains = domains;
+	gp->width = 1 + num_aggs + (domains ? 0 : num_group_cols);
+	gp->slots = NULL;
+	gp->num_slots = 0;
+
+	if(domains) {
+		gp->num_groups = 1;
+		for(size_t k = 0; k < num_group_cols; ++k) {
+			gp->num_groups *= domains[k];
+		}
+		gp->cap = gp->num_groups;
+	} else {
+		gp->num_groups = 0;
+		gp->cap = GROUP_HASH_MIN_CAP;
+		gp->num_slots = 2 * gp->cap;
+		gp->slots = NEWA(uint32_t, gp->num_slots);
+		MALLOC_CHECK_INT(gp->slots, "group slots");
+		memset(gp->slots, 0, gp->num_slots * sizeof(uint32_t));
+	}
+
+	gp->vals = NEWA(uint64_t, gp->cap * gp->width);
+	MALLOC_CHECK_INT(gp->vals, "group aggregates");
+	for(size_t g = 0; g < gp->num_groups; ++g) {
+		group_init_vals(gp, gp->vals + g * gp->width);
+	}
+
+	gp->gids = NEWA(uint32_t, get_chunk_size(t));
+	MALLOC_CHECK_INT(gp->gids, "row groups");
+	gp->cols = NEWA(val_t *, MAX(1, num_group_cols));
+	MALLOC_CHECK_INT(gp->cols, "group columns");
+	gp->key = NEWA(val_t, MAX(1, num_group_cols));
+	MALLOC_CHECK_INT(gp->key, "group key");
+	return 0;
+}
+
+void
+group_partial_free(group_partial_t *gp) {
+	my_free(gp->vals);
+	if(!gp->domains) {
+		my_free(gp->slots);
+	}
+	my_free(gp->gids);
+	my_free(gp->cols);
+	my_free(gp->key);
+}
+
+// doubles the room of a hashed partial for groups, and rehashes them into twice as many slots
+static int
+group_partial_grow(group_partial_t *gp) {
+	size_t cap = 2 * gp->cap;
+
+	uint64_t *vals = NEWA(uint64_t, cap * gp->width);
+	MALLOC_CHECK_INT(vals, "group aggregates");
+	memcpy(vals, gp->vals, gp->num_groups * gp->width * sizeof(uint64_t));
+	my_free(gp->vals);
+	gp->vals = vals;
+
+	size_t num_slots = 2 * cap;
+	uint32_t *slots = NEWA(uint32_t, num_slots);
+	MALLOC_CHECK_INT(slots, "group slots");
+	memset(slots, 0, num_slots * sizeof(uint32_t));
+	for(size_t g = 0; g < gp->num_groups; ++g) {
+		group_insert_slot(slots, num_slots - 1, group_hash(group_keys(gp, g), gp->num_group_cols), g);
+	}
+	my_free(gp->slots);
+	gp->slots = slots;
+	gp->num_slots = num_slots;
+	gp->cap = cap;
+	return 0;
+}
+
+// Sets *gid to the group of a hashed partial with the values key[0:num_group_cols] and their hash,
+// which is added if it is new. Returns 0 on success and -1 on failure.
+static inline __attribute__((always_inline)) int
+group_lookup(group_partial_t *gp, uint32_t hash, const val_t *key, uint32_t *gid) {
+	size_t num_group_cols = gp->num_group_cols;
+	size_t mask = gp->num_slots - 1;
+	for(size_t slot = GROUP_HASH_SLOT(hash, mask); gp->slots[slot]; slot = (slot + 1) & mask) {
+		uint32_t g = gp->slots[slot] - 1;
+		const uint64_t *keys = group_keys(gp, g);
+		size_t k = 0;
+		while(k < num_group_cols && keys[k] == key[k]) {
+			++k;
+		}
+		if(k == num_group_cols) {
+			*gid = g;
+			return 0;
+		}
+	}
+
+	if(gp->num_groups == gp->cap && group_partial_grow(gp) != 0) {
+		return -1;
+	}
+	uint32_t g = gp->num_groups++;
+	group_init_vals(gp, gp->vals + g * gp->width);
+	uint64_t *keys = group_keys(gp, g);
+	for(size_t k = 0; k < num_group_cols; ++k) {
+		keys[k] = key[k];
+	}
+	group_insert_slot(gp->slots, gp->num_slots - 1, hash, g);
+	*gid = g;
+	return 0;
+}
+
+// ids[0:n] = (cols[0][i] * domains[1] + cols[1][i]) * domains[2] + ... for the rows of a chunk, a column at a time
+static void
+direct_ids(uint32_t *ids, val_t *const *cols, const size_t *domains, size_t num_cols, size_t n) {
+	if(num_cols == 0) {
+		memset(ids, 0, n * sizeof(uint32_t));
+		return;
+	}
+	const val_t *data = cols[0];
+	for(size_t i = 0; i < n; ++i) {
+		ids[i] = data[i];
+	}
+	for(size_t k = 1; k < num_cols; ++k) {
+		uint32_t domain = domains[k];
+		data = cols[k];
+		for(size_t i = 0; i < n; ++i) {
+			ids[i] = ids[i] * domain + data[i];
+		}
+	}
+}
+
+// gids[0:n] for the rows of the chunk in gp->cols, through the hash table
+static int
+group_hash_gids(group_partial_t *gp, size_t n) {
+	uint32_t *gids = gp->gids;
+	size_t num_group_cols = gp->num_group_cols;
+
+	// the hashes first, a column at a time, in place of the groups
+	memset(gids, 0, n * sizeof(uint32_t));
+	for(size_t k = 0; k < num_group_cols; ++k) {
+		const val_t *data = gp->cols[k];
+		for(size_t i = 0; i < n; ++i) {
+			gids[i] = GROUP_HASH_STEP(gids[i], data[i]);
+		}
+	}
+
+	// Knowing the hashes ahead, the slot of a row GROUP_PREFETCH_ROWS on is fetched while this one is looked up,
+	// and the group of a row half as far on, whose slot should be in cache by then.
+	for(size_t i = 0; i < n; ++i) {
+		if(i + GROUP_PREFETCH_ROWS < n) {
+			__builtin_prefetch(&gp->slots[GROUP_HASH_SLOT(gids[i + GROUP_PREFETCH_ROWS], gp->num_slots - 1)]);
+		}
+		if(i + GROUP_PREFETCH_ROWS / 2 < n) {
+			uint32_t s = gp->slots[GROUP_HASH_SLOT(gids[i + GROUP_PREFETCH_ROWS / 2], gp->num_slots - 1)];
+			if(s) {
+				__builtin_prefetch(gp->vals + (s - 1) * gp->width);
+			}
+		}
+		for(size_t k = 0; k < num_group_cols; ++k) {
+			gp->key[k] = gp->cols[k][i];
+		}
+		if(group_lookup(gp, gids[i], gp->key, &gids[i]) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int
+group_partial_chunk(group_partial_t *gp, col_table_t *t, size_t chunk_no) {
+	size_t n = get_chunk_rows(t, chunk_no);
+	table_chunk_t *chunk = t->chunks[chunk_no];
+	for(size_t k = 0; k < gp->num_group_cols; ++k) {
+		gp->cols[k] = chunk->columns[gp->group_cols[k]]->data;
+	}
+	if(gp->domains) {
+		direct_ids(gp->gids, gp->cols, gp->domains, gp->num_group_cols, n);
+	} else if(group_hash_gids(gp, n) != 0) {
+		return -1;
+	}
+
+	const uint32_t *gids = gp->gids;
+	size_t width = gp->width;
+	uint64_t *vals = gp->vals;
+	for(size_t i = 0; i < n; ++i) {
+		++vals[gids[i] * width];
+	}
+	for(size_t a = 0; a < gp->num_aggs; ++a) {
+		uint64_t *acc = vals + 1 + a;
+		switch(gp->aggs[a].agg) {
+		case AGG_SUM:
+		case AGG_AVG:
+			GROUP_AGGREGATE(acc, width, gids, chunk->columns[gp->aggs[a].col]->data, n, AGG_SUM_OP);
+			break;
+		case AGG_MIN:
+			GROUP_AGGREGATE(acc, width, gids, chunk->columns[gp->aggs[a].col]->data, n, AGG_MIN_OP);
+			break;
+		case AGG_MAX:
+			GROUP_AGGREGATE(acc, width, gids, chunk->columns[gp->aggs[a].col]->data, n, AGG_MAX_OP);
+			break;
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+
+int
+group_partial_merge(group_partial_t *dst, group_partial_t *src) {
+	size_t num_group_cols = src->num_group_cols;
+	size_t width = src->width;
+	for(uint32_t g = 0; g < src->num_groups; ++g) {
+		const uint64_t *src_vals = src->vals + g * width;
+		if(src_vals[0] == 0) {
+			continue;
+		}
+		uint32_t d = g;
+		if(!dst->domains) {
+			const uint64_t *keys = group_keys(src, g);
+			for(size_t k = 0; k < num_group_cols; ++k) {
+				src->key[k] = keys[k];
+			}
+			if(group_lookup(dst, group_hash(keys, num_group_cols), src->key, &d) != 0) {
+				return -1;
+			}
+		}
+		uint64_t *dst_vals = dst->vals + d * width;
+		dst_vals[0] += src_vals[0];
+		for(size_t a = 0; a < src->num_aggs; ++a) {
+			switch(src->aggs[a].agg) {
+			case AGG_SUM:
+			case AGG_AVG:
+				AGG_SUM_OP(dst_vals[1 + a], src_vals[1 + a]);
+				break;
+			case AGG_MIN:
+				AGG_MIN_OP(dst_vals[1 + a], src_vals[1 + a]);
+				break;
+			case AGG_MAX:
+				AGG_MAX_OP(dst_vals[1 + a], src_vals[1 + a]);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+col_table_t *
+group_partial_table(group_partial_t *gp, size_t chunk_size) {
+	size_t num_group_cols = gp->num_group_cols;
+	size_t width = gp->width;
+
+	// only direct arrays have groups without rows
+	uint32_t *groups = NEWA(uint32_t, MAX(1, gp->num_groups));
+	MALLOC_CHECK(groups, "result groups");
+	size_t num_rows = 0;
+	for(uint32_t g = 0; g < gp->num_groups; ++g) {
+		if(gp->vals[g * width]) {
+			groups[num_rows++] = g;
+		}
+	}
+
+	col_table_t *out = create_col_table_empty(num_rows, chunk_size, num_group_cols + gp->num_aggs);
+	MALLOC_CHECK(out, "group by result");
+	for(size_t chunk_no = 0; chunk_no < out->num_chunks; ++chunk_no) {
+		const uint32_t *chunk_groups = groups + chunk_no * chunk_size;
+		size_t n = get_chunk_rows(out, chunk_no);
+		table_chunk_t *chunk = out->chunks[chunk_no];
+
+		for(size_t k = 0; k < num_group_cols; ++k) {
+			val_t *data = chunk->columns[k]->data;
+			if(gp->domains) {
+				size_t stride = 1;
+				for(size_t j = k + 1; j < num_group_cols; ++j) {
+					stride *= gp->domains[j];
+				}
+				for(size_t i = 0; i < n; ++i) {
+					data[i] = chunk_groups[i] / stride % gp->domains[k];
+				}
+			} else {
+				for(size_t i = 0; i < n; ++i) {
+					data[i] = group_keys(gp, chunk_groups[i])[k];
+				}
+			}
+		}
+
+		for(size_t a = 0; a < gp->num_aggs; ++a) {
+			val_t *data = chunk->columns[num_group_cols + a]->data;
+			const uint64_t *vals = gp->vals;
+			switch(gp->aggs[a].agg) {
+			case AGG_COUNT:
+				for(size_t i = 0; i < n; ++i) {
+					data[i] = vals[chunk_groups[i] * width];
+				}
+				break;
+			case AGG_AVG:
+				for(size_t i = 0; i < n; ++i) {
+					data[i] = vals[chunk_groups[i] * width + 1 + a] / vals[chunk_groups[i] * width];
+				}
+				break;
+			default:
+				for(size_t i = 0; i < n; ++i) {
+					data[i] = vals[chunk_groups[i] * width + 1 + a];
+				}
+				break;
+			}
+		}
+	}
+	set_zone_maps(out);
+	out->sorted_col = gp->domains && num_group_cols > 0 ? 0 : TABLE_UNSORTED;
+
+	my_free(groups);
+	return out;
+}
+
+// Whether the domains of cols of t multiply to at most max_ids, with domains[k] set to bound column cols[k].
+static bool
+direct_domains(col_table_t *t, const size_t *cols, size_t num_cols, size_t *domains, size_t max_ids) {
+	size_t num_ids = 1;
+	for(size_t k = 0; k < num_cols; ++k) {
+		domains[k] = MAX(1, col_domain_size(t, cols[k]));
+		if(domains[k] > max_ids / num_ids) {
+			return false;
+		}
+		num_ids *= domains[k];
+	}
+	return true;
+}
+
+bool
+group_direct_domains(col_table_t *t, const size_t *group_cols, size_t num_group_cols, size_t *domains) {
+	return direct_domains(t, group_cols, num_group_cols, domains, GROUP_DIRECT_MAX_GROUPS);
+}
+
+col_table_t *
+group_by(col_table_t *t, const size_t *group_cols, size_t num_group_cols, const aggregate_t *aggs, size_t num_aggs) {
+	size_t *domains = NEWA(size_t, MAX(1, num_group_cols));
+	MALLOC_CHECK(domains, "group domains");
+	bool direct = group_direct_domains(t, group_cols, num_group_cols, domains);
+
+	group_partial_t gp;
+	if(group_partial_init(&gp, t, group_cols, num_group_cols, aggs, num_aggs, direct ? domains : NULL) != 0) {
+		return NULL;
+	}
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		if(group_partial_chunk(&gp, t, chunk_no) != 0) {
+			return NULL;
+		}
+	}
+	col_table_t *out = group_partial_table(&gp, get_chunk_size(t));
+
+	group_partial_free(&gp);
+	my_free(domains);
+	return out;
+}
+
+typedef struct {
+	col_table_t *t;
+	const size_t *group_cols;
+	size_t num_group_cols;
+	const aggregate_t *aggs;
+	size_t num_aggs;
+	const size_t *domains;
+	size_t next_chunk; // the next chunk to claim
+	size_t step; // of the merge round
+	size_t num_partials;
+	int status[MAX_THREADS];
+	group_partial_t partials[MAX_THREADS]; // one per worker
+} group_par_args_t;
+
+static void
+group_by_worker(void *arg, size_t thread_no, __attribute__((unused)) size_t num_threads) {
+	group_par_args_t *args = (group_par_args_t *) arg;
+	col_table_t *t = args->t;
+	group_partial_t *gp = &args->partials[thread_no];
+	args->status[thread_no] = group_partial_init(gp, t, args->group_cols, args->num_group_cols,
+	                                             args->aggs, args->num_aggs, args->domains);
+	if(args->status[thread_no] != 0) {
+		return;
+	}
+
+	size_t chunk_no;
+	while((chunk_no = __sync_fetch_and_add(&args->next_chunk, 1)) < t->num_chunks) {
+		if(group_partial_chunk(gp, t, chunk_no) != 0) {
+			args->status[thread_no] = -1;
+			return;
+		}
+	}
+}
+
+// one merge of a round: partial thread_no * 2 * step takes in the one step after it
+static void
+group_merge_worker(void *arg, size_t thread_no, __attribute__((unused)) size_t num_threads) {
+	group_par_args_t *args = (group_par_args_t *) arg;
+	size_t dst = thread_no * 2 * args->step;
+	size_t src = dst + args->step;
+	if(src < args->num_partials && group_partial_merge(&args->partials[dst], &args->partials[src]) != 0) {
+		args->status[dst] = -1;
+	}
+}
+
+col_table_t *
+parallel_group_by(col_table_t *t, const size_t *group_cols, size_t num_group_cols, const aggregate_t *aggs, size_t num_aggs) {
+	size_t num_threads = MAX(1, MIN(MIN(par_threads, MAX_THREADS), t->num_chunks));
+	size_t *domains = NEWA(size_t, MAX(1, num_group_cols));
+	MALLOC_CHECK(domains, "group domains");
+	bool direct = group_direct_domains(t, group_cols, num_group_cols, domains);
+
+	group_par_args_t *args = NEW(group_par_args_t);
+	MALLOC_CHECK(args, "group by arguments");
+	args->t = t;
+	args->group_cols = group_cols;
+	args->num_group_cols = num_group_cols;
+	args->aggs = aggs;
+	args->num_aggs = num_aggs;
+	args->domains = direct ? domains : NULL;
+	args->next_chunk = 0;
+	args->num_partials = num_threads;
+	par_run(num_threads, group_by_worker, args);
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		if(args->status[thread_no] != 0) {
+			return NULL;
+		}
+	}
+
+	// pairwise, in log2(num_threads) rounds
+	for(args->step = 1; args->step < num_threads; args->step *= 2) {
+		par_run((num_threads + 2 * args->step - 1) / (2 * args->step), group_merge_worker, args);
+	}
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		if(args->status[thread_no] != 0) {
+			return NULL;
+		}
+	}
+	col_table_t *out = group_partial_table(&args->partials[0], get_chunk_size(t));
+
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		group_partial_free(&args->partials[thread_no]);
+	}
+	my_free(args);
+	my_free(domains);
+	return out;
+}
+
+col_table_t *
+hash_distinct(col_table_t *t, const size_t *cols, size_t num_cols) {
+	assert(num_cols > 0);
+	// a GROUP_BY without aggregates, whose hashed partial is the set of combinations seen
+	group_partial_t gp;
+	if(group_partial_init(&gp, t, cols, num_cols, NULL, 0, NULL) != 0) {
+		return NULL;
+	}
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		if(group_partial_chunk(&gp, t, chunk_no) != 0) {
+			return NULL;
+		}
+	}
+	col_table_t *out = group_partial_table(&gp, get_chunk_size(t));
+
+	group_partial_free(&gp);
+	return out;
+}
+
+// DISTINCT by one bit per possible combination of values, numbered as the groups of a direct GROUP_BY
+static col_table_t *
+bitmap_distinct(col_table_t *t, const size_t *cols, size_t num_cols, const size_t *domains) {
+	size_t chunk_size = get_chunk_size(t);
+	size_t num_ids = 1;
+	for(size_t k = 0; k < num_cols; ++k) {
+		num_ids *= domains[k];
+	}
+
+	bit_vec_t seen;
+	bv_init(&seen, num_ids);
+	MALLOC_CHECK(seen.data, "distinct bitmap");
+	bv_reset(&seen);
+	uint32_t *ids = NEWA(uint32_t, chunk_size);
+	MALLOC_CHECK(ids, "row ids");
+	val_t **chunk_cols = NEWA(val_t *, num_cols);
+	MALLOC_CHECK(chunk_cols, "distinct columns");
+
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		size_t n = get_chunk_rows(t, chunk_no);
+		for(size_t k = 0; k < num_cols; ++k) {
+			chunk_cols[k] = t->chunks[chunk_no]->columns[cols[k]]->data;
+		}
+		direct_ids(ids, chunk_cols, domains, num_cols, n);
+		for(size_t i = 0; i < n; ++i) {
+			seen.data[ids[i] / BV_UNIT_BITS] |= (bit_unit_t) 1 << (ids[i] % BV_UNIT_BITS);
+		}
+	}
+
+	// the set bits in order, each taken apart into its values
+	col_table_t *out = create_col_table_empty(bv_count(&seen), chunk_size, num_cols);
+	MALLOC_CHECK(out, "distinct result");
+	size_t row = 0;
+	for(size_t unit = 0; unit < bv_num_units(num_ids); ++unit) {
+		for(bit_unit_t word = seen.data[unit]; word; word &= word - 1, ++row) {
+			size_t id = unit * BV_UNIT_BITS + __builtin_ctzl(word);
+			table_chunk_t *chunk = out->chunks[row / chunk_size];
+			for(size_t k = num_cols; k-- > 0; ) {
+				chunk->columns[k]->data[row % chunk_size] = id % domains[k];
+				id /= domains[k];
+			}
+		}
+	}
+	set_zone_maps(out);
+	out->sorted_col = 0;
+
+	my_free(chunk_cols);
+	my_free(ids);
+	bv_free(&seen);
+	return out;
+}
+
+col_table_t *
+distinct(col_table_t *t, const size_t *cols, size_t num_cols) {
+	assert(num_cols > 0);
+	size_t *domains = NEWA(size_t, num_cols);
+	MALLOC_CHECK(domains, "distinct domains");
+	// bit ids must fit in 32 bits
+	size_t max_ids = MIN((size_t) 1 << 32, MAX(DISTINCT_BITMAP_MAX_VALUES, DISTINCT_BITMAP_BITS_PER_ROW * t->num_rows));
+	col_table_t *out = direct_domains(t, cols, num_cols, domains, max_ids)
+		? bitmap_distinct(t, cols, num_cols, domains)
+		: hash_distinct(t, cols, num_cols);
+	my_free(domains);
+	return out;
+}
+
+// agg over data[0:n], where AGG_AVG takes the sum; partial results of one agg combine with reduce_combine
+typedef uint64_t (*reduce_fn_t)(const val_t *data, size_t n);
+
+// Every kernel keeps four independent accumulators, in named variables so they stay in registers:
+// value (or vector) i goes to accumulator i % 4, and the four are combined at the end.
+
+// Scalar kernels: MIN and MAX accumulate in val_t, SUM in 64 bits so it cannot overflow.
+#define REDUCE_DEFINE_SCALAR_KERNEL(name, acc_t, init, AGG_OP) \
+	static uint64_t \
+	reduce_##name##_scalar(const val_t *data, size_t n) { \
+		acc_t acc0 = (init), acc1 = (init), acc2 = (init), acc3 = (init); \
+		size_t i = 0; \
+		for(; i + 4 <= n; i += 4) { \
+			AGG_OP(acc0, data[i]); \
+			AGG_OP(acc1, data[i + 1]); \
+			AGG_OP(acc2, data[i + 2]); \
+			AGG_OP(acc3, data[i + 3]); \
+		} \
+		for(; i < n; ++i) { \
+			AGG_OP(acc0, data[i]); \
+		} \
+		AGG_OP(acc0, acc1); \
+		AGG_OP(acc2, acc3); \
+		AGG_OP(acc0, acc2); \
+		return acc0; \
+	}
+
+REDUCE_DEFINE_SCALAR_KERNEL(sum, uint64_t, 0, AGG_SUM_OP)
+REDUCE_DEFINE_SCALAR_KERNEL(min, val_t, (val_t) -1, AGG_MIN_OP)
+REDUCE_DEFINE_SCALAR_KERNEL(max, val_t, 0, AGG_MAX_OP)
+
+#ifdef DB_SIMD
+
+// Vector SUM: interleaving a vector with zeros widens its values to 64-bit lanes,
+// the low and high halves of each load going to accumulators of their own.
+// The lanes come out of order, which a sum does not mind.
+static __attribute__((target("sse4.2"))) uint64_t
+reduce_sum_sse42(const val_t *data, size_t n) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i y = _mm_loadu_si128((const __m128i *) (data + i + 4));
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(x, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(x, zero));
+		acc2 = _mm_add_epi64(acc2, _mm_unpacklo_epi32(y, zero));
+		acc3 = _mm_add_epi64(acc3, _mm_unpackhi_epi32(y, zero));
+	}
+	acc0 = _mm_add_epi64(_mm_add_epi64(acc0, acc1), _mm_add_epi64(acc2, acc3));
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i *) lanes, acc0);
+	return lanes[0] + lanes[1] + reduce_sum_scalar(data + i, n - i);
+}
+
+static __attribute__((target("avx2"))) uint64_t
+reduce_sum_avx2(const val_t *data, size_t n) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (data + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *) (data + i + 8));
+		acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(x, zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(x, zero));
+		acc2 = _mm256_add_epi64(acc2, _mm256_unpacklo_epi32(y, zero));
+		acc3 = _mm256_add_epi64(acc3, _mm256_unpackhi_epi32(y, zero));
+	}
+	acc0 = _mm256_add_epi64(_mm256_add_epi64(acc0, acc1), _mm256_add_epi64(acc2, acc3));
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, acc0);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + reduce_sum_scalar(data + i, n - i);
+}
+
+// Vector MIN and MAX stay in 32-bit lanes, a whole load per accumulator.
+#define REDUCE_DEFINE_VECTOR_KERNELS(name, init, AGG_OP) \
+	static __attribute__((target("sse4.2"))) uint64_t \
+	reduce_##name##_sse42(const val_t *data, size_t n) { \
+		__m128i acc0 = _mm_set1_epi32(init), acc1 = acc0, acc2 = acc0, acc3 = acc0; \
+		size_t i = 0; \
+		for(; i + 16 <= n; i += 16) { \
+			acc0 = _mm_##name##_epu32(acc0, _mm_loadu_si128((const __m128i *) (data + i))); \
+			acc1 = _mm_##name##_epu32(acc1, _mm_loadu_si128((const __m128i *) (data + i + 4))); \
+			acc2 = _mm_##name##_epu32(acc2, _mm_loadu_si128((const __m128i *) (data + i + 8))); \
+			acc3 = _mm_##name##_epu32(acc3, _mm_loadu_si128((const __m128i *) (data + i + 12))); \
+		} \
+		acc0 = _mm_##name##_epu32(_mm_##name##_epu32(acc0, acc1), _mm_##name##_epu32(acc2, acc3)); \
+		val_t lanes[4]; \
+		_mm_storeu_si128((__m128i *) lanes, acc0); \
+		val_t result = reduce_##name##_scalar(data + i, n - i); \
+		for(size_t k = 0; k < 4; ++k) { \
+			AGG_OP(result, lanes[k]); \
+		} \
+		return result; \
+	} \
+	\
+	static __attribute__((target("avx2"))) uint64_t \
+	reduce_##name##_avx2(const val_t *data, size_t n) { \
+		__m256i acc0 = _mm256_set1_epi32(init), acc1 = acc0, acc2 = acc0, acc3 = acc0; \
+		size_t i = 0; \
+		for(; i + 32 <= n; i += 32) { \
+			acc0 = _mm256_##name##_epu32(acc0, _mm256_loadu_si256((const __m256i *) (data + i))); \
+			acc1 = _mm256_##name##_epu32(acc1, _mm256_loadu_si256((const __m256i *) (data + i + 8))); \
+			acc2 = _mm256_##name##_epu32(acc2, _mm256_loadu_si256((const __m256i *) (data + i + 16))); \
+			acc3 = _mm256_##name##_epu32(acc3, _mm256_loadu_si256((const __m256i *) (data + i + 24))); \
+		} \
+		acc0 = _mm256_##name##_epu32(_mm256_##name##_epu32(acc0, acc1), _mm256_##name##_epu32(acc2, acc3)); \
+		val_t lanes[8]; \
+		_mm256_storeu_si256((__m256i *) lanes, acc0); \
+		val_t result = reduce_##name##_scalar(data + i, n - i); \
+		for(size_t k = 0; k < 8; ++k) { \
+			AGG_OP(result, lanes[k]); \
+		} \
+		return result; \
+	}
+
+REDUCE_DEFINE_VECTOR_KERNELS(min, (val_t) -1, AGG_MIN_OP)
+REDUCE_DEFINE_VECTOR_KERNELS(max, 0, AGG_MAX_OP)
+
+#define REDUCE_FNS(name) \
+	{ reduce_##name##_scalar, reduce_##name##_sse42, reduce_##name##_avx2 }
+#else
+#define REDUCE_FNS(name) \
+	{ reduce_##name##_scalar, NULL, NULL }
+#endif
+
+// reduce_fns[agg][simd level]; AGG_COUNT needs no scan
+static reduce_fn_t reduce_fns[NUM_AGGS][NUM_SIMD_LEVELS] = {
+		[AGG_SUM] = REDUCE_FNS(sum),
+		[AGG_MIN] = REDUCE_FNS(min),
+		[AGG_MAX] = REDUCE_FNS(max),
+		[AGG_AVG] = REDUCE_FNS(sum),
+};
+
+static inline __attribute__((always_inline)) uint64_t
+reduce_combine(agg_op_t agg, uint64_t acc, uint64_t partial) {
+	switch(agg) {
+	case AGG_MIN:
+		return MIN(acc, partial);
+	case AGG_MAX:
+		return MAX(acc, partial);
+	default:
+		return acc + partial;
+	}
+}
+
+// agg over column col of chunks [start:stop] of t, before AGG_AVG divides
+static uint64_t
+reduce_chunks(col_table_t *t, size_t col, agg_op_t agg, size_t start, size_t stop) {
+	reduce_fn_t fn = reduce_fns[agg][simd_get_level()];
+	uint64_t acc = agg == AGG_MIN ? (val_t) -1 : 0;
+	for(size_t chunk_no = start; chunk_no < stop; ++chunk_no) {
+		acc = reduce_combine(agg, acc, fn(t->chunks[chunk_no]->columns[col]->data, get_chunk_rows(t, chunk_no)));
+	}
+	return acc;
+}
+
+static inline __attribute__((always_inline)) uint64_t
+reduce_result(col_table_t *t, agg_op_t agg, uint64_t acc) {
+	if(agg == AGG_AVG) {
+		return t->num_rows ? acc / t->num_rows : 0;
+	}
+	return acc;
+}
+
+uint64_t
+column_reduce(col_table_t *t, size_t col, agg_op_t agg) {
+	if(agg == AGG_COUNT) {
+		return t->num_rows;
+	}
+	return reduce_result(t, agg, reduce_chunks(t, col, agg, 0, t->num_chunks));
+}
+
+typedef struct {
+	col_table_t *t;
+	size_t col;
+	agg_op_t agg;
+	uint64_t partials[MAX_THREADS]; // one per worker
+} reduce_par_args_t;
+
+static void
+reduce_worker(void *arg, size_t thread_no, size_t num_threads) {
+	reduce_par_args_t *args = (reduce_par_args_t *) arg;
+	size_t start, stop;
+	par_range(args->t->num_chunks, thread_no, num_threads, &start, &stop);
+	args->partials[thread_no] = reduce_chunks(args->t, args->col, args->agg, start, stop);
+}
+
+uint64_t
+parallel_column_reduce(col_table_t *t, size_t col, agg_op_t agg) {
+	if(agg == AGG_COUNT) {
+		return t->num_rows;
+	}
+	size_t num_threads = MIN(MIN(par_threads, MAX_THREADS), MIN(t->num_chunks, t->num_rows / REDUCE_MIN_THREAD_ROWS));
+	if(num_threads <= 1) {
+		return column_reduce(t, col, agg);
+	}
+
+	reduce_par_args_t args;
+	args.t = t;
+	args.col = col;
+	args.agg = agg;
+	par_run(num_threads, reduce_worker, &args);
+
+	uint64_t acc = args.partials[0];
+	for(size_t thread_no = 1; thread_no < num_threads; ++thread_no) {
+		acc = reduce_combine(agg, acc, args.partials[thread_no]);
+	}
+	return reduce_result(t, agg, acc);
+}
@@ -101,6 +101,32 @@ void bv_iter_skip(bit_vec_iter_t* it, unsigned long n_bits) {
 	}
 }
 
+void bv_and(bit_vec_t* dst, const bit_vec_t* src) {
+	assert(dst->n_bits == src->n_bits);
+	size_t n_units = bv_num_units(dst->n_bits);
+	for(size_t unit = 0; unit < n_units; ++unit) {
+		dst->data[unit] &= src->data[unit];
+	}
+}
+
+void bv_or(bit_vec_t* dst, const bit_vec_t* src) {
+	assert(dst->n_bits == src->n_bits);
+	size_t n_units = bv_num_units(dst->n_bits);
+	for(size_t unit = 0; unit < n_units; ++unit) {
+		dst->data[unit] |= src->data[unit];
+	}
+}
+
+// bits past n_bits must be clear, as after bv_reset
+size_t bv_count(const bit_vec_t* bv) {
+	size_t n_units = bv_num_units(bv->n_bits);
+	size_t count = 0;
+	for(size_t unit = 0; unit < n_units; ++unit) {
+		count += __builtin_popcountl(bv->data[unit]);
+	}
+	return count;
+}
+
 void bv_test() {
 	my_malloc_init(1 << 28);
 	assert(sizeof(bit_unit_t) * BITS_PER_BYTE == BITS_PER_UNIT);
@@ -18,6 +18,7 @@ create_col_table (size_t num_chunks, size_t chunk_size, size_t num_cols, unsigne
 	t->num_chunks = num_chunks;
 	t->num_cols = num_cols;
 	t->num_rows = t->num_chunks * chunk_size;
+	t->sorted_col = TABLE_UNSORTED;
 
 	t->chunks = NEWPA(table_chunk_t, num_chunks);
 	MALLOC_CHECK_NO_MES(t->chunks);
@@ -39,9 +40,14 @@ create_col_table (size_t num_chunks, size_t chunk_size, size_t num_cols, unsigne
 			c->data = NEWA(val_t, chunk_size);
 			MALLOC_CHECK(c->data, "chunk data");
 
+			c->min = (val_t) -1;
+			c->max = 0;
 			for(size_t k = 0; k < chunk_size; k++) {
 				c->data[k] = rand_next(domain_size);
+				c->min = MIN(c->min, c->data[k]);
+				c->max = MAX(c->max, c->data[k]);
 			}
+			c->has_zone = true;
 		}
 	}
 	return t;
@@ -82,6 +88,7 @@ create_col_chunk(size_t chunksize)
        result->chunk_size = chunksize;
        result->data = NEWA(val_t, chunksize);
        MALLOC_CHECK_NO_MES(result->data);
+       result->has_zone = false;
 
        return result;
 }
@@ -91,16 +98,41 @@ get_chunk_size(col_table_t *t) {
        return t->chunks[0]->columns[0]->chunk_size;
 }
 
-col_table_t *
-create_col_table_like (col_table_t *in) {
-	size_t chunk_size = get_chunk_size(in);
+// rows in use in chunk chunk_no; only the last chunk can have fewer than chunk size
+inline size_t
+get_chunk_rows(col_table_t *t, size_t chunk_no) {
+	size_t chunk_size = get_chunk_size(t);
+	size_t chunk_start = MIN(t->num_rows, chunk_no * chunk_size);
+	return MIN(chunk_size, t->num_rows - chunk_start);
+}
+
+// An uninitialized chunk of num_cols columns.
+table_chunk_t *
+create_table_chunk(size_t chunk_size, size_t num_cols) {
+	table_chunk_t *chunk = NEW(table_chunk_t);
+	MALLOC_CHECK(chunk, "chunk");
+
+	chunk->columns = NEWPA(column_chunk_t, num_cols);
+	MALLOC_CHECK(chunk->columns, "columns array");
+
+	for (size_t col = 0; col < num_cols; col++) {
+		chunk->columns[col] = create_col_chunk(chunk_size);
+		MALLOC_CHECK(chunk->columns[col], "column");
+	}
+	return chunk;
+}
 
+// An uninitialized table for num_rows rows in chunks of chunk_size.
+// The last chunk may be partly used; there is always at least one chunk.
+col_table_t *
+create_col_table_empty (size_t num_rows, size_t chunk_size, size_t num_cols) {
 	col_table_t * out = NEW(col_table_t);
 	MALLOC_CHECK(out, "table");
 
-	out->num_chunks = in->num_chunks;
-	out->num_cols = in->num_cols;
-	out->num_rows = in->num_chunks * get_chunk_size(in);
+	out->num_chunks = MAX(1, (num_rows + chunk_size - 1) / chunk_size);
+	out->num_cols = num_cols;
+	out->num_rows = num_rows;
+	out->sorted_col = TABLE_UNSORTED;
 
 	out->chunks = NEWPA(table_chunk_t, out->num_chunks);
 	MALLOC_CHECK(out->chunks, "chunks array");
@@ -120,12 +152,20 @@ create_col_table_like (col_table_t *in) {
 
 			out->chunks[chunk_no]->columns[col]->data = NEWA(val_t, chunk_size);
 			MALLOC_CHECK(out->chunks[chunk_no]->columns[col]->data, "column data");
+
+			out->chunks[chunk_no]->columns[col]->has_zone = false;
 		}
 	}
 
 	return out;
 }
 
+col_table_t *
+create_col_table_like (col_table_t *in) {
+	size_t chunk_size = get_chunk_size(in);
+	return create_col_table_empty(in->num_chunks * chunk_size, chunk_size, in->num_cols);
+}
+
 col_table_t *
 copy_col_table (col_table_t *in) {
 	col_table_t * out = create_col_table_like(in);
@@ -138,6 +178,8 @@ copy_col_table_noalloc(col_table_t* in, col_table_t* out) {
 	for(size_t chunk_no = 0; chunk_no < out->num_chunks; chunk_no++) {
 		copy_table_chunk(*in->chunks[chunk_no], *out->chunks[chunk_no], in->num_cols);
 	}
+	out->num_rows = in->num_rows;
+	out->sorted_col = in->sorted_col;
 }
 
 inline void
@@ -148,6 +190,9 @@ copy_table_chunk(table_chunk_t in_chunk, table_chunk_t out_chunk, size_t num_col
 		memcpy(out_chunk.columns[col]->data,
 			   in_chunk.columns[col]->data,
 			   chunk_size * sizeof(val_t));
+		out_chunk.columns[col]->has_zone = in_chunk.columns[col]->has_zone;
+		out_chunk.columns[col]->min = in_chunk.columns[col]->min;
+		out_chunk.columns[col]->max = in_chunk.columns[col]->max;
 	}
 }
 
@@ -168,12 +213,152 @@ new_copy_table_chunk(table_chunk_t in_chunk, size_t num_cols) {
 
 		out_chunk.columns[col]->data = NEWA(val_t, chunk_size);
 		MALLOC_NO_RET(out_chunk.columns[col]->data, "column data");
+		out_chunk.columns[col]->has_zone = false;
 
 		copy_table_chunk(in_chunk, out_chunk, num_cols);
 	}
 	return out_chunk;
 }
 
+// rows per block of gather_rows; 8KiB of locs stay in L1 while every column is gathered
+#define GATHER_BLOCK_ROWS 1024
+
+// out.row[i] = in.row[locs[i]] for every i < num_locs, and sets the zone maps of out; out is no longer sorted.
+void
+gather_rows(col_table_t *in, row_loc_t *locs, size_t num_locs, col_table_t *out) {
+	gather_cols(in, NULL, in->num_cols, locs, num_locs, out, 0);
+}
+
+// Column out_col + col of out.row[i] is column cols[col] of in.row[locs[i]] for every i < num_locs and col < num_cols,
+// and sets the zone maps of those columns of out; NULL cols is every column of in, in order. out is no longer sorted.
+// Works one block of an output chunk at a time, so that block's locs stay in cache for every column.
+void
+gather_cols(col_table_t *in, const size_t *cols, size_t num_cols, row_loc_t *locs, size_t num_locs, col_table_t *out, size_t out_col) {
+	out->sorted_col = TABLE_UNSORTED;
+	size_t out_chunk_size = get_chunk_size(out);
+
+	// src[col * in->num_chunks + chunk_no] saves two pointer-chases per value
+	val_t **src = NEWA(val_t*, num_cols * in->num_chunks);
+	MALLOC_CHECK_VOID(src, "source columns");
+	for (size_t col = 0; col < num_cols; col++) {
+		size_t in_col = cols ? cols[col] : col;
+		for(size_t chunk_no = 0; chunk_no < in->num_chunks; chunk_no++) {
+			src[col * in->num_chunks + chunk_no] = in->chunks[chunk_no]->columns[in_col]->data;
+		}
+	}
+
+	for(size_t out_chunk_no = 0; out_chunk_no * out_chunk_size < num_locs; out_chunk_no++) {
+		row_loc_t *chunk_locs = locs + out_chunk_no * out_chunk_size;
+		size_t n = MIN(out_chunk_size, num_locs - out_chunk_no * out_chunk_size);
+
+		for(size_t block = 0; block < n; block += GATHER_BLOCK_ROWS) {
+			size_t block_stop = MIN(block + GATHER_BLOCK_ROWS, n);
+			for (size_t col = 0; col < num_cols; col++) {
+				val_t **src_col = &src[col * in->num_chunks];
+				val_t *out_data = out->chunks[out_chunk_no]->columns[out_col + col]->data;
+				for(size_t i = block; i < block_stop; i++) {
+					out_data[i] = src_col[ROW_LOC_CHUNK(chunk_locs[i])][ROW_LOC_OFFSET(chunk_locs[i])];
+				}
+			}
+		}
+		// while the chunk is still in cache
+		for (size_t col = 0; col < num_cols; col++) {
+			set_col_chunk_zone(out->chunks[out_chunk_no]->columns[out_col + col], n);
+		}
+	}
+
+	my_free(src);
+}
+
+// out.row[out_row + i] = in.row[in_row + i] for every i < num_rows, a memcpy per column and chunk boundary.
+// The zone maps of out are left alone, and out is no longer sorted.
+void
+copy_rows(col_table_t *in, size_t in_row, col_table_t *out, size_t out_row, size_t num_rows) {
+	copy_cols(in, NULL, in->num_cols, in_row, out, out_row, num_rows);
+}
+
+// Column col of out.row[out_row + i] is column cols[col] of in.row[in_row + i] for every i < num_rows and col < num_cols;
+// NULL cols is every column of in, in order. As copy_rows otherwise.
+void
+copy_cols(col_table_t *in, const size_t *cols, size_t num_cols, size_t in_row, col_table_t *out, size_t out_row, size_t num_rows) {
+	if(num_rows == 0) {
+		return;
+	}
+	out->sorted_col = TABLE_UNSORTED;
+	size_t in_chunk_size = get_chunk_size(in);
+	size_t out_chunk_size = get_chunk_size(out);
+	while(num_rows > 0) {
+		size_t in_offset = in_row % in_chunk_size;
+		size_t out_offset = out_row % out_chunk_size;
+		size_t n = MIN(num_rows, MIN(in_chunk_size - in_offset, out_chunk_size - out_offset));
+		table_chunk_t *in_chunk = in->chunks[in_row / in_chunk_size];
+		table_chunk_t *out_chunk = out->chunks[out_row / out_chunk_size];
+		for (size_t col = 0; col < num_cols; col++) {
+			size_t in_col = cols ? cols[col] : col;
+			memcpy(out_chunk->columns[col]->data + out_offset,
+			       in_chunk->columns[in_col]->data + in_offset,
+			       n * sizeof(val_t));
+		}
+		in_row += n;
+		out_row += n;
+		num_rows -= n;
+	}
+}
+
+// where column sorted_col of a table ends up in a projection onto cols[0:num_cols], or TABLE_UNSORTED if it is dropped
+size_t
+projected_sorted_col(size_t sorted_col, const size_t *cols, size_t num_cols) {
+	for(size_t col = 0; col < num_cols; col++) {
+		if(cols[col] == sorted_col) {
+			return col;
+		}
+	}
+	return TABLE_UNSORTED;
+}
+
+// the zone map of the first num_rows values of c; with no rows, min > max so nothing can match
+void
+set_col_chunk_zone(column_chunk_t *c, size_t num_rows) {
+	val_t min = (val_t) -1;
+	val_t max = 0;
+	for(size_t row = 0; row < num_rows; row++) {
+		min = MIN(min, c->data[row]);
+		max = MAX(max, c->data[row]);
+	}
+	c->min = min;
+	c->max = max;
+	c->has_zone = true;
+}
+
+// Recomputes every zone map of t, for operators that write their output without tracking them.
+void
+set_zone_maps(col_table_t *t) {
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; chunk_no++) {
+		size_t n = get_chunk_rows(t, chunk_no);
+		for (size_t col = 0; col < t->num_cols; col++) {
+			set_col_chunk_zone(t->chunks[chunk_no]->columns[col], n);
+		}
+	}
+}
+
+// One more than the largest value of column col of t, as far as its zone maps tell, or 0 for no rows.
+// Chunks without a zone map get theirs set first.
+size_t
+col_domain_size(col_table_t *t, size_t col) {
+	size_t domain_size = 0;
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		column_chunk_t *c = t->chunks[chunk_no]->columns[col];
+		size_t n = get_chunk_rows(t, chunk_no);
+		if(!c->has_zone) {
+			set_col_chunk_zone(c, n);
+		}
+		if(n > 0) {
+			domain_size = MAX(domain_size, (size_t) c->max + 1);
+		}
+	}
+	return domain_size;
+}
+
 
 void
 print_strided_db(col_table_t* db) {
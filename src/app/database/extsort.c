@@ -0,0 +1,273 @@
+// External sort: Linux only, since it needs files and mmap.
+#ifndef __NAUTILUS__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "app/database/common.h"
+#include "app/database/extsort.h"
+#include "app/database/losertree.h"
+#include "app/database/operators.h"
+
+// A run file is this header followed by every column of the run, each contiguous,
+// so a mapped run is directly usable as num_cols arrays.
+#define EXT_RUN_MAGIC 0x4e55522d564d4244ULL // "DBMV-RUN"
+
+typedef struct {
+	uint64_t magic;
+	uint64_t num_rows;
+	uint64_t num_cols;
+} ext_run_header_t;
+
+typedef struct {
+	void *map;
+	size_t map_size;
+	size_t num_rows;
+	size_t pos;   // next row to merge
+	val_t **cols; // cols[col] points into map
+} ext_run_t;
+
+static int
+write_all(int fd, const void *buf, size_t size) {
+	const char *pos = buf;
+	while(size > 0) {
+		ssize_t written = write(fd, pos, size);
+		if(written < 0) {
+			return -1;
+		}
+		pos += written;
+		size -= written;
+	}
+	return 0;
+}
+
+// Writes sorted to a new run file in tmp_dir and maps it into run.
+// The file is unlinked straight away, so it disappears with the mapping, even if we crash.
+static int
+spill_run(col_table_t *sorted, const char *tmp_dir, ext_run_t *run) {
+	size_t chunk_size = get_chunk_size(sorted);
+	size_t num_rows = sorted->num_rows;
+	size_t num_cols = sorted->num_cols;
+
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/dbmv-run-XXXXXX", tmp_dir);
+	int fd = mkstemp(path);
+	if(fd < 0) {
+		ERROR("Could not create a run file in %s\n", tmp_dir);
+		return -1;
+	}
+	unlink(path);
+
+	ext_run_header_t header = { EXT_RUN_MAGIC, num_rows, num_cols };
+	int err = write_all(fd, &header, sizeof(header));
+	for(size_t col = 0; col < num_cols && !err; ++col) {
+		for(size_t chunk_no = 0; chunk_no * chunk_size < num_rows && !err; ++chunk_no) {
+			size_t n = MIN(chunk_size, num_rows - chunk_no * chunk_size);
+			err = write_all(fd, sorted->chunks[chunk_no]->columns[col]->data, n * sizeof(val_t));
+		}
+	}
+	if(err) {
+		ERROR("Could not write a run of %lu rows\n", num_rows);
+		close(fd);
+		return -1;
+	}
+
+	run->map_size = sizeof(header) + num_rows * num_cols * sizeof(val_t);
+	run->map = mmap(NULL, run->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(run->map == MAP_FAILED) {
+		ERROR("Could not map a run of %lu rows\n", num_rows);
+		return -1;
+	}
+	// every column of the run is read front to back during the merge
+	madvise(run->map, run->map_size, MADV_SEQUENTIAL);
+
+	run->num_rows = num_rows;
+	run->pos = 0;
+	run->cols = NEWA(val_t*, num_cols);
+	MALLOC_CHECK_INT(run->cols, "run columns");
+	val_t *data = (val_t *) ((char *) run->map + sizeof(header));
+	for(size_t col = 0; col < num_cols; ++col) {
+		run->cols[col] = data + col * num_rows;
+	}
+	return 0;
+}
+
+static void
+free_runs(ext_run_t *runs, size_t num_runs) {
+	for(size_t run = 0; run < num_runs; ++run) {
+		munmap(runs[run].map, runs[run].map_size);
+		my_free(runs[run].cols);
+	}
+	my_free(runs);
+}
+
+// the loser tree key of run's head: its sort key, then the run number so equal keys stay in input order
+static inline __attribute__((always_inline)) lt_key_t
+run_head_key(ext_run_t *run, size_t run_no, size_t col) {
+	if(run->pos == run->num_rows) {
+		return LT_KEY_DONE;
+	}
+	return (((lt_key_t) run->cols[col][run->pos]) << 32) | run_no;
+}
+
+int
+ext_sort(col_table_t *in, size_t col, size_t mem_budget, const char *tmp_dir, ext_consumer_t consumer, void *arg) {
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_cols = in->num_cols;
+	size_t num_rows = in->num_rows;
+	if(!tmp_dir) {
+		tmp_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+	}
+
+	// radixsort of a group needs a copy of its rows and two sort pairs per row
+	size_t group_row_bytes = num_cols * sizeof(val_t) + 2 * sizeof(sort_pair_t);
+	size_t group_chunks = MAX(1, mem_budget / (group_row_bytes * chunk_size));
+	size_t num_runs = (in->num_chunks + group_chunks - 1) / group_chunks;
+
+	ext_run_t *runs = NEWA(ext_run_t, num_runs);
+	MALLOC_CHECK_INT(runs, "runs");
+
+	int err = 0;
+	size_t spilled = 0;
+	for(size_t run = 0; run < num_runs; ++run) {
+		size_t first_chunk = run * group_chunks;
+		size_t stop_chunk = MIN(first_chunk + group_chunks, in->num_chunks);
+
+		// the group as a table of its own, which the sort then frees
+		col_table_t *group = NEW(col_table_t);
+		MALLOC_CHECK_INT(group, "group");
+		group->num_chunks = stop_chunk - first_chunk;
+		group->num_cols = num_cols;
+		group->num_rows = MIN(stop_chunk * chunk_size, num_rows) - first_chunk * chunk_size;
+		group->sorted_col = TABLE_UNSORTED;
+		group->chunks = NEWPA(table_chunk_t, group->num_chunks);
+		MALLOC_CHECK_INT(group->chunks, "group chunks");
+		for(size_t chunk_no = first_chunk; chunk_no < stop_chunk; ++chunk_no) {
+			group->chunks[chunk_no - first_chunk] = in->chunks[chunk_no];
+			in->chunks[chunk_no] = NULL;
+		}
+
+		col_table_t *sorted = radixsort(group, col, 0);
+		if(!sorted || spill_run(sorted, tmp_dir, &runs[run]) != 0) {
+			err = -1;
+		}
+		if(sorted) {
+			free_col_table(sorted);
+		}
+		if(err) {
+			// the rest of the input goes with in
+			for(size_t chunk_no = stop_chunk; chunk_no < in->num_chunks; ++chunk_no) {
+				free_table_chunk(in->chunks[chunk_no], num_cols);
+			}
+			break;
+		}
+		++spilled;
+	}
+	my_free(in->chunks);
+	my_free(in);
+	if(err) {
+		free_runs(runs, spilled);
+		return -1;
+	}
+
+	// k-way merge of the mapped runs, in blocks of chunk_size rows
+	val_t **out_cols = NEWA(val_t*, num_cols);
+	MALLOC_CHECK_INT(out_cols, "output block");
+	for(size_t out_col = 0; out_col < num_cols; ++out_col) {
+		out_cols[out_col] = NEWA(val_t, chunk_size);
+		MALLOC_CHECK_INT(out_cols[out_col], "output block column");
+	}
+
+	loser_tree_t lt;
+	lt_init(&lt, num_runs);
+	for(size_t run = 0; run < num_runs; ++run) {
+		lt.keys[run] = run_head_key(&runs[run], run, col);
+	}
+	lt_build(&lt);
+
+	size_t n = 0;
+	for(size_t row = 0; row < num_rows; ++row) {
+		size_t run_no = lt_winner(&lt);
+		ext_run_t *run = &runs[run_no];
+		for(size_t out_col = 0; out_col < num_cols; ++out_col) {
+			out_cols[out_col][n] = run->cols[out_col][run->pos];
+		}
+		++run->pos;
+		lt_replay(&lt, run_head_key(run, run_no, col));
+
+		if(++n == chunk_size) {
+			consumer(arg, out_cols, n);
+			n = 0;
+		}
+	}
+	if(n > 0) {
+		consumer(arg, out_cols, n);
+	}
+
+	lt_free(&lt);
+	for(size_t out_col = 0; out_col < num_cols; ++out_col) {
+		my_free(out_cols[out_col]);
+	}
+	my_free(out_cols);
+	free_runs(runs, num_runs);
+	return 0;
+}
+
+typedef struct {
+	col_table_t *out;
+	size_t chunk_size;
+	size_t next_chunk;
+} ext_table_sink_t;
+
+// appends one block as the next chunk of the output table
+static void
+ext_table_append(void *arg, val_t **cols, size_t num_rows) {
+	ext_table_sink_t *sink = (ext_table_sink_t *) arg;
+	col_table_t *out = sink->out;
+
+	table_chunk_t *chunk = NEW(table_chunk_t);
+	MALLOC_CHECK_VOID(chunk, "chunk");
+	chunk->columns = NEWPA(column_chunk_t, out->num_cols);
+	MALLOC_CHECK_VOID(chunk->columns, "columns array");
+	for(size_t col = 0; col < out->num_cols; ++col) {
+		chunk->columns[col] = create_col_chunk(sink->chunk_size);
+		MALLOC_CHECK_VOID(chunk->columns[col], "column");
+		memcpy(chunk->columns[col]->data, cols[col], num_rows * sizeof(val_t));
+		set_col_chunk_zone(chunk->columns[col], num_rows);
+	}
+	out->chunks[sink->next_chunk++] = chunk;
+	out->num_rows += num_rows;
+}
+
+col_table_t *
+externalsort(col_table_t *in, size_t col, size_t mem_budget) {
+	ext_table_sink_t sink;
+	sink.chunk_size = get_chunk_size(in);
+	sink.next_chunk = 0;
+
+	sink.out = NEW(col_table_t);
+	MALLOC_CHECK(sink.out, "table");
+	sink.out->num_chunks = in->num_chunks;
+	sink.out->num_cols = in->num_cols;
+	sink.out->num_rows = 0;
+	sink.out->sorted_col = TABLE_UNSORTED;
+	sink.out->chunks = NEWPA(table_chunk_t, in->num_chunks);
+	MALLOC_CHECK(sink.out->chunks, "chunks array");
+
+	if(ext_sort(in, col, mem_budget, NULL, ext_table_append, &sink) != 0) {
+		// only the chunks appended so far exist
+		sink.out->num_chunks = sink.next_chunk;
+		free_col_table(sink.out);
+		return NULL;
+	}
+	sink.out->sorted_col = col;
+	return sink.out;
+}
+
+#endif
@@ -0,0 +1,333 @@
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <assert.h>
+	#include <string.h>
+#endif
+
+#include "app/database/common.h"
+#include "app/database/cursor.h"
+#include "app/database/join.h"
+#include "app/database/operators.h"
+
+// A build partition's hash table is its (hash, row) pairs, a chain link per row and about a bucket head per row.
+// Partitions are made small enough for it to take at most JOIN_PARTITION_BYTES,
+// half of a 256KiB L2, so the probe partition streaming past does not evict it.
+#define JOIN_ROW_BYTES (sizeof(sort_pair_t) + 2 * sizeof(uint32_t))
+#define JOIN_PARTITION_BYTES (128 * 1024)
+// at most two partitioning passes of radix_sort_pairs
+#define JOIN_MAX_RADIX_BITS 22
+
+// Sort-merge join sorts an unsorted side with the default sort if its keys are below this,
+// since countingsort needs chunk_size offsets per key value, and with radixsort otherwise
+// or if its last chunk is not full, which countingsort would sort whole.
+#define JOIN_COUNTING_MAX_DOMAIN 1024
+
+// Multiplying by an odd constant is a bijection on 32 bits, so equal hashes mean equal keys,
+// and the pairs carry the hash in place of the key. Its top bits are the well-mixed ones.
+#define JOIN_HASH(key) ((val_t) ((key) * 2654435761u))
+
+// the partition of a (hash, row) pair
+#define JOIN_PARTITION(pair, radix_bits) ((radix_bits) > 0 ? (size_t) ((pair) >> (64 - (radix_bits))) : 0)
+
+// (hash, row) for every row of t
+static void
+join_pairs(col_table_t *t, size_t col, sort_pair_t *pairs) {
+	size_t row = 0;
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		const val_t *keys = t->chunks[chunk_no]->columns[col]->data;
+		size_t n = get_chunk_rows(t, chunk_no);
+		for(size_t i = 0; i < n; ++i, ++row) {
+			pairs[row] = SORT_PAIR(JOIN_HASH(keys[i]), row);
+		}
+	}
+}
+
+// The (hash, row) pairs of t partitioned on the top radix_bits bits of the hash, in row order within a partition;
+// starts[p] is the first pair of partition p, and starts[1 << radix_bits] the number of pairs.
+static sort_pair_t *
+join_partition(col_table_t *t, size_t col, unsigned radix_bits, size_t *starts) {
+	size_t n = t->num_rows;
+	sort_pair_t *pairs = NEWA(sort_pair_t, MAX(1, n));
+	MALLOC_CHECK(pairs, "join pairs");
+	sort_pair_t *tmp = NEWA(sort_pair_t, MAX(1, n));
+	MALLOC_CHECK(tmp, "join pairs scratch");
+	join_pairs(t, col, pairs);
+
+	sort_pair_t *partitioned = radix_sort_pairs(pairs, tmp, n, 64 - radix_bits, 64);
+	my_free(partitioned == pairs ? tmp : pairs);
+
+	size_t num_partitions = (size_t) 1 << radix_bits;
+	memset(starts, 0, (num_partitions + 1) * sizeof(size_t));
+	for(size_t i = 0; i < n; ++i) {
+		++starts[JOIN_PARTITION(partitioned[i], radix_bits) + 1];
+	}
+	for(size_t p = 0; p < num_partitions; ++p) {
+		starts[p + 1] += starts[p];
+	}
+	return partitioned;
+}
+
+// the matching rows found so far, by location in build and in probe
+typedef struct {
+	row_loc_t *build;
+	row_loc_t *probe;
+	size_t num;
+	size_t cap;
+} join_matches_t;
+
+static int
+join_matches_grow(join_matches_t *m) {
+	size_t cap = 2 * m->cap;
+	row_loc_t *build = NEWA(row_loc_t, cap);
+	MALLOC_CHECK_INT(build, "join matches");
+	row_loc_t *probe = NEWA(row_loc_t, cap);
+	MALLOC_CHECK_INT(probe, "join matches");
+	memcpy(build, m->build, m->num * sizeof(row_loc_t));
+	memcpy(probe, m->probe, m->num * sizeof(row_loc_t));
+	my_free(m->build);
+	my_free(m->probe);
+	m->build = build;
+	m->probe = probe;
+	m->cap = cap;
+	return 0;
+}
+
+static int
+join_matches_init(join_matches_t *m, size_t cap) {
+	m->num = 0;
+	m->cap = MAX(1, cap);
+	m->build = NEWA(row_loc_t, m->cap);
+	MALLOC_CHECK_INT(m->build, "join matches");
+	m->probe = NEWA(row_loc_t, m->cap);
+	MALLOC_CHECK_INT(m->probe, "join matches");
+	return 0;
+}
+
+static void
+join_matches_free(join_matches_t *m) {
+	my_free(m->build);
+	my_free(m->probe);
+}
+
+// appends one match, growing m as needed; -1 if that fails
+static inline __attribute__((always_inline)) int
+join_add_match(join_matches_t *m, row_loc_t build, row_loc_t probe) {
+	if(m->num == m->cap && join_matches_grow(m) != 0) {
+		return -1;
+	}
+	m->build[m->num] = build;
+	m->probe[m->num] = probe;
+	++m->num;
+	return 0;
+}
+
+// A table of the matching rows: the build columns gathered from build, then the probe columns from probe.
+// The matches and both inputs are freed, even if this fails.
+static col_table_t *
+join_gather(col_table_t *build, col_table_t *probe, join_matches_t *m) {
+	col_table_t *out = create_col_table_empty(m->num, get_chunk_size(probe), build->num_cols + probe->num_cols);
+	if(out) {
+		gather_cols(build, NULL, build->num_cols, m->build, m->num, out, 0);
+		gather_cols(probe, NULL, probe->num_cols, m->probe, m->num, out, build->num_cols);
+	}
+	join_matches_free(m);
+	free_col_table(build);
+	free_col_table(probe);
+	MALLOC_CHECK(out, "join result");
+	return out;
+}
+
+// for a join which fails after allocating its matches
+static col_table_t *
+join_fail(col_table_t *build, col_table_t *probe, join_matches_t *m) {
+	join_matches_free(m);
+	free_col_table(build);
+	free_col_table(probe);
+	return NULL;
+}
+
+col_table_t *
+radix_hash_join(col_table_t *build, size_t build_col, col_table_t *probe, size_t probe_col) {
+	assert(build->num_rows < ((size_t) 1 << 32) && probe->num_rows < ((size_t) 1 << 32));
+	size_t build_chunk_size = get_chunk_size(build);
+	size_t probe_chunk_size = get_chunk_size(probe);
+
+	unsigned radix_bits = 0;
+	while(radix_bits < JOIN_MAX_RADIX_BITS && (build->num_rows >> radix_bits) * JOIN_ROW_BYTES > JOIN_PARTITION_BYTES) {
+		++radix_bits;
+	}
+	size_t num_partitions = (size_t) 1 << radix_bits;
+
+	size_t *build_starts = NEWA(size_t, num_partitions + 1);
+	MALLOC_CHECK(build_starts, "build partitions");
+	size_t *probe_starts = NEWA(size_t, num_partitions + 1);
+	MALLOC_CHECK(probe_starts, "probe partitions");
+	sort_pair_t *build_pairs = join_partition(build, build_col, radix_bits, build_starts);
+	MALLOC_CHECK(build_pairs, "build pairs");
+	sort_pair_t *probe_pairs = join_partition(probe, probe_col, radix_bits, probe_starts);
+	MALLOC_CHECK(probe_pairs, "probe pairs");
+
+	// one hash table, for the largest build partition, serves every partition in turn
+	size_t max_rows = 0;
+	for(size_t p = 0; p < num_partitions; ++p) {
+		max_rows = MAX(max_rows, build_starts[p + 1] - build_starts[p]);
+	}
+	unsigned max_bucket_bits = 0;
+	while(((size_t) 1 << max_bucket_bits) < max_rows) {
+		++max_bucket_bits;
+	}
+	uint32_t *heads = NEWA(uint32_t, (size_t) 1 << max_bucket_bits);
+	MALLOC_CHECK(heads, "hash table buckets");
+	uint32_t *next = NEWA(uint32_t, MAX(1, max_rows));
+	MALLOC_CHECK(next, "hash table chains");
+
+	join_matches_t m;
+	if(join_matches_init(&m, probe->num_rows) != 0) {
+		return NULL;
+	}
+
+	int status = 0;
+	for(size_t p = 0; p < num_partitions && status == 0; ++p) {
+		const sort_pair_t *b = build_pairs + build_starts[p];
+		size_t num_build = build_starts[p + 1] - build_starts[p];
+		if(num_build == 0 || probe_starts[p + 1] == probe_starts[p]) {
+			continue;
+		}
+		unsigned bucket_bits = 0;
+		while(((size_t) 1 << bucket_bits) < num_build) {
+			++bucket_bits;
+		}
+		size_t mask = ((size_t) 1 << bucket_bits) - 1;
+		// buckets on the bits of the hash just below the partition's
+		unsigned shift = radix_bits + bucket_bits < 32 ? 32 - radix_bits - bucket_bits : 0;
+
+		// Entries are 1-based, so 0 ends a chain. Inserting back to front at the heads of the chains
+		// leaves every chain in build order.
+		memset(heads, 0, (mask + 1) * sizeof(uint32_t));
+		for(size_t i = num_build; i > 0; --i) {
+			size_t bucket = ((size_t) SORT_PAIR_KEY(b[i - 1]) >> shift) & mask;
+			next[i - 1] = heads[bucket];
+			heads[bucket] = i;
+		}
+
+		for(size_t i = probe_starts[p]; i < probe_starts[p + 1] && status == 0; ++i) {
+			val_t hash = SORT_PAIR_KEY(probe_pairs[i]);
+			size_t probe_row = SORT_PAIR_ROW(probe_pairs[i]);
+			for(uint32_t e = heads[((size_t) hash >> shift) & mask]; e != 0; e = next[e - 1]) {
+				if(SORT_PAIR_KEY(b[e - 1]) != hash) {
+					continue;
+				}
+				size_t build_row = SORT_PAIR_ROW(b[e - 1]);
+				if(join_add_match(&m, ROW_LOC(build_row / build_chunk_size, build_row % build_chunk_size),
+								  ROW_LOC(probe_row / probe_chunk_size, probe_row % probe_chunk_size)) != 0) {
+					status = -1;
+					break;
+				}
+			}
+		}
+	}
+
+	my_free(heads);
+	my_free(next);
+	my_free(build_pairs);
+	my_free(probe_pairs);
+	my_free(build_starts);
+	my_free(probe_starts);
+
+	if(status != 0) {
+		return join_fail(build, probe, &m);
+	}
+	return join_gather(build, probe, &m);
+}
+
+// t sorted on col, as it is if it already is
+static col_table_t *
+join_sorted(col_table_t *t, size_t col) {
+	if(t->sorted_col == col) {
+		return t;
+	}
+	size_t domain_size = col_domain_size(t, col);
+	if(domain_size <= JOIN_COUNTING_MAX_DOMAIN && t->num_rows == t->num_chunks * get_chunk_size(t)) {
+		return default_impls[SORT](t, col, domain_size);
+	}
+	return radixsort(t, col, domain_size);
+}
+
+col_table_t *
+sortmerge_join(col_table_t *build, size_t build_col, col_table_t *probe, size_t probe_col) {
+	build = join_sorted(build, build_col);
+	MALLOC_CHECK(build, "sorted build side");
+	probe = join_sorted(probe, probe_col);
+	MALLOC_CHECK(probe, "sorted probe side");
+	size_t build_chunk_size = get_chunk_size(build);
+	size_t probe_chunk_size = get_chunk_size(probe);
+
+	join_matches_t m;
+	if(join_matches_init(&m, probe->num_rows) != 0) {
+		return NULL;
+	}
+
+	size_t b_row = 0, b_chunk_no, b_offset;
+	table_chunk_t b_chunk;
+	val_t *b_col = NULL;
+	val_t b_val = 0;
+	load_row(build, build_chunk_size, b_row, build_col, &b_chunk_no, &b_offset, &b_chunk, &b_col, &b_val);
+	size_t p_row = 0, p_chunk_no, p_offset;
+	table_chunk_t p_chunk;
+	val_t *p_col = NULL;
+	val_t p_val = 0;
+	load_row(probe, probe_chunk_size, p_row, probe_col, &p_chunk_no, &p_offset, &p_chunk, &p_col, &p_val);
+
+	while(b_row < build->num_rows && p_row < probe->num_rows) {
+		if(b_val < p_val) {
+			++b_row;
+			load_next_row(build, build_chunk_size, build_col, &b_chunk_no, &b_offset, &b_chunk, &b_col, &b_val);
+			continue;
+		}
+		if(p_val < b_val) {
+			++p_row;
+			load_next_row(probe, probe_chunk_size, probe_col, &p_chunk_no, &p_offset, &p_chunk, &p_col, &p_val);
+			continue;
+		}
+
+		// A group of equal keys on both sides: the build group is paired with the first probe row of its group,
+		// and every other probe row gets a block copy of those build locations.
+		val_t key = b_val;
+		size_t first = m.num;
+		row_loc_t probe_loc = ROW_LOC(p_chunk_no, p_offset);
+		do {
+			if(join_add_match(&m, ROW_LOC(b_chunk_no, b_offset), probe_loc) != 0) {
+				return join_fail(build, probe, &m);
+			}
+			++b_row;
+			load_next_row(build, build_chunk_size, build_col, &b_chunk_no, &b_offset, &b_chunk, &b_col, &b_val);
+		} while(b_row < build->num_rows && b_val == key);
+		size_t group = m.num - first;
+
+		++p_row;
+		load_next_row(probe, probe_chunk_size, probe_col, &p_chunk_no, &p_offset, &p_chunk, &p_col, &p_val);
+		while(p_row < probe->num_rows && p_val == key) {
+			while(m.num + group > m.cap) {
+				if(join_matches_grow(&m) != 0) {
+					return join_fail(build, probe, &m);
+				}
+			}
+			memcpy(m.build + m.num, m.build + first, group * sizeof(row_loc_t));
+			probe_loc = ROW_LOC(p_chunk_no, p_offset);
+			for(size_t i = 0; i < group; ++i) {
+				m.probe[m.num + i] = probe_loc;
+			}
+			m.num += group;
+			++p_row;
+			load_next_row(probe, probe_chunk_size, probe_col, &p_chunk_no, &p_offset, &p_chunk, &p_col, &p_val);
+		}
+	}
+
+	col_table_t *out = join_gather(build, probe, &m);
+	if(out) {
+		// the matches were found in key order
+		out->sorted_col = build_col;
+	}
+	return out;
+}
@@ -0,0 +1,47 @@
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stdbool.h>
+#endif
+
+#include "app/database/common.h"
+#include "app/database/losertree.h"
+
+void lt_init(loser_tree_t *lt, size_t num_runs) {
+	lt->k = 1;
+	while(lt->k < num_runs) {
+		lt->k *= 2;
+	}
+	lt->tree = NEWA(size_t, lt->k);
+	MALLOC_CHECK_VOID(lt->tree, "loser tree");
+	lt->winners = NEWA(size_t, 2 * lt->k);
+	MALLOC_CHECK_VOID(lt->winners, "loser tree winners");
+	lt->keys = NEWA(lt_key_t, lt->k);
+	MALLOC_CHECK_VOID(lt->keys, "loser tree keys");
+	// padding leaves are empty runs
+	for(size_t run = 0; run < lt->k; ++run) {
+		lt->keys[run] = LT_KEY_DONE;
+	}
+}
+
+void lt_free(loser_tree_t *lt) {
+	my_free(lt->tree);
+	my_free(lt->winners);
+	my_free(lt->keys);
+}
+
+void lt_build(loser_tree_t *lt) {
+	// leaf run is node k + run
+	size_t k = lt->k;
+	for(size_t run = 0; run < k; ++run) {
+		lt->winners[k + run] = run;
+	}
+	for(size_t node = k - 1; node > 0; --node) {
+		size_t a = lt->winners[2 * node];
+		size_t b = lt->winners[2 * node + 1];
+		bool a_wins = lt->keys[a] <= lt->keys[b];
+		lt->winners[node] = a_wins ? a : b;
+		lt->tree[node] = a_wins ? b : a;
+	}
+	lt->tree[0] = k > 1 ? lt->winners[1] : 0;
+}
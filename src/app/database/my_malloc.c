@@ -42,11 +42,11 @@
 		/* 	my_malloc_init(REPLACE_MALLOC_DEFAULT_SIZE); */
 		/* } */
 
-		void* your_block = unoccupied;
-		unoccupied += size;
+		// operators allocate from several threads at once
+		void* your_block = __sync_fetch_and_add(&unoccupied, size);
 		#ifndef NDEBUG
-			if(unoccupied > allocation + alloc_size) {
-				printf("tried to allocate %ld > %lu\n", (unoccupied - allocation), alloc_size);
+			if(your_block + size > allocation + alloc_size) {
+				printf("tried to allocate %ld > %lu\n", (your_block + size - allocation), alloc_size);
 				exit(1);
 			}
 		#endif
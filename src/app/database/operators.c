@@ -14,30 +14,52 @@
 #include "app/database/common.h"
 #include "app/database/operators.h"
 #include "app/database/bitvec.h"
+#include "app/database/cursor.h"
+#include "app/database/parallel.h"
+#include "app/database/losertree.h"
+#include "app/database/simd.h"
+#include "app/database/join.h"
+#include "app/database/aggregate.h"
+#include "app/database/selection.h"
+#include "app/database/timing.h"
 
 // function declarations
 col_table_t *projection(col_table_t *t, size_t *pos, size_t num_proj);
 col_table_t *selection_const (col_table_t *t, size_t col, val_t val);
 col_table_t *basic_rowise_selection_const (col_table_t *t, size_t col, val_t val);
 col_table_t *scatter_gather_selection_const (col_table_t *t, size_t col, val_t val);
+col_table_t *selection_att (col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b);
+col_table_t *basic_rowise_selection_att (col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b);
+col_table_t *scatter_gather_selection_att (col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b);
+col_table_t *selection_pred (col_table_t *t, size_t col, const predicate_t *pred);
+col_table_t *basic_rowise_selection_pred (col_table_t *t, size_t col, const predicate_t *pred);
+col_table_t *scatter_gather_selection_pred (col_table_t *t, size_t col, const predicate_t *pred);
 /* col_table_t * mergesort(col_table_t *in, size_t col, size_t); */
 /* col_table_t * countingsort(col_table_t *in, size_t col, size_t domain_size); */
 /* col_table_t * mergecountingsort(col_table_t *in, size_t col, size_t domain_size); */
 col_table_t *countingmergesort(col_table_t *in, size_t col, size_t domain_size);
+col_table_t *parallelcountingmergesort(col_table_t *in, size_t col, size_t domain_size);
+col_table_t *radixsort(col_table_t *in, size_t col, size_t domain_size);
+col_table_t *globalcountingsort(col_table_t *in, size_t col, size_t domain_size);
+col_table_t *countingkwaymergesort(col_table_t *in, size_t col, size_t domain_size);
+col_table_t *latecountingmergesort(col_table_t *in, size_t col, size_t domain_size);
+col_table_t *multikeysort(col_table_t *in, const sort_key_t *keys, size_t num_keys);
+col_table_t *topk(col_table_t *in, size_t col, size_t domain_size, size_t k);
+col_table_t *adaptivesort(col_table_t *in, size_t col, size_t domain_size);
 bool check_sorted_helper(col_table_t *result, size_t start_row, size_t stop_row, size_t sort_col);
 // information about operator implementations
 op_implementation_info_t impl_infos[] = {
 		{
 				SELECTION_CONST,
-				{ "row", "col", "scattergather", NULL, NULL },
-				{ basic_rowise_selection_const, selection_const, scatter_gather_selection_const, NULL, NULL },
-				3
+				{ "row", "col", "scattergather", "bitmap", "adaptive", NULL },
+				{ basic_rowise_selection_const, selection_const, scatter_gather_selection_const, bitmap_selection_const, adaptive_selection_const, NULL },
+				5
 		},
 		{
 				SELECTION_ATT,
-				{ NULL, NULL, NULL, NULL, NULL },
-				{ NULL, NULL, NULL, NULL, NULL },
-				0
+				{ "row", "col", "scattergather", "bitmap", NULL },
+				{ basic_rowise_selection_att, selection_att, scatter_gather_selection_att, bitmap_selection_att, NULL },
+				4
 		},
 		{
 				PROJECTION,
@@ -47,20 +69,76 @@ op_implementation_info_t impl_infos[] = {
 		},
 		{
 				SORT,
-				{"mergesort", "countingsort", "mergecountingsort", "countingmergesort", NULL},
-				{ NULL ,  NULL ,  NULL ,  countingmergesort , NULL},
-				4
+				{"mergesort", "countingsort", "mergecountingsort", "countingmergesort", "parallelcountingmergesort", "radixsort", "globalcountingsort", "countingkwaymergesort", "latecountingmergesort", "adaptivesort", "autocountingsort"},
+				{ NULL ,  NULL ,  NULL ,  countingmergesort , parallelcountingmergesort, radixsort, globalcountingsort, countingkwaymergesort, latecountingmergesort, adaptivesort, autocountingsort},
+				11
 				// TODO: look into glibc/Python sort
 				// http://sourceware.org/git/?p=glibc.git;a=blob;f=stdlib/qsort.c;h=264a06b8a924a1627b3c0fd507a3e2ca38dbc8a0;hb=HEAD
 				// http://sourceware.org/git/?p=glibc.git;a=blob;f=stdlib/msort.c;h=266c2538c07e86d058359d47388fe21cbfdb525a;hb=HEAD
 		},
+		{
+				MULTI_SORT,
+				{ "multikeysort" },
+				{ multikeysort },
+				1
+		},
+		{
+				TOPK,
+				{ "topk" },
+				{ topk },
+				1
+		},
+		{
+				SELECTION_PRED,
+				{ "row", "col", "scattergather", "bitmap", "parallel", "adaptive", NULL },
+				{ basic_rowise_selection_pred, selection_pred, scatter_gather_selection_pred, bitmap_selection_pred, parallel_selection_pred, adaptive_selection_pred, NULL },
+				6
+		},
+		{
+				FILTER,
+				{ "bitmap" },
+				{ filter },
+				1
+		},
+		{
+				SELECT_PROJECT,
+				{ "pipeline", "fused" },
+				{ pipeline_select_project, bitmap_select_project },
+				2
+		},
+		{
+				JOIN,
+				{ "radix", "sortmerge" },
+				{ radix_hash_join, sortmerge_join },
+				2
+		},
+		{
+				GROUP_BY,
+				{ "serial", "parallel" },
+				{ group_by, parallel_group_by },
+				2
+		},
+		{
+				DISTINCT,
+				{ "hash", "adaptive" },
+				{ hash_distinct, distinct },
+				2
+		},
 };
 
 op_implementation_t default_impls[] = {
-		basic_rowise_selection_const, // SELECTION_CONST
-		NULL, // SELECTION_ATT
+		adaptive_selection_const, // SELECTION_CONST
+		basic_rowise_selection_att, // SELECTION_ATT
 		projection, // PROJECTION
-		countingmergesort,
+		autocountingsort, // SORT
+		multikeysort, // MULTI_SORT
+		topk, // TOPK
+		adaptive_selection_pred, // SELECTION_PRED
+		filter, // FILTER
+		bitmap_select_project, // SELECT_PROJECT
+		radix_hash_join, // JOIN
+		group_by, // GROUP_BY
+		distinct, // DISTINCT
 };
 
 const char * op_names[] = {
@@ -68,6 +146,23 @@ const char * op_names[] = {
 		[SELECTION_ATT] = "selection_att",
 		[PROJECTION] = "projection",
 		[SORT] = "sort",
+		[MULTI_SORT] = "multi_sort",
+		[TOPK] = "topk",
+		[SELECTION_PRED] = "selection_pred",
+		[FILTER] = "filter",
+		[SELECT_PROJECT] = "select_project",
+		[JOIN] = "join",
+		[GROUP_BY] = "group_by",
+		[DISTINCT] = "distinct",
+};
+
+const char *cmp_op_names[] = {
+		[CMP_EQ] = "=",
+		[CMP_NE] = "<>",
+		[CMP_LT] = "<",
+		[CMP_LE] = "<=",
+		[CMP_GT] = ">",
+		[CMP_GE] = ">=",
 };
 
 
@@ -78,6 +173,7 @@ unsigned long C_MERGE = 0;
 unsigned long C_READITER = 0;
 
 // projection only changes the schema
+
 col_table_t *
 projection(col_table_t *t, size_t *pos, size_t num_proj) {
 	for(size_t i = 0; i < t->num_chunks; i++) {
@@ -113,16 +209,309 @@ projection(col_table_t *t, size_t *pos, size_t num_proj) {
 		my_free(colRetained);
 	}
 	t->num_cols = num_proj;
+	t->sorted_col = projected_sorted_col(t->sorted_col, pos, num_proj);
 
 	return t;
 }
 
+// Selections.
+// Each strategy is a kernel stamped out once per predicate form (see selection.h) and kind of right operand,
+// with both fixed at compile time, so no loop switches on them.
+// For a predicate on one column, b aliases a and is not read.
+#define OPERAND_CONST(b, p, row) ((p)->val)
+#define OPERAND_ATT(b, p, row) ((b)[row])
+
+// The rowise and colwise kernels append the matches of chunks [first_chunk:stop_chunk] of t to r,
+// whose chunks are full but the last one, which is used up to r->num_rows.
+typedef void (*rowise_select_kernel_t)(col_table_t *t, size_t first_chunk, size_t stop_chunk,
+									   size_t col_a, size_t col_b, const pred_args_t *p, col_table_t *r);
+typedef void (*colwise_select_kernel_t)(col_table_t *t, size_t first_chunk, size_t stop_chunk,
+										size_t col_a, size_t col_b, const pred_args_t *p, col_table_t *r);
+typedef size_t (*scatter_select_kernel_t)(col_table_t *t, size_t col_a, size_t col_b, const pred_args_t *p, row_loc_t *locs);
+
+typedef struct {
+	rowise_select_kernel_t rowise;
+	colwise_select_kernel_t colwise;
+	scatter_select_kernel_t scatter;
+} select_kernels_t;
+
+// a new chunk at the end of a selection result
+static table_chunk_t *
+append_selection_chunk(col_table_t *r, size_t chunk_size) {
+	table_chunk_t *chunk = create_table_chunk(chunk_size, r->num_cols);
+	MALLOC_CHECK(chunk, "result chunk");
+	r->chunks[r->num_chunks++] = chunk;
+	return chunk;
+}
+
+// Appends rows [0:n] of tc to r, whose last chunk *out_chunk is used up to *out_pos,
+// a memcpy per column and output chunk; for chunks whose zone maps say every row matches.
+static void
+append_selection_rows(col_table_t *r, table_chunk_t *tc, size_t n, table_chunk_t **out_chunk, size_t *out_pos) {
+	size_t chunk_size = get_chunk_size(r);
+	for(size_t start = 0; start < n; ) {
+		if(*out_pos == chunk_size) {
+			*out_chunk = append_selection_chunk(r, chunk_size);
+			MALLOC_CHECK_VOID(*out_chunk, "result chunk");
+			*out_pos = 0;
+		}
+		size_t m = MIN(n - start, chunk_size - *out_pos);
+		for(size_t col = 0; col < r->num_cols; ++col) {
+			memcpy((*out_chunk)->columns[col]->data + *out_pos, tc->columns[col]->data + start, m * sizeof(val_t));
+		}
+		*out_pos += m;
+		r->num_rows += m;
+		start += m;
+	}
+}
+
+// The kernels copy *p first, so the predicate's arguments stay in registers
+// instead of being reloaded after every store to the result.
+// Chunks whose zone maps rule every row in or out are copied whole or skipped without reading them.
+#define DEFINE_SELECT_KERNELS(name, MATCH, OPERAND, ATT) \
+	/* copies every column of each matching row */ \
+	static void \
+	rowise_select_##name(col_table_t *t, size_t first_chunk, size_t stop_chunk, \
+					size_t col_a, size_t col_b, const pred_args_t *p, col_table_t *r) { \
+		const pred_args_t args __attribute__((unused)) = *p; \
+		size_t chunk_size = get_chunk_size(t); \
+		table_chunk_t *out_chunk = r->chunks[r->num_chunks - 1]; \
+		size_t out_pos = r->num_rows - (r->num_chunks - 1) * chunk_size; \
+		for(size_t chunk_no = first_chunk; chunk_no < stop_chunk; ++chunk_no) { \
+			table_chunk_t *tc = t->chunks[chunk_no]; \
+			const val_t *a = tc->columns[col_a]->data; \
+			const val_t *b = tc->columns[col_b]->data; \
+			size_t n = get_chunk_rows(t, chunk_no); \
+			(void) b; \
+			zone_match_t zone = chunk_zone_match(&args, tc->columns[col_a], tc->columns[col_b], ATT); \
+			if(zone != ZONE_SOME) { \
+				if(zone == ZONE_ALL) { \
+					append_selection_rows(r, tc, n, &out_chunk, &out_pos); \
+				} \
+				continue; \
+			} \
+			for(size_t row = 0; row < n; ++row) { \
+				if(MATCH(a[row], OPERAND(b, &args, row), &args)) { \
+					if(out_pos == chunk_size) { \
+						out_chunk = append_selection_chunk(r, chunk_size); \
+						MALLOC_CHECK_VOID(out_chunk, "result chunk"); \
+						out_pos = 0; \
+					} \
+					for(size_t col = 0; col < t->num_cols; ++col) { \
+						out_chunk->columns[col]->data[out_pos] = tc->columns[col]->data[row]; \
+					} \
+					++out_pos; \
+					++r->num_rows; \
+				} \
+			} \
+		} \
+	} \
+	\
+	/* one column at a time, branch-free: every value is written, */ \
+	/* but the output position only advances past matching ones */ \
+	static void \
+	colwise_select_##name(col_table_t *t, size_t first_chunk, size_t stop_chunk, \
+					size_t col_a, size_t col_b, const pred_args_t *p, col_table_t *r) { \
+		const pred_args_t args __attribute__((unused)) = *p; \
+		size_t chunk_size = get_chunk_size(t); \
+		table_chunk_t *out_chunk = r->chunks[r->num_chunks - 1]; \
+		size_t out_pos = r->num_rows - (r->num_chunks - 1) * chunk_size; \
+		for(size_t chunk_no = first_chunk; chunk_no < stop_chunk; ++chunk_no) { \
+			table_chunk_t *tc = t->chunks[chunk_no]; \
+			const val_t *a = tc->columns[col_a]->data; \
+			const val_t *b = tc->columns[col_b]->data; \
+			size_t n = get_chunk_rows(t, chunk_no); \
+			(void) b; \
+			zone_match_t zone = chunk_zone_match(&args, tc->columns[col_a], tc->columns[col_b], ATT); \
+			if(zone != ZONE_SOME) { \
+				if(zone == ZONE_ALL) { \
+					append_selection_rows(r, tc, n, &out_chunk, &out_pos); \
+				} \
+				continue; \
+			} \
+			for(size_t start = 0; start < n; ) { \
+				if(out_pos == chunk_size) { \
+					out_chunk = append_selection_chunk(r, chunk_size); \
+					MALLOC_CHECK_VOID(out_chunk, "result chunk"); \
+					out_pos = 0; \
+				} \
+				/* no more rows than the output chunk has room for, so no write crosses it */ \
+				size_t stop = start + MIN(n - start, chunk_size - out_pos); \
+				size_t stop_pos = out_pos; \
+				for(size_t col = 0; col < t->num_cols; ++col) { \
+					const val_t *in = tc->columns[col]->data; \
+					val_t *out = out_chunk->columns[col]->data; \
+					stop_pos = out_pos; \
+					for(size_t row = start; row < stop; ++row) { \
+						out[stop_pos] = in[row]; \
+						stop_pos += MATCH(a[row], OPERAND(b, &args, row), &args); \
+					} \
+				} \
+				r->num_rows += stop_pos - out_pos; \
+				out_pos = stop_pos; \
+				start = stop; \
+			} \
+		} \
+	} \
+	\
+	/* writes the location of every matching row to locs[0:returned], branch-free; */ \
+	/* locs needs room for one more than the number of rows */ \
+	static size_t \
+	scatter_select_##name(col_table_t *t, size_t col_a, size_t col_b, const pred_args_t *p, row_loc_t *locs) { \
+		const pred_args_t args __attribute__((unused)) = *p; \
+		size_t num_locs = 0; \
+		for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) { \
+			table_chunk_t *tc = t->chunks[chunk_no]; \
+			const val_t *a = tc->columns[col_a]->data; \
+			const val_t *b = tc->columns[col_b]->data; \
+			size_t n = get_chunk_rows(t, chunk_no); \
+			(void) b; \
+			zone_match_t zone = chunk_zone_match(&args, tc->columns[col_a], tc->columns[col_b], ATT); \
+			if(zone != ZONE_SOME) { \
+				for(size_t row = 0; zone == ZONE_ALL && row < n; ++row) { \
+					locs[num_locs++] = ROW_LOC(chunk_no, row); \
+				} \
+				continue; \
+			} \
+			for(size_t row = 0; row < n; ++row) { \
+				locs[num_locs] = ROW_LOC(chunk_no, row); \
+				num_locs += MATCH(a[row], OPERAND(b, &args, row), &args); \
+			} \
+		} \
+		return num_locs; \
+	}
+
+#define SELECT_KERNELS(name) { rowise_select_##name, colwise_select_##name, scatter_select_##name }
+
+DEFINE_SELECT_KERNELS(const_eq, PRED_EQ_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(const_ne, PRED_NE_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(const_lt, PRED_LT_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(const_le, PRED_LE_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(const_gt, PRED_GT_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(const_ge, PRED_GE_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(between, PRED_BETWEEN_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(in_lookup, PRED_IN_LOOKUP_MATCH, OPERAND_CONST, false)
+DEFINE_SELECT_KERNELS(in_list, PRED_IN_LIST_MATCH, OPERAND_CONST, false)
+
+DEFINE_SELECT_KERNELS(att_eq, PRED_EQ_MATCH, OPERAND_ATT, true)
+DEFINE_SELECT_KERNELS(att_ne, PRED_NE_MATCH, OPERAND_ATT, true)
+DEFINE_SELECT_KERNELS(att_lt, PRED_LT_MATCH, OPERAND_ATT, true)
+DEFINE_SELECT_KERNELS(att_le, PRED_LE_MATCH, OPERAND_ATT, true)
+DEFINE_SELECT_KERNELS(att_gt, PRED_GT_MATCH, OPERAND_ATT, true)
+DEFINE_SELECT_KERNELS(att_ge, PRED_GE_MATCH, OPERAND_ATT, true)
+
+static select_kernels_t const_kernels[NUM_CMPS] = {
+		[CMP_EQ] = SELECT_KERNELS(const_eq),
+		[CMP_NE] = SELECT_KERNELS(const_ne),
+		[CMP_LT] = SELECT_KERNELS(const_lt),
+		[CMP_LE] = SELECT_KERNELS(const_le),
+		[CMP_GT] = SELECT_KERNELS(const_gt),
+		[CMP_GE] = SELECT_KERNELS(const_ge),
+};
+
+static select_kernels_t att_kernels[NUM_CMPS] = {
+		[CMP_EQ] = SELECT_KERNELS(att_eq),
+		[CMP_NE] = SELECT_KERNELS(att_ne),
+		[CMP_LT] = SELECT_KERNELS(att_lt),
+		[CMP_LE] = SELECT_KERNELS(att_le),
+		[CMP_GT] = SELECT_KERNELS(att_gt),
+		[CMP_GE] = SELECT_KERNELS(att_ge),
+};
+
+// for every form but PRED_FORM_CMP
+static select_kernels_t form_kernels[NUM_PRED_FORMS] = {
+		[PRED_FORM_BETWEEN]   = SELECT_KERNELS(between),
+		[PRED_FORM_IN_LOOKUP] = SELECT_KERNELS(in_lookup),
+		[PRED_FORM_IN_LIST]   = SELECT_KERNELS(in_list),
+};
+
+static select_kernels_t *
+pred_kernels(const pred_args_t *args) {
+	return args->form == PRED_FORM_CMP ? &const_kernels[args->cmp] : &form_kernels[args->form];
+}
+
+// An empty selection result for t with its first chunk; the kernels append the others.
+// No result has more chunks than t.
+static col_table_t *
+new_selection_result(col_table_t *t) {
+	col_table_t *r = NEW(col_table_t);
+	MALLOC_CHECK(r, "result");
+	r->num_cols = t->num_cols;
+	r->num_rows = 0;
+	r->num_chunks = 0;
+	r->sorted_col = TABLE_UNSORTED;
+	r->chunks = NEWPA(table_chunk_t, t->num_chunks);
+	MALLOC_CHECK(r->chunks, "result chunks array");
+	MALLOC_CHECK(append_selection_chunk(r, get_chunk_size(t)), "result chunk");
+	return r;
+}
+
+// The colwise kernels add a chunk as soon as the previous one is full, even if no more rows match.
+static void
+trim_selection_result(col_table_t *r) {
+	size_t chunk_size = get_chunk_size(r);
+	if(r->num_chunks > 1 && (r->num_chunks - 1) * chunk_size == r->num_rows) {
+		free_table_chunk(r->chunks[--r->num_chunks], r->num_cols);
+	}
+}
+
+static col_table_t *
+rowise_selection(col_table_t *t, size_t col_a, size_t col_b, const pred_args_t *p, rowise_select_kernel_t kernel) {
+	col_table_t *r = new_selection_result(t);
+	MALLOC_CHECK(r, "result");
+	kernel(t, 0, t->num_chunks, col_a, col_b, p, r);
+	set_zone_maps(r);
+	r->sorted_col = t->sorted_col;
+	free_col_table(t);
+	return r;
+}
+
+static col_table_t *
+colwise_selection(col_table_t *t, size_t col_a, size_t col_b, const pred_args_t *p, colwise_select_kernel_t kernel) {
+	col_table_t *r = new_selection_result(t);
+	MALLOC_CHECK(r, "result");
+	kernel(t, 0, t->num_chunks, col_a, col_b, p, r);
+	trim_selection_result(r);
+	set_zone_maps(r);
+	r->sorted_col = t->sorted_col;
+	free_col_table(t);
+	return r;
+}
+
+static col_table_t *
+scatter_gather_selection(col_table_t *t, size_t col_a, size_t col_b, const pred_args_t *p, scatter_select_kernel_t kernel) {
+	// scatter the locations of matching rows, then gather one column at a time
+	row_loc_t *locs = NEWA(row_loc_t, t->num_rows + 1);
+	MALLOC_CHECK(locs, "row locations");
+	size_t num_locs = kernel(t, col_a, col_b, p, locs);
+
+	col_table_t *r = create_col_table_empty(num_locs, get_chunk_size(t), t->num_cols);
+	MALLOC_CHECK(r, "result");
+	gather_rows(t, locs, num_locs, r);
+	r->sorted_col = t->sorted_col;
+
+	my_free(locs);
+	free_col_table(t);
+	return r;
+}
+
+// the prepared arguments of col <cmp> val, which need no cleanup
+static pred_args_t
+cmp_args(cmp_op_t cmp, val_t val) {
+	predicate_t pred = { .kind = PRED_CMP, .cmp = cmp, .val = val };
+	pred_args_t args;
+	pred_prepare(&pred, &args);
+	return args;
+}
+
+// SELECTION_CONST is SELECTION_PRED with col = val
+#define EQ_PRED(v) { .kind = PRED_CMP, .cmp = CMP_EQ, .val = (v) }
+
 #define UNROLL_SIZE 1028
 
 col_table_t *
 selection_const (col_table_t *t, size_t col, val_t val) {
 	col_table_t *r = NEW(col_table_t);
-	column_chunk_t *c_chunk;
 	table_chunk_t *t_chunk;
 	size_t total_results = 0;
 	size_t chunk_size = t->chunks[0]->columns[0]->chunk_size;
@@ -141,11 +530,7 @@ selection_const (col_table_t *t, size_t col, val_t val) {
 	MALLOC_CHECK_NO_MES(t_chunk->columns);
 
 	for(size_t i = 0; i < t->num_cols; i++) {
-		t_chunk->columns[i] = NEW(column_chunk_t);
-		MALLOC_CHECK_NO_MES(t_chunk->columns[i]);
-		c_chunk = t_chunk->columns[i];
-		c_chunk->data = NEWA(val_t, t->chunks[0]->columns[0]->chunk_size);
-		MALLOC_CHECK_NO_MES(c_chunk->data);
+		t_chunk->columns[i] = create_col_chunk(chunk_size);
 	}
 	r->chunks[out_chunks - 1] = t_chunk;
 	size_t out_pos = 0;
@@ -153,30 +538,35 @@ selection_const (col_table_t *t, size_t col, val_t val) {
 	for(size_t i = 0; i < t->num_chunks; i++) {
 		table_chunk_t *tc = t->chunks[i];
 		column_chunk_t *c = tc->columns[col];
+		size_t rows = get_chunk_rows(t, i);
 		val_t *outdata = NULL, *outstart = NULL;
 		val_t *indata = c->data;
 		val_t *instart = indata;
+		size_t matches = 0;
 
 		for(size_t j = 0; j < t->num_cols; j++) {
+			val_t *coldata = tc->columns[j]->data;
+			indata = instart;
 			outdata = t_chunk->columns[j]->data + out_pos;
 			outstart = outdata;
-			size_t count_results = (j == 0);
 
-			while((indata + UNROLL_SIZE < instart + chunk_size) && (outdata + UNROLL_SIZE < outstart + - out_pos + chunk_size)) {
+			// every column stops after the same blocks, as they all match the same rows
+			while((indata + UNROLL_SIZE <= instart + rows) && (outdata + UNROLL_SIZE <= outstart - out_pos + chunk_size)) {
 				// tight loop with compile time constant of iterations
 				for(int k = 0; k < UNROLL_SIZE; k++) {
 					int match = (*indata == val);
-					*outdata = *indata;
+					*outdata = coldata[indata - instart];
 					indata++;
 					outdata += match;
-					total_results += match * count_results;
 				}
 			}
+			matches = outdata - outstart;
 		}
 
-		out_pos = outdata - outstart;
+		out_pos += matches;
+		total_results += matches;
 
-		while(indata < instart + chunk_size) {
+		while(indata < instart + rows) {
 			if (out_pos == chunk_size) {
 				t_chunk =  NEW(table_chunk_t);
 				MALLOC_CHECK_NO_MES(t_chunk);
@@ -185,12 +575,7 @@ selection_const (col_table_t *t, size_t col, val_t val) {
 				MALLOC_CHECK_NO_MES(t_chunk->columns);
 
 				for(size_t j = 0; j < t->num_cols; j++) {
-					t_chunk->columns[j] = NEW(column_chunk_t);
-					MALLOC_CHECK_NO_MES(t_chunk->columns[j]);
-
-					c_chunk = t_chunk->columns[j];
-					c_chunk->data = NEWA(val_t, chunk_size);
-					MALLOC_CHECK_NO_MES(c_chunk->data);
+					t_chunk->columns[j] = create_col_chunk(chunk_size);
 				}
 				r->chunks[r->num_chunks] = t_chunk;
 				r->num_chunks++;
@@ -198,14 +583,14 @@ selection_const (col_table_t *t, size_t col, val_t val) {
 			}
 
 			int match = (*indata == val);
+			size_t row = indata - instart;
 			indata++;
 
 			if (match) {
 				total_results++;
 				for(size_t j = 0; j < t->num_cols; j++) {
 					outdata = t_chunk->columns[j]->data + out_pos;
-					*outdata = *indata;
-					outdata += match;
+					*outdata = tc->columns[j]->data[row];
 				}
 				out_pos++;
 			}
@@ -216,6 +601,7 @@ selection_const (col_table_t *t, size_t col, val_t val) {
 
 	r->num_rows = total_results;
 
+	r->sorted_col = t->sorted_col;
 	free_col_table(t);
 
     return r;
@@ -224,7 +610,6 @@ selection_const (col_table_t *t, size_t col, val_t val) {
 col_table_t *
 basic_rowise_selection_const (col_table_t *t, size_t col, val_t val) {
 	col_table_t *r = NEW(col_table_t);
-	column_chunk_t *c_chunk;
 	table_chunk_t *t_chunk;
 	size_t total_results = 0;
 	size_t chunk_size = t->chunks[0]->columns[0]->chunk_size;
@@ -242,11 +627,7 @@ basic_rowise_selection_const (col_table_t *t, size_t col, val_t val) {
 	MALLOC_CHECK_NO_MES(t_chunk->columns);
 
 	for(size_t i = 0; i < t->num_cols; i++) {
-		t_chunk->columns[i] = NEW(column_chunk_t);
-		MALLOC_CHECK_NO_MES(t_chunk->columns[i]);
-		c_chunk = t_chunk->columns[i];
-		c_chunk->data = NEWA(val_t, t->chunks[0]->columns[0]->chunk_size);
-		MALLOC_CHECK_NO_MES(c_chunk->data);
+		t_chunk->columns[i] = create_col_chunk(chunk_size);
 	}
 	r->chunks[out_chunks - 1] = t_chunk;
 	size_t out_pos = 0;
@@ -258,7 +639,7 @@ basic_rowise_selection_const (col_table_t *t, size_t col, val_t val) {
 		val_t *indata = c->data;
 		val_t *instart = indata;
 
-		while(indata < instart + chunk_size) {
+		while(indata < instart + get_chunk_rows(t, i)) {
 			if (out_pos == chunk_size) {
 				t_chunk =  NEW(table_chunk_t);
 				MALLOC_CHECK_NO_MES(t_chunk);
@@ -267,12 +648,7 @@ basic_rowise_selection_const (col_table_t *t, size_t col, val_t val) {
 				MALLOC_CHECK_NO_MES(t_chunk->columns);
 
 				for(size_t j = 0; j < t->num_cols; j++) {
-					t_chunk->columns[j] = NEW(column_chunk_t);
-					MALLOC_CHECK_NO_MES(t_chunk->columns[j]);
-
-					c_chunk = t_chunk->columns[j];
-					c_chunk->data = NEWA(val_t, chunk_size);
-					MALLOC_CHECK_NO_MES(c_chunk->data);
+					t_chunk->columns[j] = create_col_chunk(chunk_size);
 				}
 				r->chunks[r->num_chunks] = t_chunk;
 				r->num_chunks++;
@@ -280,14 +656,14 @@ basic_rowise_selection_const (col_table_t *t, size_t col, val_t val) {
 			}
 
 			uint8_t match = (*indata == val);
+			size_t row = indata - instart;
 			indata++;
 
 			if(match) {
 				total_results++;
 				for(size_t j = 0; j < t->num_cols; j++) {
 					outdata = t_chunk->columns[j]->data + out_pos;
-					*outdata = *indata;
-					outdata += match;
+					*outdata = tc->columns[j]->data[row];
 				}
 				out_pos++;
 			}
@@ -298,6 +674,7 @@ basic_rowise_selection_const (col_table_t *t, size_t col, val_t val) {
 
 	r->num_rows = total_results;
 
+	r->sorted_col = t->sorted_col;
 	free_col_table(t);
 
     return r;
@@ -312,13 +689,13 @@ scatter_gather_selection_const (col_table_t *t, size_t col, val_t val) {
 	column_chunk_t **idx;
 	column_chunk_t **cidx;
 
-	// create index columns
+	// create index columns, with a spare chunk for the position after a full last one
 	//TODO introduce better data type to represent offsets (currently column chunk is one fixed large integer type)
-	idx = NEWPA(column_chunk_t, t->num_chunks);
+	idx = NEWPA(column_chunk_t, t->num_chunks + 1);
 	MALLOC_CHECK_NO_MES(idx);
-	cidx = NEWPA(column_chunk_t, t->num_chunks);
+	cidx = NEWPA(column_chunk_t, t->num_chunks + 1);
 	MALLOC_CHECK_NO_MES(cidx);
-	for(size_t i = 0; i < t->num_chunks; i++) {
+	for(size_t i = 0; i < t->num_chunks + 1; i++) {
 		idx[i] = create_col_chunk(chunk_size);
 		cidx[i] = create_col_chunk(chunk_size);
 	}
@@ -333,8 +710,9 @@ scatter_gather_selection_const (col_table_t *t, size_t col, val_t val) {
 		table_chunk_t *tc = t->chunks[i];
 		column_chunk_t *c = tc->columns[col];
 		val_t *indata = c->data;
+		size_t rows = get_chunk_rows(t, i);
 
-		for(size_t j = 0; j < chunk_size; j++) {
+		for(size_t j = 0; j < rows; j++) {
 			int match = (*indata++ == val);
 			idx_c[outpos] = j;
 			cidx_c[outpos] = i;
@@ -352,13 +730,14 @@ scatter_gather_selection_const (col_table_t *t, size_t col, val_t val) {
 	total_results += outpos;
 
 	// fill remainder with [0,0] to simplify processing
-	while(++outpos < chunk_size) {
+	for(; outpos < chunk_size; outpos++) {
 		idx_c[outpos] = 0;
 		cidx_c[outpos] = 0;
 	}
 
-	// create output table
+	// create output table, always with at least one chunk
 	out_chunks = total_results / chunk_size + (total_results % chunk_size == 0 ? 0 : 1);
+	out_chunks = MAX(out_chunks, 1);
 
 	col_table_t *r = NEW(col_table_t);
 	MALLOC_CHECK_NO_MES(r);
@@ -394,58 +773,444 @@ scatter_gather_selection_const (col_table_t *t, size_t col, val_t val) {
 		}
 	}
 
-	for(size_t i = 0; i < out_chunks; i++) {
+	for(size_t i = 0; i < t->num_chunks + 1; i++) {
 		free_col_chunk(idx[i]);
 		free_col_chunk(cidx[i]);
 	}
 	my_free(idx);
 	my_free(cidx);
 
+	r->sorted_col = t->sorted_col;
 	free_col_table(t);
 
     return r;
 }
 
-static inline __attribute__((always_inline)) void
-compute_offset(size_t chunk_size, size_t row,
-			   size_t *chunk_no, size_t *chunk_offset) {
-	*chunk_no     = row / chunk_size;
-	*chunk_offset = row % chunk_size;
+col_table_t *
+selection_att (col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b) {
+	pred_args_t args = cmp_args(cmp, 0);
+	return colwise_selection(t, col_a, col_b, &args, att_kernels[cmp].colwise);
 }
 
-static inline __attribute__((always_inline)) void
-load_row(col_table_t *table, size_t chunk_size, size_t row, size_t column,
-		 size_t *chunk_no, size_t *chunk_offset, table_chunk_t *chunk, val_t **chunk_col, val_t *val) {
+col_table_t *
+basic_rowise_selection_att (col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b) {
+	pred_args_t args = cmp_args(cmp, 0);
+	return rowise_selection(t, col_a, col_b, &args, att_kernels[cmp].rowise);
+}
 
-	// chunk_no and chunk_offset are always set such that they point to the row'th row.
-	// If chunk is provided, the chunk is set.
-	// If col is provided, col and val are set based on column.
+col_table_t *
+scatter_gather_selection_att (col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b) {
+	pred_args_t args = cmp_args(cmp, 0);
+	return scatter_gather_selection(t, col_a, col_b, &args, att_kernels[cmp].scatter);
+}
 
-	compute_offset(chunk_size, row, chunk_no, chunk_offset);
-	if (*chunk_no < table->num_chunks) {
-		*chunk = *table->chunks[*chunk_no];
-		*chunk_col = chunk->columns[column]->data;
-		*val = (*chunk_col)[*chunk_offset];
+col_table_t *
+selection_pred (col_table_t *t, size_t col, const predicate_t *pred) {
+	col_table_t *r = sorted_selection(t, col, pred);
+	if(r) {
+		return r;
+	}
+	pred_args_t args;
+	if(pred_prepare(pred, &args) != 0) {
+		free_col_table(t);
+		return NULL;
 	}
+	r = colwise_selection(t, col, col, &args, pred_kernels(&args)->colwise);
+	pred_release(&args);
+	return r;
 }
 
-static inline __attribute__((always_inline)) void
-load_next_row(col_table_t *table, size_t chunk_size, size_t column,
-			  size_t *chunk_no, size_t *chunk_offset, table_chunk_t *chunk, val_t **col, val_t *val) {
-	++*chunk_offset;
-	if (__builtin_expect(*chunk_offset < chunk_size, 1)) {
-		++*col;
-		*val = **col;
-	} else {
-		// reset chunk offset and move to next chunk
-		*chunk_offset = 0;
-		++*chunk_no;
-		if (__builtin_expect(*chunk_no < table->num_chunks, 1)) {
-			*chunk = *table->chunks[*chunk_no];
-			*col = chunk->columns[column]->data;
-			*val = **col;
+col_table_t *
+basic_rowise_selection_pred (col_table_t *t, size_t col, const predicate_t *pred) {
+	col_table_t *r = sorted_selection(t, col, pred);
+	if(r) {
+		return r;
+	}
+	pred_args_t args;
+	if(pred_prepare(pred, &args) != 0) {
+		free_col_table(t);
+		return NULL;
+	}
+	r = rowise_selection(t, col, col, &args, pred_kernels(&args)->rowise);
+	pred_release(&args);
+	return r;
+}
+
+col_table_t *
+scatter_gather_selection_pred (col_table_t *t, size_t col, const predicate_t *pred) {
+	col_table_t *r = sorted_selection(t, col, pred);
+	if(r) {
+		return r;
+	}
+	pred_args_t args;
+	if(pred_prepare(pred, &args) != 0) {
+		free_col_table(t);
+		return NULL;
+	}
+	r = scatter_gather_selection(t, col, col, &args, pred_kernels(&args)->scatter);
+	pred_release(&args);
+	return r;
+}
+
+// Adaptive selection.
+// Which strategy is fastest depends on the selectivity and the width of the table:
+// rowise branches on every row, so it wins when few rows match and loses to mispredictions in between,
+// colwise and bitmap cost about the same whatever matches, but colwise reads every column in full.
+// A cost model per strategy, calibrated once on a small synthetic table, picks one from the selectivity
+// of a few sampled chunks, and the scan goes on a batch of chunks at a time,
+// picking again whenever a batch's selectivity strays from the one the current strategy was picked for.
+// All three append to the same result, so switching costs nothing.
+typedef enum {
+	ADAPT_ROWISE = 0,
+	ADAPT_COLWISE,
+	ADAPT_BITMAP,
+	NUM_ADAPT_STRATEGIES
+} adapt_strategy_t;
+
+#define ADAPT_SEL_SCALE 1024  // selectivities are in units of 1 / ADAPT_SEL_SCALE
+#define ADAPT_COST_ROWS 1024  // costs are in cycles per this many input rows
+#define ADAPT_SAMPLE_CHUNKS 4
+#define ADAPT_BATCH_CHUNKS 4
+#define ADAPT_DRIFT (ADAPT_SEL_SCALE / 10)
+#define ADAPT_CAL_CHUNK_SIZE 1024
+#define ADAPT_CAL_CHUNKS 16
+#define ADAPT_CAL_WIDTH 8     // the model is fitted to tables of 1 and this many columns
+#define ADAPT_CAL_REPS 3
+#define ADAPT_CAL_POINTS 5
+
+// short of 0 and 1, where the zone maps would take over
+static const size_t adapt_cal_sels[ADAPT_CAL_POINTS] = { 64, 256, 512, 768, 960 };
+
+// at selectivity adapt_cal_sels[i], a strategy costs base[i] + per_col[i] * num_cols
+typedef struct {
+	int64_t base[ADAPT_CAL_POINTS];
+	int64_t per_col[ADAPT_CAL_POINTS];
+} adapt_cost_t;
+
+static adapt_cost_t adapt_costs[NUM_ADAPT_STRATEGIES];
+static bool adapt_calibrated = false;
+
+static void
+adapt_run(adapt_strategy_t strategy, col_table_t *t, size_t first_chunk, size_t stop_chunk, size_t col,
+		  const pred_args_t *p, select_kernels_t *kernels, bit_vec_t *bv, col_table_t *r) {
+	switch(strategy) {
+	case ADAPT_ROWISE:
+		kernels->rowise(t, first_chunk, stop_chunk, col, col, p, r);
+		break;
+	case ADAPT_COLWISE:
+		kernels->colwise(t, first_chunk, stop_chunk, col, col, p, r);
+		break;
+	default:
+		for(size_t chunk_no = first_chunk; chunk_no < stop_chunk; ++chunk_no) {
+			sel_append_chunk(t, chunk_no, col, p, bv, r);
+		}
+		break;
+	}
+}
+
+// cycles per ADAPT_COST_ROWS rows of t for each strategy, with p's value set so that about sel rows match
+static void
+adapt_measure(col_table_t *t, size_t sel, bit_vec_t *bv, int64_t *cost) {
+	pred_args_t args = cmp_args(CMP_LT, sel);
+	for(size_t strategy = 0; strategy < NUM_ADAPT_STRATEGIES; ++strategy) {
+		uint64_t best = UINT64_MAX;
+		for(size_t rep = 0; rep < ADAPT_CAL_REPS; ++rep) {
+			col_table_t *r = new_selection_result(t);
+			MALLOC_CHECK_VOID(r, "calibration result");
+			uint64_t start, end;
+			rdtscll(start);
+			adapt_run(strategy, t, 0, t->num_chunks, 0, &args, &const_kernels[CMP_LT], bv, r);
+			rdtscll(end);
+			free_col_table(r);
+			best = MIN(best, end - start);
+		}
+		cost[strategy] = best * ADAPT_COST_ROWS / t->num_rows;
+	}
+}
+
+// Fits adapt_costs on tables of uniform values in [0:ADAPT_SEL_SCALE], so col < sel matches about sel rows.
+// The values come from a generator of their own, so calibrating leaves rand_next alone.
+// They have no zone maps, so every chunk is scanned.
+static void
+adapt_calibrate(void) {
+	size_t widths[2] = { 1, ADAPT_CAL_WIDTH };
+	int64_t cost[2][ADAPT_CAL_POINTS][NUM_ADAPT_STRATEGIES];
+	bit_vec_t bv;
+	bv_init(&bv, ADAPT_CAL_CHUNK_SIZE);
+	MALLOC_CHECK_VOID(bv.data, "calibration bitmap");
+
+	for(size_t w = 0; w < 2; ++w) {
+		col_table_t *t = create_col_table_empty(ADAPT_CAL_CHUNKS * ADAPT_CAL_CHUNK_SIZE, ADAPT_CAL_CHUNK_SIZE, widths[w]);
+		MALLOC_CHECK_VOID(t, "calibration table");
+		uint32_t x = 2463534242u;
+		for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+			for(size_t col = 0; col < t->num_cols; ++col) {
+				for(size_t row = 0; row < ADAPT_CAL_CHUNK_SIZE; ++row) {
+					// xorshift32
+					x ^= x << 13;
+					x ^= x >> 17;
+					x ^= x << 5;
+					t->chunks[chunk_no]->columns[col]->data[row] = x % ADAPT_SEL_SCALE;
+				}
+			}
+		}
+		for(size_t point = 0; point < ADAPT_CAL_POINTS; ++point) {
+			adapt_measure(t, adapt_cal_sels[point], &bv, cost[w][point]);
+		}
+		free_col_table(t);
+	}
+	bv_free(&bv);
+
+	for(size_t strategy = 0; strategy < NUM_ADAPT_STRATEGIES; ++strategy) {
+		for(size_t point = 0; point < ADAPT_CAL_POINTS; ++point) {
+			int64_t per_col = (cost[1][point][strategy] - cost[0][point][strategy]) / (ADAPT_CAL_WIDTH - 1);
+			adapt_costs[strategy].per_col[point] = per_col;
+			adapt_costs[strategy].base[point] = cost[0][point][strategy] - per_col;
+		}
+	}
+	adapt_calibrated = true;
+}
+
+// the modelled cost of strategy at selectivity sel on num_cols columns, interpolated between calibration points
+static int64_t
+adapt_cost(adapt_strategy_t strategy, size_t sel, size_t num_cols) {
+	const adapt_cost_t *c = &adapt_costs[strategy];
+	size_t hi = 0;
+	while(hi < ADAPT_CAL_POINTS && adapt_cal_sels[hi] < sel) {
+		++hi;
+	}
+	if(hi == 0 || hi == ADAPT_CAL_POINTS) {
+		size_t point = hi == 0 ? 0 : ADAPT_CAL_POINTS - 1;
+		return c->base[point] + c->per_col[point] * (int64_t) num_cols;
+	}
+	size_t lo = hi - 1;
+	int64_t lo_cost = c->base[lo] + c->per_col[lo] * (int64_t) num_cols;
+	int64_t hi_cost = c->base[hi] + c->per_col[hi] * (int64_t) num_cols;
+	int64_t span = adapt_cal_sels[hi] - adapt_cal_sels[lo];
+	return lo_cost + (hi_cost - lo_cost) * (int64_t) (sel - adapt_cal_sels[lo]) / span;
+}
+
+static adapt_strategy_t
+adapt_pick(size_t sel, size_t num_cols) {
+	adapt_strategy_t best = ADAPT_ROWISE;
+	for(size_t strategy = 1; strategy < NUM_ADAPT_STRATEGIES; ++strategy) {
+		if(adapt_cost(strategy, sel, num_cols) < adapt_cost(best, sel, num_cols)) {
+			best = strategy;
+		}
+	}
+	return best;
+}
+
+void
+adaptive_selection_calibrate(void) {
+	if(!adapt_calibrated) {
+		adapt_calibrate();
+	}
+}
+
+static col_table_t *
+adaptive_selection(col_table_t *t, size_t col, const pred_args_t *p, select_kernels_t *kernels) {
+	adaptive_selection_calibrate();
+	size_t chunk_size = get_chunk_size(t);
+	col_table_t *r = new_selection_result(t);
+	MALLOC_CHECK(r, "result");
+	bit_vec_t bv;
+	bv_init(&bv, chunk_size);
+	MALLOC_CHECK(bv.data, "selection bitmap");
+
+	// chunks spread evenly over the table, in case its values drift along it
+	size_t num_samples = MIN(ADAPT_SAMPLE_CHUNKS, t->num_chunks);
+	size_t sampled = 0;
+	size_t matched = 0;
+	for(size_t sample = 0; sample < num_samples; ++sample) {
+		size_t chunk_no = sample * t->num_chunks / num_samples;
+		matched += sel_count_chunk(t, chunk_no, col, p, &bv);
+		sampled += get_chunk_rows(t, chunk_no);
+	}
+	size_t sel = sampled > 0 ? matched * ADAPT_SEL_SCALE / sampled : 0;
+	adapt_strategy_t strategy = adapt_pick(sel, t->num_cols);
+
+	for(size_t first_chunk = 0; first_chunk < t->num_chunks; ) {
+		size_t stop_chunk = MIN(first_chunk + ADAPT_BATCH_CHUNKS, t->num_chunks);
+		size_t batch_rows = MIN(stop_chunk * chunk_size, t->num_rows) - first_chunk * chunk_size;
+		size_t before = r->num_rows;
+		adapt_run(strategy, t, first_chunk, stop_chunk, col, p, kernels, &bv, r);
+		if(batch_rows > 0) {
+			size_t batch_sel = (r->num_rows - before) * ADAPT_SEL_SCALE / batch_rows;
+			if(batch_sel + ADAPT_DRIFT < sel || sel + ADAPT_DRIFT < batch_sel) {
+				sel = batch_sel;
+				strategy = adapt_pick(sel, t->num_cols);
+			}
+		}
+		first_chunk = stop_chunk;
+	}
+
+	bv_free(&bv);
+	trim_selection_result(r);
+	set_zone_maps(r);
+	r->sorted_col = t->sorted_col;
+	free_col_table(t);
+	return r;
+}
+
+col_table_t *
+adaptive_selection_const (col_table_t *t, size_t col, val_t val) {
+	predicate_t eq = EQ_PRED(val);
+	return adaptive_selection_pred(t, col, &eq);
+}
+
+col_table_t *
+adaptive_selection_pred (col_table_t *t, size_t col, const predicate_t *pred) {
+	col_table_t *r = sorted_selection(t, col, pred);
+	if(r) {
+		return r;
+	}
+	pred_args_t args;
+	if(pred_prepare(pred, &args) != 0) {
+		free_col_table(t);
+		return NULL;
+	}
+	r = adaptive_selection(t, col, &args, pred_kernels(&args));
+	pred_release(&args);
+	return r;
+}
+
+col_table_t *
+pipeline_select_project(col_table_t *t, size_t col, const predicate_t *pred, size_t *pos, size_t num_proj) {
+	t = default_impls[SELECTION_PRED](t, col, pred);
+	if(!t) {
+		return NULL;
+	}
+	return default_impls[PROJECTION](t, pos, num_proj);
+}
+
+pos_list_t *
+poslist_selection_pred(col_table_t *t, size_t col, const predicate_t *pred) {
+	pred_args_t args;
+	if(pred_prepare(pred, &args) != 0) {
+		return NULL;
+	}
+	pos_list_t *pl = NEW(pos_list_t);
+	MALLOC_CHECK(pl, "position list");
+	pl->table = t;
+	pl->locs = NEWA(row_loc_t, t->num_rows + 1);
+	MALLOC_CHECK(pl->locs, "row locations");
+	pl->num_rows = pred_kernels(&args)->scatter(t, col, col, &args, pl->locs);
+	pred_release(&args);
+	return pl;
+}
+
+void
+free_pos_list(pos_list_t *pl) {
+	my_free(pl->locs);
+	my_free(pl);
+}
+
+col_table_t *
+poslist_projection(pos_list_t *pl, size_t *pos, size_t num_proj) {
+	col_table_t *out = create_col_table_empty(pl->num_rows, get_chunk_size(pl->table), num_proj);
+	MALLOC_CHECK(out, "projection");
+	gather_cols(pl->table, pos, num_proj, pl->locs, pl->num_rows, out, 0);
+	// the list is in the order of the table
+	out->sorted_col = projected_sorted_col(pl->table->sorted_col, pos, num_proj);
+	return out;
+}
+
+col_table_t *
+poslist_sort(pos_list_t *pl, size_t col, size_t *pos, size_t num_proj) {
+	size_t num_rows = pl->num_rows;
+	size_t chunk_size = get_chunk_size(pl->table);
+	assert(num_rows <= ((size_t) 1 << 32)); // list indices must fit in a sort_pair_t
+
+	sort_pair_t *pairs = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(pairs, "sort pairs");
+	sort_pair_t *tmp = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(tmp, "sort pairs scratch");
+
+	// the key of each listed row, with its index in the list
+	for(size_t i = 0; i < num_rows; ++i) {
+		row_loc_t loc = pl->locs[i];
+		pairs[i] = SORT_PAIR(pl->table->chunks[ROW_LOC_CHUNK(loc)]->columns[col]->data[ROW_LOC_OFFSET(loc)], i);
+	}
+	sort_pair_t *sorted = radix_sort_pairs(pairs, tmp, num_rows, 32, 64);
+	// in place, as the location of each row
+	row_loc_t *locs = (row_loc_t *) sorted;
+	for(size_t i = 0; i < num_rows; ++i) {
+		locs[i] = pl->locs[SORT_PAIR_ROW(sorted[i])];
+	}
+
+	col_table_t *out = create_col_table_empty(num_rows, chunk_size, num_proj);
+	MALLOC_CHECK(out, "sorted projection");
+	gather_cols(pl->table, pos, num_proj, locs, num_rows, out, 0);
+	out->sorted_col = projected_sorted_col(col, pos, num_proj);
+
+	my_free(pairs);
+	my_free(tmp);
+	return out;
+}
+
+// agg over the listed rows, one AGG_OP(acc, val) per row
+#define POSLIST_AGGREGATE(pl, col, acc, AGG_OP) \
+	for(size_t i = 0; i < (pl)->num_rows; ++i) { \
+		row_loc_t loc = (pl)->locs[i]; \
+		val_t val = (pl)->table->chunks[ROW_LOC_CHUNK(loc)]->columns[col]->data[ROW_LOC_OFFSET(loc)]; \
+		AGG_OP(acc, val); \
+	}
+
+uint64_t
+poslist_aggregate(pos_list_t *pl, size_t col, agg_op_t agg) {
+	uint64_t acc = 0;
+	switch(agg) {
+	case AGG_COUNT:
+		acc = pl->num_rows;
+		break;
+	case AGG_SUM:
+		POSLIST_AGGREGATE(pl, col, acc, AGG_SUM_OP);
+		break;
+	case AGG_MIN:
+		acc = (val_t) -1;
+		POSLIST_AGGREGATE(pl, col, acc, AGG_MIN_OP);
+		break;
+	case AGG_MAX:
+		POSLIST_AGGREGATE(pl, col, acc, AGG_MAX_OP);
+		break;
+	case AGG_AVG:
+		POSLIST_AGGREGATE(pl, col, acc, AGG_SUM_OP);
+		acc = pl->num_rows ? acc / pl->num_rows : 0;
+		break;
+	default:
+		break;
+	}
+	return acc;
+}
+
+// End of the natural run of non-decreasing sort_col values starting at start_row,
+// that is the first row in [start_row:stop_row] which is smaller than the row before it, or stop_row.
+size_t
+sorted_run_end(col_table_t *table, size_t start_row, size_t stop_row, size_t sort_col) {
+	if(start_row >= stop_row) {
+		return stop_row;
+	}
+	size_t chunk_size = get_chunk_size(table);
+	size_t row = start_row;
+	val_t last = table->chunks[row / chunk_size]->columns[sort_col]->data[row % chunk_size];
+	for(++row; row < stop_row; ) {
+		size_t chunk_offset = row % chunk_size;
+		size_t chunk_stop = MIN(chunk_size, chunk_offset + (stop_row - row));
+		val_t *data = table->chunks[row / chunk_size]->columns[sort_col]->data;
+		for(; chunk_offset < chunk_stop; ++chunk_offset, ++row) {
+			if(data[chunk_offset] < last) {
+				return row;
+			}
+			last = data[chunk_offset];
 		}
 	}
+	return stop_row;
+}
+
+static inline __attribute__((always_inline)) val_t
+row_val(col_table_t *table, size_t chunk_size, size_t row, size_t column) {
+	return table->chunks[row / chunk_size]->columns[column]->data[row % chunk_size];
 }
 
 static inline __attribute__((always_inline)) void
@@ -467,6 +1232,19 @@ merge(col_table_t *in, size_t start, size_t mid, size_t stop, col_table_t *out,
 	size_t chunk_size = get_chunk_size(in);
 	size_t num_cols = in->num_cols;
 
+	// A sorted run's first and last values are its min and max, so when the runs' ranges don't overlap,
+	// the merge is both runs copied whole, in order; that is every merge of already-sorted input.
+	if(mid == start || mid == stop ||
+	   row_val(in, chunk_size, mid - 1, sort_col) <= row_val(in, chunk_size, mid, sort_col)) {
+		copy_rows(in, start, out, start, stop - start);
+		return;
+	}
+	if(row_val(in, chunk_size, start, sort_col) > row_val(in, chunk_size, stop - 1, sort_col)) {
+		copy_rows(in, mid, out, start, stop - mid);
+		copy_rows(in, start, out, start + (stop - mid), mid - start);
+		return;
+	}
+
 	size_t run_chunk_no[2];
 	size_t run_chunk_offset[2];
 	table_chunk_t run_chunk[2];
@@ -1050,6 +1828,157 @@ merge_intrachunk(table_chunk_t in_chunk, size_t start, size_t mid, size_t stop,
 }
 */
 
+typedef struct {
+	col_table_t *in;
+	col_table_t *out;
+	size_t col;
+	size_t domain_size;
+	// chunk_offsets[chunk_no * domain_size + key] is where that chunk's first row with key goes
+	size_t *chunk_offsets;
+	// out_cols[col * num_chunks + chunk_no] is the output column-chunk data
+	val_t **out_cols;
+	row_loc_t **dsts;
+	size_t **cursors;
+} global_counting_args_t;
+
+static void
+global_counting_histogram_worker(void *arg, size_t thread_no, size_t num_threads) {
+	global_counting_args_t *args = (global_counting_args_t *) arg;
+	size_t first_chunk_no, stop_chunk_no;
+	par_range(args->in->num_chunks, thread_no, num_threads, &first_chunk_no, &stop_chunk_no);
+
+	for(size_t chunk_no = first_chunk_no; chunk_no < stop_chunk_no; ++chunk_no) {
+		size_t *count = &args->chunk_offsets[chunk_no * args->domain_size];
+		memset(count, 0, args->domain_size * sizeof(size_t));
+		val_t *data = args->in->chunks[chunk_no]->columns[args->col]->data;
+		size_t chunk_rows = get_chunk_rows(args->in, chunk_no);
+		for(size_t chunk_offset = 0; chunk_offset < chunk_rows; ++chunk_offset) {
+			assert(data[chunk_offset] < args->domain_size);
+			++count[data[chunk_offset]];
+		}
+	}
+}
+
+static void
+global_counting_scatter_worker(void *arg, size_t thread_no, size_t num_threads) {
+	global_counting_args_t *args = (global_counting_args_t *) arg;
+	col_table_t *in = args->in;
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_chunks = in->num_chunks;
+	row_loc_t *dst = args->dsts[thread_no];
+	size_t *cursor = args->cursors[thread_no];
+	size_t first_chunk_no, stop_chunk_no;
+	par_range(num_chunks, thread_no, num_threads, &first_chunk_no, &stop_chunk_no);
+
+	for(size_t chunk_no = first_chunk_no; chunk_no < stop_chunk_no; ++chunk_no) {
+		// final location of every row in this chunk
+		memcpy(cursor, &args->chunk_offsets[chunk_no * args->domain_size], args->domain_size * sizeof(size_t));
+		val_t *key_data = in->chunks[chunk_no]->columns[args->col]->data;
+		size_t chunk_rows = get_chunk_rows(in, chunk_no);
+		for(size_t chunk_offset = 0; chunk_offset < chunk_rows; ++chunk_offset) {
+			size_t row = cursor[key_data[chunk_offset]]++;
+			dst[chunk_offset] = ROW_LOC(row / chunk_size, row % chunk_size);
+		}
+
+		// scatter every column there
+		for(size_t this_col = 0; this_col < in->num_cols; ++this_col) {
+			val_t *in_data = in->chunks[chunk_no]->columns[this_col]->data;
+			val_t **out_col = &args->out_cols[this_col * num_chunks];
+			for(size_t chunk_offset = 0; chunk_offset < chunk_rows; ++chunk_offset) {
+				out_col[ROW_LOC_CHUNK(dst[chunk_offset])][ROW_LOC_OFFSET(dst[chunk_offset])] = in_data[chunk_offset];
+			}
+		}
+	}
+}
+
+// Stable counting sort of the whole table with one global histogram:
+// a prefix sum per (chunk, key) sends every row straight to its final chunk and offset,
+// so each column is read once and written once instead of once per merge pass.
+// Uses par_threads threads.
+col_table_t *
+globalcountingsort(col_table_t *in, size_t col, size_t domain_size) {
+	col_table_t *out = create_col_table_like(in);
+	out->num_rows = in->num_rows;
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_chunks = in->num_chunks;
+	size_t num_cols = in->num_cols;
+	size_t num_threads = MIN(par_threads, num_chunks);
+
+	global_counting_args_t args;
+	args.in = in;
+	args.out = out;
+	args.col = col;
+	args.domain_size = domain_size;
+
+	args.chunk_offsets = NEWA(size_t, num_chunks * domain_size);
+	MALLOC_CHECK(args.chunk_offsets, "chunk offsets");
+	par_run(num_threads, global_counting_histogram_worker, &args);
+
+	// rows with a smaller key go first, then rows in an earlier chunk
+	size_t sum = 0;
+	for(size_t key = 0; key < domain_size; ++key) {
+		for(size_t chunk_no = 0; chunk_no < num_chunks; ++chunk_no) {
+			size_t count = args.chunk_offsets[chunk_no * domain_size + key];
+			args.chunk_offsets[chunk_no * domain_size + key] = sum;
+			sum += count;
+		}
+	}
+
+	args.out_cols = NEWA(val_t*, num_cols * num_chunks);
+	MALLOC_CHECK(args.out_cols, "output columns");
+	for(size_t this_col = 0; this_col < num_cols; ++this_col) {
+		for(size_t chunk_no = 0; chunk_no < num_chunks; ++chunk_no) {
+			args.out_cols[this_col * num_chunks + chunk_no] = out->chunks[chunk_no]->columns[this_col]->data;
+		}
+	}
+
+	row_loc_t *dsts[MAX_THREADS];
+	size_t *cursors[MAX_THREADS];
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		dsts[thread_no] = NEWA(row_loc_t, chunk_size);
+		MALLOC_CHECK(dsts[thread_no], "row destinations");
+		cursors[thread_no] = NEWA(size_t, domain_size);
+		MALLOC_CHECK(cursors[thread_no], "key cursors");
+	}
+	args.dsts = dsts;
+	args.cursors = cursors;
+	par_run(num_threads, global_counting_scatter_worker, &args);
+
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		my_free(dsts[thread_no]);
+		my_free(cursors[thread_no]);
+	}
+	my_free(args.out_cols);
+	my_free(args.chunk_offsets);
+	set_zone_maps(out);
+	free_col_table(in);
+	out->sorted_col = col;
+	return out;
+}
+
+// Above this many keys the scatter in globalcountingsort has too many output streams
+// to stay cache- and TLB-friendly.
+#define GLOBAL_COUNTING_MAX_DOMAIN 1024
+
+static inline bool
+use_globalcountingsort(col_table_t *in, size_t domain_size) {
+	// the (chunk, key) offsets should also be small next to the table itself
+	return domain_size <= GLOBAL_COUNTING_MAX_DOMAIN && domain_size * in->num_chunks <= in->num_rows;
+}
+
+// globalcountingsort has no merge passes at all, but needs the small domain;
+// countingmergesort needs full chunks, so a table with a partial last chunk is radix sorted instead
+col_table_t *
+autocountingsort(col_table_t *in, size_t col, size_t domain_size) {
+	if(use_globalcountingsort(in, domain_size)) {
+		return globalcountingsort(in, col, domain_size);
+	}
+	if(in->num_rows < in->num_chunks * get_chunk_size(in)) {
+		return radixsort(in, col, domain_size);
+	}
+	return countingmergesort(in, col, domain_size);
+}
+
 col_table_t *
 countingmergesort(col_table_t *in, size_t col, size_t domain_size)
 {
@@ -1141,6 +2070,8 @@ countingmergesort(col_table_t *in, size_t col, size_t domain_size)
 		SWAP(in, out, tmp);
 	}
 
+	set_zone_maps(out);
+
 	// there is no telling if this is the original 'in' because swapping happens
 	// just promise to use this like,
 	//
@@ -1159,6 +2090,7 @@ countingmergesort(col_table_t *in, size_t col, size_t domain_size)
 	printf("\nmerge calls: %lu\nchunk iter: %lu\nsetbit iter: %lu\ncreate read iter: %lu\nset col val: %lu:\n\n", C_MERGE, C_CHUNK, C_SETBIT, C_READITER, C_SETCOL);
 	#endif
 
+	out->sorted_col = col;
 	return out;
 }
 
@@ -1213,80 +2145,1264 @@ countingmergesort2(col_table_t *in, size_t col, size_t domain_size) {
 		col_table_t *tmp;
 		SWAP(in, out, tmp);
 	}
+	set_zone_maps(out);
 	free_col_table(in);
+	out->sorted_col = col;
 	return out;
 }
 
-size_t* domain_count(col_table_t *in, size_t col, size_t domain_size) {
-	size_t *domain_counts = NEWA(size_t, domain_size);
-	for(size_t domain_elem = 0; domain_elem < domain_size; ++domain_elem) {
-		domain_counts[domain_elem] = 0;
-	}
-
-	for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
-		val_t *data = in->chunks[chunk_no]->columns[col]->data;
-		for(size_t chunk_offset = 0; chunk_offset < get_chunk_size(in); ++chunk_offset) {
-			assert(data[chunk_offset] < domain_size);
-			domain_counts[data[chunk_offset]]++;
+// Merge-path co-ranking:
+// returns how many of the first k rows of merge(in[a:a+na], in[b:b+nb]) come from the a-run.
+// Ties are taken from the a-run first, just like merge().
+static size_t
+co_rank(col_table_t *in, size_t chunk_size, size_t sort_col, size_t a, size_t na, size_t b, size_t nb, size_t k) {
+	size_t lo = k > nb ? k - nb : 0;
+	size_t hi = MIN(k, na);
+	while(lo < hi) {
+		size_t i = (lo + hi) / 2;
+		if(row_val(in, chunk_size, b + k - i - 1, sort_col) < row_val(in, chunk_size, a + i, sort_col)) {
+			hi = i;
+		} else {
+			lo = i + 1;
 		}
 	}
-	return domain_counts;
+	return lo;
 }
 
-bool
-check_sorted_helper(col_table_t *result, size_t start_row, size_t stop_row, size_t sort_col) {
-	size_t chunk_size = get_chunk_size(result);
-	size_t start_chunk_no    , stop_chunk_no    ;
-	size_t start_chunk_offset, stop_chunk_offset;
-	table_chunk_t _chunk;
-	val_t *_col;
-	val_t _val;
-	load_row(result, chunk_size, start_row, sort_col,
-	         &start_chunk_no, &start_chunk_offset, &_chunk, &_col, &_val);
-	load_row(result, chunk_size,  stop_row, sort_col,
-	         & stop_chunk_no, & stop_chunk_offset, &_chunk, &_col, &_val);
-
-	size_t chunk_offset = start_chunk_offset;
-	val_t last = 0;
-	for(size_t chunk_no = start_chunk_no;
-	    chunk_no < stop_chunk_no || (chunk_no == stop_chunk_no && chunk_offset < stop_chunk_offset);
-	    ++chunk_no) {
-		val_t *data = result->chunks[chunk_no]->columns[sort_col]->data;
-		for(;
-		    (chunk_no < stop_chunk_no && chunk_offset < chunk_size) || (chunk_no == stop_chunk_no && chunk_offset < stop_chunk_offset);
-		    ++chunk_offset) {
-			if(data[chunk_offset] < last) {
-				#ifdef VERBOSE
-				{
-					printf("\n");
-					printf("%u = data.chunks[%lu].offset[%lu]\n", last, chunk_no, chunk_offset - 1);
-					printf("%u = data.chunks[%lu].offset[%lu]\n", data[chunk_offset], chunk_no, chunk_offset);
-					printf("Out of order\nNew:\n");
-					print_db(result);
-				}
-				#endif
+// Same bit-vector scheme as merge(),
+// but merges in[a:a_stop] with in[b:b_stop] into out[out_row:...],
+// where none of these have to be chunk-aligned or adjacent.
+// bit_chunk must have room for chunk_size bits.
+void
+merge_segment(col_table_t *in, size_t a, size_t a_stop, size_t b, size_t b_stop,
+              col_table_t *out, size_t out_row, size_t sort_col, bit_vec_t* bit_chunk) {
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_cols = in->num_cols;
+	size_t out_stop = out_row + (a_stop - a) + (b_stop - b);
+	size_t bit_capacity = bit_chunk->n_bits;
 
-				return false;
-			}
-			last = data[chunk_offset];
-		}
-		chunk_offset = 0;
-	}
+	size_t run_row[2] = {a, b};
+	size_t run_stop[2] = {a_stop, b_stop};
+	size_t run_chunk_no[2];
+	size_t run_chunk_offset[2];
+	table_chunk_t run_chunk[2];
+	val_t *run_col[2];
+	val_t run_val[2] = {0, 0};
 
-	return true;
-}
+	while(out_row < out_stop) {
+		size_t out_chunk_no;
+		size_t out_chunk_offset;
+		compute_offset(chunk_size, out_row, &out_chunk_no, &out_chunk_offset);
+		size_t len = MIN(chunk_size - out_chunk_offset, out_stop - out_row);
+		table_chunk_t out_chunk = *out->chunks[out_chunk_no];
 
-bool
-check_sorted(col_table_t *result, size_t sort_col, size_t domain_size, col_table_t *copy) {
-	size_t chunk_size = get_chunk_size(result);
-	size_t num_rows = chunk_size * result->num_chunks;
+		size_t first_run_row[2] = {run_row[0], run_row[1]};
+		for(uint8_t i = 0; i < 2; ++i) {
+			load_row(in, chunk_size, run_row[i], sort_col,
+			         &run_chunk_no[i], &run_chunk_offset[i], &run_chunk[i], &run_col[i], &run_val[i]);
+		}
+
+		// set bit-vector based on which is bigger
+		bit_chunk->n_bits = len;
+		bv_reset(bit_chunk);
+		bit_vec_iter_t bit_chunk_iter;
+		bv_iter_init(&bit_chunk_iter, bit_chunk);
+		for(; bv_iter_has_next(&bit_chunk_iter); bv_iter_next(&bit_chunk_iter)) {
+			if(__builtin_expect(run_row[0] == run_stop[0] || run_row[1] == run_stop[1], 0)) {
+				// one run is out; the rest comes from the other one
+				uint8_t which_not_empty = run_row[0] == run_stop[0];
+				run_row[which_not_empty] += bit_chunk_iter.n_bits_left;
+				bv_iter_set_rest(&bit_chunk_iter, which_not_empty);
+				break;
+			}
+			bit_t src_bit = run_val[0] > run_val[1];
+			bv_iter_set(&bit_chunk_iter, src_bit);
+			++run_row[src_bit];
+			load_next_row(in, chunk_size, sort_col,
+			              &run_chunk_no[src_bit], &run_chunk_offset[src_bit],
+			              &run_chunk[src_bit], &run_col[src_bit], &run_val[src_bit]);
+		}
+
+		// merge run[0] and run[1] into out based on bit-vector
+		for(size_t this_col = 0; this_col < num_cols; ++this_col) {
+			for(uint8_t i = 0; i < 2; ++i) {
+				load_row(in, chunk_size, first_run_row[i], this_col,
+				         &run_chunk_no[i], &run_chunk_offset[i], &run_chunk[i], &run_col[i], &run_val[i]);
+			}
+			bv_iter_init(&bit_chunk_iter, bit_chunk);
+			val_t* out_chunk_col = &out_chunk.columns[this_col]->data[out_chunk_offset];
+			for(    ;
+			        __builtin_expect(bv_iter_has_next(&bit_chunk_iter), 1);
+			        ++out_chunk_col, bv_iter_next(&bit_chunk_iter)) {
+				bit_t src_bit = bv_iter_get(&bit_chunk_iter);
+				*out_chunk_col = run_val[src_bit];
+				load_next_row(in, chunk_size, this_col,
+				              &run_chunk_no[src_bit], &run_chunk_offset[src_bit],
+				              &run_chunk[src_bit], &run_col[src_bit], &run_val[src_bit]);
+			}
+		}
+
+		out_row += len;
+	}
+
+	bit_chunk->n_bits = bit_capacity;
+}
+
+typedef struct {
+	col_table_t *in;
+	col_table_t *out;
+	size_t col;
+	size_t domain_size;
+	size_t width;
+	bit_vec_t *bit_chunks;
+	size_t **offset_arrays;
+	size_t ***array_starts;
+	size_t ***array_ends;
+} parallel_sort_args_t;
+
+static void
+parallel_countingsort_worker(void *arg, size_t thread_no, size_t num_threads) {
+	parallel_sort_args_t *args = (parallel_sort_args_t *) arg;
+	size_t first_chunk_no, stop_chunk_no;
+	par_range(args->in->num_chunks, thread_no, num_threads, &first_chunk_no, &stop_chunk_no);
+
+	for(size_t chunk_no = first_chunk_no; chunk_no < stop_chunk_no; ++chunk_no) {
+		countingsort_intrachunk(*args->in->chunks[chunk_no], 0, get_chunk_rows(args->in, chunk_no), *args->out->chunks[chunk_no],
+		                        args->in->num_cols, args->col, args->domain_size,
+		                        args->offset_arrays[thread_no], args->array_starts[thread_no], args->array_ends[thread_no]);
+	}
+}
+
+static void
+parallel_merge_worker(void *arg, size_t thread_no, size_t num_threads) {
+	parallel_sort_args_t *args = (parallel_sort_args_t *) arg;
+	col_table_t *in = args->in;
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_rows = in->num_rows;
+	size_t width = args->width;
+
+	// Every thread gets an equal, chunk-aligned slice of the *output*,
+	// no matter how many runs there are in this pass.
+	size_t first_chunk_no, stop_chunk_no;
+	par_range(in->num_chunks, thread_no, num_threads, &first_chunk_no, &stop_chunk_no);
+	size_t lo = first_chunk_no * chunk_size;
+	size_t hi = stop_chunk_no * chunk_size;
+
+	for(size_t start = lo / (2 * width) * (2 * width); start < hi; start += 2 * width) {
+		size_t mid = MIN(start + width, num_rows);
+		size_t stop = MIN(start + 2 * width, num_rows);
+		size_t seg_lo = MAX(lo, start) - start;
+		size_t seg_hi = MIN(hi, stop) - start;
+
+		size_t a_lo = co_rank(in, chunk_size, args->col, start, mid - start, mid, stop - mid, seg_lo);
+		size_t a_hi = co_rank(in, chunk_size, args->col, start, mid - start, mid, stop - mid, seg_hi);
+		size_t b_lo = seg_lo - a_lo;
+		size_t b_hi = seg_hi - a_hi;
+
+		merge_segment(in, start + a_lo, start + a_hi, mid + b_lo, mid + b_hi,
+		              args->out, start + seg_lo, args->col, &args->bit_chunks[thread_no]);
+	}
+}
+
+// same countingmergesort
+// but every phase is split across par_threads threads.
+// Merge passes are split by merge-path, so the last passes (with one or two runs) still scale.
+col_table_t *
+parallelcountingmergesort(col_table_t *in, size_t col, size_t domain_size) {
+	col_table_t *out = create_col_table_like(in);
+	out->num_rows = in->num_rows;
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_rows = in->num_rows;
+	size_t num_threads = MIN(par_threads, in->num_chunks);
+
+	parallel_sort_args_t args;
+	args.col = col;
+	args.domain_size = domain_size;
+
+	// scratch space is allocated up front, one set per thread
+	bit_vec_t bit_chunks[MAX_THREADS];
+	size_t *offset_arrays[MAX_THREADS];
+	size_t **array_starts[MAX_THREADS];
+	size_t **array_ends[MAX_THREADS];
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		bv_init(&bit_chunks[thread_no], chunk_size);
+		offset_arrays[thread_no] = NEWA(size_t, chunk_size * domain_size);
+		MALLOC_CHECK(offset_arrays[thread_no], "offset_array");
+		array_starts[thread_no] = NEWA(size_t*, domain_size);
+		MALLOC_CHECK(array_starts[thread_no], "array_starts");
+		array_ends[thread_no] = NEWA(size_t*, domain_size);
+		MALLOC_CHECK(array_ends[thread_no], "array_ends");
+	}
+	args.bit_chunks = bit_chunks;
+	args.offset_arrays = offset_arrays;
+	args.array_starts = array_starts;
+	args.array_ends = array_ends;
+
+	args.in = in;
+	args.out = out;
+	par_run(num_threads, parallel_countingsort_worker, &args);
+
+	// make the output of counting-sort the input for merging
+	{
+		col_table_t *tmp;
+		SWAP(in, out, tmp);
+	}
+
+	for(size_t width = chunk_size; width < num_rows; width *= 2) {
+		// in is sorted into runs of size width
+		args.in = in;
+		args.out = out;
+		args.width = width;
+		par_run(num_threads, parallel_merge_worker, &args);
+		// out is sorted into runs of size 2 * width
+		col_table_t *tmp;
+		SWAP(in, out, tmp);
+	}
+
+	//in is sorted
+	{
+		col_table_t *tmp;
+		SWAP(in, out, tmp);
+	}
+
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		bv_free(&bit_chunks[thread_no]);
+		my_free(offset_arrays[thread_no]);
+		my_free(array_starts[thread_no]);
+		my_free(array_ends[thread_no]);
+	}
+
+	set_zone_maps(out);
+	free_col_table(in);
+	out->sorted_col = col;
+	return out;
+}
+
+// 11-bit digits: three passes cover a val_t,
+// and one digit's histogram (16KiB) fits in L1.
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MAX_DIGITS ((64 + RADIX_BITS - 1) / RADIX_BITS)
+
+// LSD radix sort of pairs on bits [lo_bit:hi_bit] of each pair.
+// Stable, so the bits below lo_bit keep their relative order.
+// Returns whichever of pairs or tmp holds the result.
+sort_pair_t *
+radix_sort_pairs(sort_pair_t *pairs, sort_pair_t *tmp, size_t n, unsigned lo_bit, unsigned hi_bit) {
+	unsigned num_digits = (hi_bit - lo_bit + RADIX_BITS - 1) / RADIX_BITS;
+
+	size_t (*counts)[RADIX_BUCKETS] = (size_t (*)[RADIX_BUCKETS]) NEWA(size_t, num_digits * RADIX_BUCKETS);
+	MALLOC_CHECK(counts, "radix histograms");
+	memset(counts, 0, num_digits * RADIX_BUCKETS * sizeof(size_t));
+
+	// one read of the input makes every digit's histogram
+	for(size_t i = 0; i < n; ++i) {
+		sort_pair_t pair = pairs[i];
+		for(unsigned digit = 0; digit < num_digits; ++digit) {
+			++counts[digit][(pair >> (lo_bit + digit * RADIX_BITS)) & (RADIX_BUCKETS - 1)];
+		}
+	}
+
+	for(unsigned digit = 0; digit < num_digits; ++digit) {
+		unsigned shift = lo_bit + digit * RADIX_BITS;
+		size_t *count = counts[digit];
+
+		// if every pair has the same digit, this pass would be a copy
+		if(n == 0 || count[(pairs[0] >> shift) & (RADIX_BUCKETS - 1)] == n) {
+			continue;
+		}
+
+		// counts become the first output position of each bucket
+		size_t sum = 0;
+		for(size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+			size_t this_count = count[bucket];
+			count[bucket] = sum;
+			sum += this_count;
+		}
+
+		for(size_t i = 0; i < n; ++i) {
+			sort_pair_t pair = pairs[i];
+			tmp[count[(pair >> shift) & (RADIX_BUCKETS - 1)]++] = pair;
+		}
+
+		sort_pair_t *swap_tmp;
+		SWAP(pairs, tmp, swap_tmp);
+	}
+
+	my_free(counts);
+	return pairs;
+}
+
+// the key column of in, as (key, row) pairs
+static void
+make_sort_pairs(col_table_t *in, size_t col, sort_pair_t *pairs) {
+	size_t row = 0;
+	for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
+		val_t *data = in->chunks[chunk_no]->columns[col]->data;
+		size_t chunk_rows = get_chunk_rows(in, chunk_no);
+		for(size_t chunk_offset = 0; chunk_offset < chunk_rows; ++chunk_offset, ++row) {
+			pairs[row] = SORT_PAIR(data[chunk_offset], row);
+		}
+	}
+}
+
+// Rewrites sorted pairs in place as the location of their row,
+// which is all that gather_rows needs.
+static void
+sort_pairs_to_locs(sort_pair_t *pairs, size_t n, size_t chunk_size) {
+	row_loc_t *locs = (row_loc_t *) pairs;
+	for(size_t i = 0; i < n; ++i) {
+		size_t row = SORT_PAIR_ROW(pairs[i]);
+		locs[i] = ROW_LOC(row / chunk_size, row % chunk_size);
+	}
+}
+
+// LSD radix sort on the key column only,
+// then every column is moved exactly once by gather_rows.
+// Needs O(num_rows) scratch space, independent of the key domain.
+col_table_t *
+radixsort(col_table_t *in, size_t col, __attribute__((unused)) size_t domain_size) {
+	size_t num_rows = in->num_rows;
+	assert(num_rows <= ((size_t) 1 << 32)); // row ids must fit in a sort_pair_t
+
+	sort_pair_t *pairs = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(pairs, "sort pairs");
+	sort_pair_t *tmp = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(tmp, "sort pairs scratch");
+
+	make_sort_pairs(in, col, pairs);
+	sort_pair_t *sorted = radix_sort_pairs(pairs, tmp, num_rows, 32, 64);
+	sort_pairs_to_locs(sorted, num_rows, get_chunk_size(in));
+
+	col_table_t *out = create_col_table_empty(num_rows, get_chunk_size(in), in->num_cols);
+	gather_rows(in, (row_loc_t *) sorted, num_rows, out);
+
+	my_free(pairs);
+	my_free(tmp);
+	free_col_table(in);
+	out->sorted_col = col;
+	return out;
+}
+
+// counting-sorts every chunk of in into the same chunk of out
+static void
+countingsort_chunks(col_table_t *in, col_table_t *out, size_t col, size_t domain_size) {
+	size_t chunk_size = get_chunk_size(in);
+
+	size_t*  offset_array = NEWA(size_t, chunk_size * domain_size);
+	MALLOC_CHECK_VOID(offset_array, "offset_array");
+	size_t** array_starts = NEWA(size_t*, domain_size);
+	MALLOC_CHECK_VOID(array_starts, "array_starts");
+	size_t** array_ends   = NEWA(size_t*, domain_size);
+	MALLOC_CHECK_VOID(array_ends, "array_ends");
+
+	for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
+		countingsort_intrachunk(*in->chunks[chunk_no], 0, get_chunk_rows(in, chunk_no), *out->chunks[chunk_no], in->num_cols,
+		                        col, domain_size, offset_array, array_starts, array_ends);
+	}
+
+	my_free(offset_array);
+	my_free(array_starts);
+	my_free(array_ends);
+}
+
+// Fan-in of one k-way merge pass.
+// With 256, the source run of every output row fits in a byte.
+#define KWAY_MAX_FAN_IN 256
+typedef uint8_t run_idx_t;
+
+// loser tree key of a run's head; ties go to the earlier run, which keeps the merge stable
+#define KWAY_KEY(val, run) ((((lt_key_t) (val)) << 32) | (lt_key_t) (run))
+
+// Merges the sorted runs in[start + r * width : start + (r + 1) * width] (the last one ends at stop)
+// into out[start:stop].
+// Like merge(), the merge is decided once on sort_col and recorded per output chunk,
+// except that src records which of up to KWAY_MAX_FAN_IN runs each row comes from instead of one bit.
+// Then every column is copied by replaying src.
+void
+kway_merge(col_table_t *in, size_t start, size_t width, size_t stop, col_table_t *out, size_t sort_col, run_idx_t *src) {
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_cols = in->num_cols;
+	size_t num_runs = (stop - start + width - 1) / width;
+	assert(num_runs <= KWAY_MAX_FAN_IN);
+	assert(start % chunk_size == 0);
+
+	size_t run_row[KWAY_MAX_FAN_IN];
+	size_t run_stop[KWAY_MAX_FAN_IN];
+	size_t first_run_row[KWAY_MAX_FAN_IN];
+	size_t run_chunk_no[KWAY_MAX_FAN_IN];
+	val_t *run_col[KWAY_MAX_FAN_IN];
+	val_t *run_chunk_end[KWAY_MAX_FAN_IN];
+
+	loser_tree_t lt;
+	lt_init(&lt, num_runs);
+	for(size_t run = 0; run < num_runs; ++run) {
+		run_row[run] = start + run * width;
+		run_stop[run] = MIN(run_row[run] + width, stop);
+		run_chunk_no[run] = run_row[run] / chunk_size;
+		run_col[run] = in->chunks[run_chunk_no[run]]->columns[sort_col]->data + run_row[run] % chunk_size;
+		run_chunk_end[run] = in->chunks[run_chunk_no[run]]->columns[sort_col]->data + chunk_size;
+		lt.keys[run] = KWAY_KEY(*run_col[run], run);
+	}
+	lt_build(&lt);
+
+	for(size_t out_row = start; out_row < stop; out_row += chunk_size) {
+		table_chunk_t out_chunk = *out->chunks[out_row / chunk_size];
+		size_t len = MIN(chunk_size, stop - out_row);
+
+		for(size_t run = 0; run < num_runs; ++run) {
+			first_run_row[run] = run_row[run];
+		}
+
+		// pick the source run of every output row using only sort_col
+		for(size_t i = 0; i < len; ++i) {
+			size_t winner = lt_winner(&lt);
+			src[i] = (run_idx_t) winner;
+			lt_key_t key = LT_KEY_DONE;
+			if(__builtin_expect(++run_row[winner] < run_stop[winner], 1)) {
+				if(__builtin_expect(++run_col[winner] == run_chunk_end[winner], 0)) {
+					++run_chunk_no[winner];
+					run_col[winner] = in->chunks[run_chunk_no[winner]]->columns[sort_col]->data;
+					run_chunk_end[winner] = run_col[winner] + chunk_size;
+				}
+				key = KWAY_KEY(*run_col[winner], winner);
+			}
+			lt_replay(&lt, key);
+		}
+
+		// copy every column from the recorded runs
+		for(size_t this_col = 0; this_col < num_cols; ++this_col) {
+			val_t *col_ptr[KWAY_MAX_FAN_IN];
+			val_t *col_end[KWAY_MAX_FAN_IN];
+			size_t col_chunk_no[KWAY_MAX_FAN_IN];
+			for(size_t run = 0; run < num_runs; ++run) {
+				col_chunk_no[run] = first_run_row[run] / chunk_size;
+				if(col_chunk_no[run] < in->num_chunks) {
+					val_t *data = in->chunks[col_chunk_no[run]]->columns[this_col]->data;
+					col_ptr[run] = data + first_run_row[run] % chunk_size;
+					col_end[run] = data + chunk_size;
+				}
+			}
+
+			val_t *out_data = out_chunk.columns[this_col]->data;
+			for(size_t i = 0; i < len; ++i) {
+				run_idx_t run = src[i];
+				out_data[i] = *col_ptr[run]++;
+				if(__builtin_expect(col_ptr[run] == col_end[run], 0) && ++col_chunk_no[run] < in->num_chunks) {
+					col_ptr[run] = in->chunks[col_chunk_no[run]]->columns[this_col]->data;
+					col_end[run] = col_ptr[run] + chunk_size;
+				}
+			}
+		}
+	}
+
+	lt_free(&lt);
+	assert(check_sorted_helper(out, start, stop, sort_col));
+}
+
+// countingsort_intrachunk, then k-way merges of up to KWAY_MAX_FAN_IN runs at a time.
+// Every row and column is moved ceil(log_{KWAY_MAX_FAN_IN}(num_chunks)) times
+// instead of log2(num_chunks) times; a single pass up to 256 chunks.
+col_table_t *
+countingkwaymergesort(col_table_t *in, size_t col, size_t domain_size) {
+	col_table_t *out = create_col_table_like(in);
+	out->num_rows = in->num_rows;
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_rows = in->num_rows;
+
+	countingsort_chunks(in, out, col, domain_size);
+
+	// make the output of counting-sort the input for merging
+	{
+		col_table_t *tmp;
+		SWAP(in, out, tmp);
+	}
+
+	run_idx_t *src = NEWA(run_idx_t, chunk_size);
+	MALLOC_CHECK(src, "source runs");
+
+	for(size_t width = chunk_size; width < num_rows; width *= KWAY_MAX_FAN_IN) {
+		// in is sorted into runs of size width
+		for(size_t start = 0; start < num_rows; start += width * KWAY_MAX_FAN_IN) {
+			size_t stop = MIN(start + width * KWAY_MAX_FAN_IN, num_rows);
+			kway_merge(in, start, width, stop, out, col, src);
+		}
+		// out is sorted into runs of size width * KWAY_MAX_FAN_IN
+		col_table_t *tmp;
+		SWAP(in, out, tmp);
+	}
+
+	my_free(src);
+
+	//in is sorted
+	{
+		col_table_t *tmp;
+		SWAP(in, out, tmp);
+	}
+	set_zone_maps(out);
+	free_col_table(in);
+	out->sorted_col = col;
+	return out;
+}
+
+// stable counting sort of n pairs by key; count needs domain_size entries
+static void
+countingsort_pairs(sort_pair_t *in, sort_pair_t *out, size_t n, size_t domain_size, size_t *count) {
+	memset(count, 0, domain_size * sizeof(size_t));
+	for(size_t i = 0; i < n; ++i) {
+		assert(SORT_PAIR_KEY(in[i]) < domain_size);
+		++count[SORT_PAIR_KEY(in[i])];
+	}
+	size_t sum = 0;
+	for(size_t key = 0; key < domain_size; ++key) {
+		size_t this_count = count[key];
+		count[key] = sum;
+		sum += this_count;
+	}
+	for(size_t i = 0; i < n; ++i) {
+		out[count[SORT_PAIR_KEY(in[i])]++] = in[i];
+	}
+}
+
+// Same phases as countingmergesort, but on (key, row) pairs only:
+// the merge passes move 8 bytes per row instead of num_cols values,
+// and the final permutation is applied to every column once, by a cache-blocked gather_rows.
+col_table_t *
+latecountingmergesort(col_table_t *in, size_t col, size_t domain_size) {
+	size_t chunk_size = get_chunk_size(in);
+	size_t num_rows = in->num_rows;
+	assert(num_rows <= ((size_t) 1 << 32)); // row ids must fit in a sort_pair_t
+
+	sort_pair_t *pairs = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(pairs, "sort pairs");
+	sort_pair_t *tmp = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(tmp, "sort pairs scratch");
+	size_t *count = NEWA(size_t, domain_size);
+	MALLOC_CHECK(count, "key counts");
+
+	make_sort_pairs(in, col, tmp);
+	for(size_t start = 0; start < num_rows; start += chunk_size) {
+		countingsort_pairs(tmp + start, pairs + start, MIN(chunk_size, num_rows - start), domain_size, count);
+	}
+	my_free(count);
+
+	for(size_t width = chunk_size; width < num_rows; width *= 2) {
+		// pairs is sorted into runs of size width
+		for(size_t start = 0; start < num_rows; start += 2 * width) {
+			size_t mid = MIN(start + width, num_rows);
+			size_t stop = MIN(start + 2 * width, num_rows);
+			merge_pairs(pairs + start, mid - start, pairs + mid, stop - mid, tmp + start);
+		}
+		// tmp is sorted into runs of size 2 * width
+		sort_pair_t *swap_tmp;
+		SWAP(pairs, tmp, swap_tmp);
+	}
+
+	sort_pairs_to_locs(pairs, num_rows, chunk_size);
+	col_table_t *out = create_col_table_empty(num_rows, chunk_size, in->num_cols);
+	gather_rows(in, (row_loc_t *) pairs, num_rows, out);
+
+	my_free(pairs);
+	my_free(tmp);
+	free_col_table(in);
+	out->sorted_col = col;
+	return out;
+}
+
+// bits needed to represent every value up to max
+static inline __attribute__((always_inline)) unsigned
+bit_width(uint64_t max) {
+	return max ? 64 - __builtin_clzll(max) : 0;
+}
+
+// one stable sorting pass of multikeysort, on the composite of keys [first:stop]
+typedef struct {
+	size_t first;
+	size_t stop;
+	unsigned bits;
+} multikey_group_t;
+
+// Sorts on keys[0], then keys[1], ... each ascending or descending.
+//
+// Every key column is first normalized so that ascending order is the order wanted:
+// DESC keys become max - val. Keys are then packed (most significant first) into groups of
+// composite u64 keys with the position in the current order in the low bits,
+// so each comparison is a single integer compare and equal composites keep their order.
+// Usually everything fits in one group and this is one radix sort.
+// Groups are sorted least significant first, like the digits of an LSD radix sort.
+// If the leading key has a small domain it gets a group of its own,
+// sorted by a single counting pass instead.
+col_table_t *
+multikeysort(col_table_t *in, const sort_key_t *keys, size_t num_keys) {
+	size_t num_rows = in->num_rows;
+	size_t chunk_size = get_chunk_size(in);
+	assert(num_rows <= ((size_t) 1 << 32)); // row ids must fit in a sort_pair_t
+	if(num_keys == 0 || num_rows <= 1) {
+		return in;
+	}
+
+	// normalized keys, flattened so that a row's key is one load
+	val_t *norm = NEWA(val_t, num_keys * num_rows);
+	MALLOC_CHECK(norm, "normalized keys");
+	val_t *key_max = NEWA(val_t, num_keys);
+	MALLOC_CHECK(key_max, "key maxima");
+	for(size_t key = 0; key < num_keys; ++key) {
+		assert(keys[key].col < in->num_cols);
+		val_t *norm_key = norm + key * num_rows;
+		val_t max = 0;
+		size_t row = 0;
+		for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
+			val_t *data = in->chunks[chunk_no]->columns[keys[key].col]->data;
+			size_t n = get_chunk_rows(in, chunk_no);
+			for(size_t chunk_offset = 0; chunk_offset < n; ++chunk_offset, ++row) {
+				norm_key[row] = data[chunk_offset];
+				max = MAX(max, data[chunk_offset]);
+			}
+		}
+		if(keys[key].dir == SORT_DESC) {
+			for(row = 0; row < num_rows; ++row) {
+				norm_key[row] = max - norm_key[row];
+			}
+		}
+		key_max[key] = max;
+	}
+
+	unsigned pos_bits = bit_width(num_rows - 1);
+	unsigned group_max_bits = 64 - pos_bits;
+	bool count_lead = (size_t) key_max[0] + 1 <= GLOBAL_COUNTING_MAX_DOMAIN && (size_t) key_max[0] + 1 <= num_rows;
+
+	multikey_group_t *groups = NEWA(multikey_group_t, num_keys);
+	MALLOC_CHECK(groups, "key groups");
+	size_t num_groups = 0;
+	for(size_t key = 0; key < num_keys; ++key) {
+		unsigned bits = bit_width(key_max[key]);
+		bool new_group = num_groups == 0
+			|| groups[num_groups - 1].bits + bits > group_max_bits
+			|| (count_lead && key == 1);
+		if(new_group) {
+			groups[num_groups].first = key;
+			groups[num_groups].bits = 0;
+			++num_groups;
+		}
+		groups[num_groups - 1].stop = key + 1;
+		groups[num_groups - 1].bits += bits;
+	}
+
+	// order[i] is the row at position i; composites sort positions within it
+	sort_pair_t *order = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(order, "sort order");
+	sort_pair_t *composite = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(composite, "composite keys");
+	sort_pair_t *tmp = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(tmp, "composite scratch");
+	for(size_t row = 0; row < num_rows; ++row) {
+		order[row] = row;
+	}
+
+	for(size_t group_no = num_groups; group_no-- > 0; ) {
+		multikey_group_t *group = &groups[group_no];
+		if(group->bits == 0) {
+			// every row has the same keys here
+			continue;
+		}
+
+		if(count_lead && group_no == 0) {
+			val_t *norm_key = norm;
+			size_t domain = (size_t) key_max[0] + 1;
+			size_t *count = NEWA(size_t, domain);
+			MALLOC_CHECK(count, "key counts");
+			memset(count, 0, domain * sizeof(size_t));
+			for(size_t i = 0; i < num_rows; ++i) {
+				++count[norm_key[order[i]]];
+			}
+			size_t sum = 0;
+			for(size_t key_val = 0; key_val < domain; ++key_val) {
+				size_t this_count = count[key_val];
+				count[key_val] = sum;
+				sum += this_count;
+			}
+			for(size_t i = 0; i < num_rows; ++i) {
+				tmp[count[norm_key[order[i]]]++] = order[i];
+			}
+			my_free(count);
+
+			sort_pair_t *swap_tmp;
+			SWAP(order, tmp, swap_tmp);
+			continue;
+		}
+
+		for(size_t i = 0; i < num_rows; ++i) {
+			size_t row = order[i];
+			sort_pair_t packed = 0;
+			for(size_t key = group->first; key < group->stop; ++key) {
+				packed = (packed << bit_width(key_max[key])) | norm[key * num_rows + row];
+			}
+			composite[i] = (packed << pos_bits) | i;
+		}
+		sort_pair_t *sorted = radix_sort_pairs(composite, tmp, num_rows, pos_bits, pos_bits + group->bits);
+		sort_pair_t *spare = sorted == composite ? tmp : composite;
+
+		sort_pair_t pos_mask = (((sort_pair_t) 1) << pos_bits) - 1;
+		for(size_t i = 0; i < num_rows; ++i) {
+			spare[i] = order[sorted[i] & pos_mask];
+		}
+
+		// spare is the new order; the old one becomes scratch
+		composite = order;
+		tmp = sorted;
+		order = spare;
+	}
+
+	// rows are below 2^32, so order is already in sort_pair_t layout
+	sort_pairs_to_locs(order, num_rows, chunk_size);
+	col_table_t *out = create_col_table_like(in);
+	out->num_rows = num_rows;
+	gather_rows(in, (row_loc_t *) order, num_rows, out);
+
+	my_free(order);
+	my_free(composite);
+	my_free(tmp);
+	my_free(groups);
+	my_free(key_max);
+	my_free(norm);
+	free_col_table(in);
+	out->sorted_col = keys[0].dir == SORT_ASC ? keys[0].col : TABLE_UNSORTED;
+	return out;
+}
+
+// Locations of the k smallest (key, row) pairs, in order, by one histogram pass and one selecting pass.
+// Only rows below the cutoff key (and the first few equal to it) are written.
+static void
+topk_histogram(col_table_t *in, size_t col, size_t domain_size, size_t k, row_loc_t *locs) {
+	size_t *count = NEWA(size_t, domain_size);
+	MALLOC_CHECK_VOID(count, "key counts");
+	memset(count, 0, domain_size * sizeof(size_t));
+
+	for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
+		val_t *data = in->chunks[chunk_no]->columns[col]->data;
+		size_t chunk_rows = get_chunk_rows(in, chunk_no);
+		for(size_t chunk_offset = 0; chunk_offset < chunk_rows; ++chunk_offset) {
+			assert(data[chunk_offset] < domain_size);
+			++count[data[chunk_offset]];
+		}
+	}
+
+	// counts become output positions, up to the cutoff: the key holding the k-th row
+	size_t cutoff = 0;
+	size_t sum = 0;
+	for(; cutoff < domain_size; ++cutoff) {
+		size_t this_count = count[cutoff];
+		count[cutoff] = sum;
+		sum += this_count;
+		if(sum >= k) {
+			break;
+		}
+	}
+
+	for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
+		val_t *data = in->chunks[chunk_no]->columns[col]->data;
+		size_t chunk_rows = get_chunk_rows(in, chunk_no);
+		for(size_t chunk_offset = 0; chunk_offset < chunk_rows; ++chunk_offset) {
+			val_t key = data[chunk_offset];
+			if(key <= cutoff && count[key] < k) {
+				locs[count[key]++] = ROW_LOC(chunk_no, chunk_offset);
+			}
+		}
+	}
+
+	my_free(count);
+}
+
+// restores the max-heap property below node
+static inline __attribute__((always_inline)) void
+topk_sift_down(sort_pair_t *heap, size_t n, size_t node) {
+	sort_pair_t val = heap[node];
+	for(;;) {
+		size_t child = 2 * node + 1;
+		if(child >= n) {
+			break;
+		}
+		if(child + 1 < n && heap[child + 1] > heap[child]) {
+			++child;
+		}
+		if(heap[child] <= val) {
+			break;
+		}
+		heap[node] = heap[child];
+		node = child;
+	}
+	heap[node] = val;
+}
+
+// Locations of the k smallest (key, row) pairs, in order, by one pass with a max-heap of the best k so far.
+static void
+topk_heap(col_table_t *in, size_t col, size_t k, row_loc_t *locs) {
+	size_t chunk_size = get_chunk_size(in);
+	// shares storage with locs, which has the same element size
+	sort_pair_t *heap = (sort_pair_t *) locs;
+	if(k == 0) {
+		return;
+	}
+
+	size_t n = 0;
+	size_t row = 0;
+	for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
+		val_t *data = in->chunks[chunk_no]->columns[col]->data;
+		size_t chunk_rows = get_chunk_rows(in, chunk_no);
+		for(size_t chunk_offset = 0; chunk_offset < chunk_rows; ++chunk_offset, ++row) {
+			sort_pair_t pair = SORT_PAIR(data[chunk_offset], row);
+			if(n < k) {
+				// sift up
+				size_t node = n++;
+				while(node > 0 && heap[(node - 1) / 2] < pair) {
+					heap[node] = heap[(node - 1) / 2];
+					node = (node - 1) / 2;
+				}
+				heap[node] = pair;
+			} else if(pair < heap[0]) {
+				// once the heap is full, most rows fail this test
+				heap[0] = pair;
+				topk_sift_down(heap, n, 0);
+			}
+		}
+	}
+
+	// heapsort in place: the largest remaining pair goes to the end
+	for(size_t end = n; end > 1; --end) {
+		sort_pair_t swap_tmp;
+		SWAP(heap[0], heap[end - 1], swap_tmp);
+		topk_sift_down(heap, end - 1, 0);
+	}
+
+	sort_pairs_to_locs(heap, n, chunk_size);
+}
+
+// The first k rows of a stable sort of in on col, without sorting the rest.
+// Uses a histogram cutoff if domain_size is known (non-zero) and no bigger than the table,
+// otherwise a bounded heap. Either way only k row locations and k output rows are allocated.
+col_table_t *
+topk(col_table_t *in, size_t col, size_t domain_size, size_t k) {
+	size_t chunk_size = get_chunk_size(in);
+	k = MIN(k, in->num_rows);
+	assert(in->num_rows <= ((size_t) 1 << 32)); // row ids must fit in a sort_pair_t
+
+	row_loc_t *locs = NEWA(row_loc_t, MAX(k, 1));
+	MALLOC_CHECK(locs, "top k locations");
+
+	if(domain_size != 0 && domain_size <= in->num_rows) {
+		topk_histogram(in, col, domain_size, k, locs);
+	} else {
+		topk_heap(in, col, k, locs);
+	}
+
+	col_table_t *out = create_col_table_empty(k, MAX(1, MIN(k, chunk_size)), in->num_cols);
+	gather_rows(in, locs, k, out);
+
+	my_free(locs);
+	free_col_table(in);
+	out->sorted_col = col;
+	return out;
+}
+
+// Runs shorter than this are not worth merging on their own;
+// adaptivesort extends them by insertion sort first.
+#define ADAPTIVE_MIN_MERGE 64
+// adaptive_merge inserts up to this many stray pairs one by one instead of merging
+#define ADAPTIVE_INSERT_MAX 8
+// Run lengths on the stack grow at least like the Fibonacci numbers, so this covers any n < 2^64.
+#define ADAPTIVE_MAX_RUNS 96
+
+// the minimum run length for n pairs, chosen so that n / min_run is (just below) a power of two
+static size_t
+adaptive_min_run(size_t n) {
+	size_t low_bits = 0;
+	while(n >= ADAPTIVE_MIN_MERGE) {
+		low_bits |= n & 1;
+		n >>= 1;
+	}
+	return n + low_bits;
+}
+
+// number of pairs in sorted pairs[0:n] which are smaller than key
+static size_t
+pairs_rank(const sort_pair_t *pairs, size_t n, sort_pair_t key) {
+	size_t lo = 0;
+	size_t hi = n;
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if(pairs[mid] < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static void
+reverse_pairs(sort_pair_t *start, sort_pair_t *stop) {
+	sort_pair_t swap_tmp;
+	for(--stop; start < stop; ++start, --stop) {
+		SWAP(*start, *stop, swap_tmp);
+	}
+}
+
+// Reverses pairs[0:n], and then each block of equal keys back,
+// so a run of non-increasing keys becomes ascending with equal keys still in row order.
+static void
+reverse_pairs_stably(sort_pair_t *pairs, size_t n) {
+	reverse_pairs(pairs, pairs + n);
+	for(size_t block = 0; block < n; ) {
+		size_t block_stop = block + 1;
+		while(block_stop < n && SORT_PAIR_KEY(pairs[block_stop]) == SORT_PAIR_KEY(pairs[block])) {
+			++block_stop;
+		}
+		reverse_pairs(pairs + block, pairs + block_stop);
+		block = block_stop;
+	}
+}
+
+// Length of the natural run at pairs[0:n], made ascending in place.
+// A run of non-increasing keys counts, and is reversed stably.
+static size_t
+adaptive_next_run(sort_pair_t *pairs, size_t n) {
+	if(n < 2) {
+		return n;
+	}
+	size_t stop = 1;
+	if(SORT_PAIR_KEY(pairs[1]) < SORT_PAIR_KEY(pairs[0])) {
+		while(stop < n && SORT_PAIR_KEY(pairs[stop]) <= SORT_PAIR_KEY(pairs[stop - 1])) {
+			++stop;
+		}
+		reverse_pairs_stably(pairs, stop);
+	} else {
+		while(stop < n && pairs[stop] > pairs[stop - 1]) {
+			++stop;
+		}
+	}
+	return stop;
+}
+
+// binary insertion sort of pairs[0:n], of which pairs[0:sorted] already is
+static void
+insertion_sort_pairs(sort_pair_t *pairs, size_t sorted, size_t n) {
+	for(size_t i = sorted; i < n; ++i) {
+		sort_pair_t pair = pairs[i];
+		size_t pos = pairs_rank(pairs, i, pair);
+		memmove(pairs + pos + 1, pairs + pos, (i - pos) * sizeof(sort_pair_t));
+		pairs[pos] = pair;
+	}
+}
+
+// Merges the adjacent sorted runs a[0:na] and a[na:na + nb] in place, using tmp.
+// Pairs of a which are already below b, and pairs of b already above a, are trimmed off first,
+// so nearly-sorted runs cost little more than the binary searches.
+// If what is left of one side is a handful of stray pairs,
+// each is binary-searched into the other side and the pairs in between are moved in bulk.
+static void
+adaptive_merge(sort_pair_t *a, size_t na, size_t nb, sort_pair_t *tmp) {
+	sort_pair_t *b = a + na;
+	size_t in_place = pairs_rank(a, na, b[0]);
+	a += in_place;
+	na -= in_place;
+	if(na == 0) {
+		return;
+	}
+	nb = pairs_rank(b, nb, a[na - 1]);
+	if(nb == 0) {
+		return;
+	}
+
+	if(na <= ADAPTIVE_INSERT_MAX) {
+		// from the smallest pair of a up: everything of b below it moves left, in front of it
+		memcpy(tmp, a, na * sizeof(sort_pair_t));
+		size_t b_start = 0;
+		for(size_t i = 0; i < na; ++i) {
+			size_t pos = b_start + pairs_rank(b + b_start, nb - b_start, tmp[i]);
+			memmove(a + i + b_start, b + b_start, (pos - b_start) * sizeof(sort_pair_t));
+			a[i + pos] = tmp[i];
+			b_start = pos;
+		}
+	} else if(nb <= ADAPTIVE_INSERT_MAX) {
+		// from the largest pair of b down: everything of a above it moves right, behind it
+		memcpy(tmp, b, nb * sizeof(sort_pair_t));
+		size_t a_stop = na;
+		for(size_t j = nb; j-- > 0; ) {
+			size_t pos = pairs_rank(a, a_stop, tmp[j]);
+			memmove(a + pos + j + 1, a + pos, (a_stop - pos) * sizeof(sort_pair_t));
+			a[pos + j] = tmp[j];
+			a_stop = pos;
+		}
+	} else {
+		memcpy(tmp, a, na * sizeof(sort_pair_t));
+		merge_pairs(tmp, na, b, nb, a);
+	}
+}
+
+typedef struct {
+	size_t start[ADAPTIVE_MAX_RUNS];
+	size_t len[ADAPTIVE_MAX_RUNS];
+	size_t num_runs;
+} adaptive_stack_t;
+
+static void
+adaptive_merge_at(adaptive_stack_t *stack, size_t i, sort_pair_t *pairs, sort_pair_t *tmp) {
+	adaptive_merge(pairs + stack->start[i], stack->len[i], stack->len[i + 1], tmp);
+	stack->len[i] += stack->len[i + 1];
+	if(i + 3 == stack->num_runs) {
+		stack->start[i + 1] = stack->start[i + 2];
+		stack->len[i + 1] = stack->len[i + 2];
+	}
+	--stack->num_runs;
+}
+
+// Merges until the run lengths on the stack shrink at least like the Fibonacci numbers
+// (checking the top three runs, as corrected after the original Timsort invariant was found to fail).
+static void
+adaptive_merge_collapse(adaptive_stack_t *stack, sort_pair_t *pairs, sort_pair_t *tmp) {
+	size_t *len = stack->len;
+	while(stack->num_runs > 1) {
+		size_t i = stack->num_runs - 2;
+		if((i > 0 && len[i - 1] <= len[i] + len[i + 1]) || (i > 1 && len[i - 2] <= len[i - 1] + len[i])) {
+			if(len[i - 1] < len[i + 1]) {
+				--i;
+			}
+		} else if(len[i] > len[i + 1]) {
+			break;
+		}
+		adaptive_merge_at(stack, i, pairs, tmp);
+	}
+}
+
+// Timsort-style sort of pairs[0:n], using tmp[0:n]:
+// natural runs are found (descending ones are reversed, stably),
+// short runs are extended by insertion sort, and the runs are merged.
+static void
+adaptive_merge_runs(sort_pair_t *pairs, size_t n, sort_pair_t *tmp) {
+	adaptive_stack_t stack;
+	stack.num_runs = 0;
+	size_t min_run = adaptive_min_run(n);
+
+	for(size_t start = 0; start < n; ) {
+		size_t len = adaptive_next_run(pairs + start, n - start);
+		if(len < min_run) {
+			size_t forced = MIN(min_run, n - start);
+			insertion_sort_pairs(pairs + start, len, forced);
+			len = forced;
+		}
+		assert(stack.num_runs < ADAPTIVE_MAX_RUNS);
+		stack.start[stack.num_runs] = start;
+		stack.len[stack.num_runs] = len;
+		++stack.num_runs;
+		adaptive_merge_collapse(&stack, pairs, tmp);
+		start += len;
+	}
+
+	while(stack.num_runs > 1) {
+		size_t i = stack.num_runs - 2;
+		if(i > 0 && stack.len[i - 1] < stack.len[i + 1]) {
+			--i;
+		}
+		adaptive_merge_at(&stack, i, pairs, tmp);
+	}
+}
+
+// Splits pairs[0:n] into an ascending subsequence, compacted into pairs[0:return value],
+// and the stray pairs which break it, copied to strays[0:*num_strays].
+// When a pair breaks the subsequence, the next pair decides who strayed:
+// if it continues the subsequence, the pair did; otherwise the last few pairs taken did
+// (eg. a row displaced to the front), unless that would be more than ADAPTIVE_INSERT_MAX.
+static size_t
+adaptive_split_strays(sort_pair_t *pairs, size_t n, sort_pair_t *strays, size_t *num_strays) {
+	size_t m = 0;
+	size_t s = 0;
+	for(size_t i = 0; i < n; ++i) {
+		sort_pair_t pair = pairs[i];
+		if(m == 0 || pair > pairs[m - 1]) {
+			pairs[m++] = pair;
+			continue;
+		}
+		// m <= i, so pairs[i + 1] is still input
+		if(i + 1 == n || pairs[i + 1] < pairs[m - 1]) {
+			size_t above = 1;
+			while(above < m && above <= ADAPTIVE_INSERT_MAX && pairs[m - 1 - above] > pair) {
+				++above;
+			}
+			if(above <= ADAPTIVE_INSERT_MAX) {
+				m -= above;
+				memcpy(strays + s, pairs + m, above * sizeof(sort_pair_t));
+				s += above;
+				pairs[m++] = pair;
+				continue;
+			}
+		}
+		strays[s++] = pair;
+	}
+	*num_strays = s;
+	return m;
+}
+
+// Sorts pairs[0:n], using tmp[0:n].
+// The strays off an ascending subsequence are sorted by merging their natural runs,
+// then merged back in once. Time-ordered data with a few late or displaced rows
+// thus costs two linear passes and a sort of the displaced rows only.
+static void
+adaptive_sort_pairs(sort_pair_t *pairs, size_t n, sort_pair_t *tmp) {
+	size_t num_strays;
+	size_t m = adaptive_split_strays(pairs, n, tmp, &num_strays);
+	if(num_strays == 0) {
+		return;
+	}
+	memcpy(pairs + m, tmp, num_strays * sizeof(sort_pair_t));
+	adaptive_merge_runs(pairs + m, num_strays, tmp);
+	adaptive_merge(pairs, m, num_strays, tmp);
+}
+
+// Sort which does less work on input that is already partly in order.
+// Sorted input is found by one scan and returned as is.
+// Input without long runs goes to a radix sort.
+// Otherwise the rows out of order are split off, sorted by merging their natural runs, and merged back.
+// Every column is then moved once by gather_rows.
+col_table_t *
+adaptivesort(col_table_t *in, size_t col, __attribute__((unused)) size_t domain_size) {
+	size_t num_rows = in->num_rows;
+	if(sorted_run_end(in, 0, num_rows, col) == num_rows) {
+		in->sorted_col = col;
+		return in;
+	}
+	assert(num_rows <= ((size_t) 1 << 32)); // row ids must fit in a sort_pair_t
+
+	sort_pair_t *pairs = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(pairs, "sort pairs");
+	sort_pair_t *tmp = NEWA(sort_pair_t, num_rows);
+	MALLOC_CHECK(tmp, "merge scratch");
+
+	make_sort_pairs(in, col, pairs);
+
+	// With no order to exploit (natural runs shorter than the minimum merge, both ways),
+	// a radix sort beats merging.
+	size_t ascents = 0;
+	size_t descents = 0;
+	for(size_t row = 1; row < num_rows; ++row) {
+		ascents  += SORT_PAIR_KEY(pairs[row]) > SORT_PAIR_KEY(pairs[row - 1]);
+		descents += SORT_PAIR_KEY(pairs[row]) < SORT_PAIR_KEY(pairs[row - 1]);
+	}
+	sort_pair_t *sorted = pairs;
+	if(MIN(ascents, descents) * ADAPTIVE_MIN_MERGE > num_rows) {
+		sorted = radix_sort_pairs(pairs, tmp, num_rows, 32, 64);
+	} else {
+		if(descents > ascents) {
+			// mostly descending: turned around, the strays are the same few rows
+			reverse_pairs_stably(pairs, num_rows);
+		}
+		adaptive_sort_pairs(pairs, num_rows, tmp);
+	}
+	sort_pairs_to_locs(sorted, num_rows, get_chunk_size(in));
+
+	col_table_t *out = create_col_table_empty(num_rows, get_chunk_size(in), in->num_cols);
+	gather_rows(in, (row_loc_t *) sorted, num_rows, out);
+
+	my_free(pairs);
+	my_free(tmp);
+	free_col_table(in);
+	out->sorted_col = col;
+	return out;
+}
+
+size_t* domain_count(col_table_t *in, size_t col, size_t domain_size) {
+	size_t *domain_counts = NEWA(size_t, domain_size);
+	for(size_t domain_elem = 0; domain_elem < domain_size; ++domain_elem) {
+		domain_counts[domain_elem] = 0;
+	}
+
+	for(size_t chunk_no = 0; chunk_no < in->num_chunks; ++chunk_no) {
+		val_t *data = in->chunks[chunk_no]->columns[col]->data;
+		for(size_t chunk_offset = 0; chunk_offset < get_chunk_size(in); ++chunk_offset) {
+			assert(data[chunk_offset] < domain_size);
+			domain_counts[data[chunk_offset]]++;
+		}
+	}
+	return domain_counts;
+}
+
+bool
+check_sorted_helper(col_table_t *result, size_t start_row, size_t stop_row, size_t sort_col) {
+	size_t run_end = sorted_run_end(result, start_row, stop_row, sort_col);
+	if(run_end < stop_row) {
+		#ifdef VERBOSE
+		{
+			size_t chunk_size = get_chunk_size(result);
+			val_t last = result->chunks[(run_end - 1) / chunk_size]->columns[sort_col]->data[(run_end - 1) % chunk_size];
+			val_t next = result->chunks[ run_end      / chunk_size]->columns[sort_col]->data[ run_end      % chunk_size];
+			printf("\n");
+			printf("%u = data.chunks[%lu].offset[%lu]\n", last, (run_end - 1) / chunk_size, (run_end - 1) % chunk_size);
+			printf("%u = data.chunks[%lu].offset[%lu]\n", next,  run_end      / chunk_size,  run_end      % chunk_size);
+			printf("Out of order\nNew:\n");
+			print_db(result);
+		}
+		#endif
 
-	bool sorted = check_sorted_helper(result, 0, num_rows, sort_col);
-	if(!sorted) {
 		return false;
 	}
 
-	if(copy) {
+	return true;
+}
+
+// whether a and b have the same multiset of values in col
+bool
+same_keys(col_table_t *a, col_table_t *b, size_t col) {
+	if(a->num_rows != b->num_rows) {
+		return false;
+	}
+	size_t num_rows = a->num_rows;
+
+	sort_pair_t *pairs[2];
+	sort_pair_t *sorted[2];
+	sort_pair_t *tmp = NEWA(sort_pair_t, num_rows);
+	MALLOC_NO_RET(tmp, "sort pairs scratch");
+	col_table_t *tables[2] = {a, b};
+	for(uint8_t i = 0; i < 2; ++i) {
+		pairs[i] = NEWA(sort_pair_t, num_rows);
+		MALLOC_NO_RET(pairs[i], "sort pairs");
+		make_sort_pairs(tables[i], col, pairs[i]);
+		sorted[i] = radix_sort_pairs(pairs[i], tmp, num_rows, 32, 64);
+		if(sorted[i] == tmp) {
+			memcpy(pairs[i], tmp, num_rows * sizeof(sort_pair_t));
+		}
+	}
+
+	bool same = true;
+	for(size_t i = 0; i < num_rows && same; ++i) {
+		same = SORT_PAIR_KEY(pairs[0][i]) == SORT_PAIR_KEY(pairs[1][i]);
+	}
+
+	my_free(pairs[0]);
+	my_free(pairs[1]);
+	my_free(tmp);
+	return same;
+}
+
+bool
+check_sorted(col_table_t *result, size_t sort_col, size_t domain_size, col_table_t *copy) {
+	size_t chunk_size = get_chunk_size(result);
+	size_t num_rows = chunk_size * result->num_chunks;
+
+	bool sorted = check_sorted_helper(result, 0, num_rows, sort_col);
+	if(!sorted) {
+		return false;
+	}
+
+	if(copy && domain_size > num_rows) {
+		// one counter per domain element would be bigger than the table
+		if(!same_keys(result, copy, sort_col)) {
+			#ifdef VERBOSE
+			{
+				printf("Not the same keys as the original\n");
+			}
+			#endif
+			return false;
+		}
+	} else if(copy) {
 		size_t* count1 = domain_count(result, sort_col, domain_size);
 		size_t* count2 = domain_count(copy, sort_col, domain_size);
 		bool same = 0 == memcmp(count1, count2, domain_size * sizeof(size_t));
@@ -1308,3 +3424,38 @@ check_sorted(col_table_t *result, size_t sort_col, size_t domain_size, col_table
 
 	return true;
 }
+
+// true iff result is ordered by keys and has the same key values as copy (if not NULL)
+bool
+check_multikey_sorted(col_table_t *result, const sort_key_t *keys, size_t num_keys, col_table_t *copy) {
+	size_t chunk_size = get_chunk_size(result);
+	for(size_t row = 1; row < result->num_rows; ++row) {
+		size_t prev_row = row - 1;
+		for(size_t key = 0; key < num_keys; ++key) {
+			size_t col = keys[key].col;
+			val_t prev = result->chunks[prev_row / chunk_size]->columns[col]->data[prev_row % chunk_size];
+			val_t this = result->chunks[row / chunk_size]->columns[col]->data[row % chunk_size];
+			if(prev == this) {
+				continue;
+			}
+			if((prev < this) != (keys[key].dir == SORT_ASC)) {
+				#ifdef VERBOSE
+				{
+					printf("Rows %lu and %lu out of order on key %lu\n", prev_row, row, key);
+				}
+				#endif
+				return false;
+			}
+			break;
+		}
+	}
+
+	if(copy) {
+		for(size_t key = 0; key < num_keys; ++key) {
+			if(!same_keys(result, copy, keys[key].col)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,113 @@
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+	#include <nautilus/nautilus.h>
+	#include <nautilus/thread.h>
+#else
+	#include <stdbool.h>
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+#include "app/database/common.h"
+#include "app/database/parallel.h"
+
+size_t par_threads = 1;
+
+typedef struct {
+	par_fn_t fn;
+	void *arg;
+	size_t thread_no;
+	size_t num_threads;
+} par_task_t;
+
+void
+par_set_threads(size_t num_threads) {
+	par_threads = MAX(1, MIN(num_threads, MAX_THREADS));
+}
+
+size_t
+par_num_cpus() {
+	#ifdef __NAUTILUS__
+		return nk_get_num_cpus();
+	#else
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		return cpus > 0 ? (size_t) cpus : 1;
+	#endif
+}
+
+#ifdef __NAUTILUS__
+
+static void
+par_trampoline(void *in, __attribute__((unused)) void **out) {
+	par_task_t *task = (par_task_t *) in;
+	task->fn(task->arg, task->thread_no, task->num_threads);
+}
+
+typedef nk_thread_id_t par_thread_t;
+
+static inline int
+par_spawn(par_thread_t *thread, par_task_t *task) {
+	return nk_thread_start(par_trampoline, task, NULL, 0, TSTACK_DEFAULT, thread, -1);
+}
+
+static inline void
+par_join(par_thread_t thread) {
+	nk_join(thread, NULL);
+}
+
+#else
+
+static void *
+par_trampoline(void *in) {
+	par_task_t *task = (par_task_t *) in;
+	task->fn(task->arg, task->thread_no, task->num_threads);
+	return NULL;
+}
+
+typedef pthread_t par_thread_t;
+
+static inline int
+par_spawn(par_thread_t *thread, par_task_t *task) {
+	return pthread_create(thread, NULL, par_trampoline, task);
+}
+
+static inline void
+par_join(par_thread_t thread) {
+	pthread_join(thread, NULL);
+}
+
+#endif
+
+void
+par_run(size_t num_threads, par_fn_t fn, void *arg) {
+	num_threads = MAX(1, MIN(num_threads, MAX_THREADS));
+
+	par_task_t tasks[MAX_THREADS];
+	par_thread_t threads[MAX_THREADS];
+	bool spawned[MAX_THREADS];
+
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		tasks[thread_no].fn = fn;
+		tasks[thread_no].arg = arg;
+		tasks[thread_no].thread_no = thread_no;
+		tasks[thread_no].num_threads = num_threads;
+	}
+
+	// thread 0 is the caller
+	for(size_t thread_no = 1; thread_no < num_threads; ++thread_no) {
+		spawned[thread_no] = par_spawn(&threads[thread_no], &tasks[thread_no]) == 0;
+		if(!spawned[thread_no]) {
+			ERROR("Could not spawn thread %lu; running it inline\n", thread_no);
+		}
+	}
+
+	fn(arg, 0, num_threads);
+
+	for(size_t thread_no = 1; thread_no < num_threads; ++thread_no) {
+		if(spawned[thread_no]) {
+			par_join(threads[thread_no]);
+		} else {
+			fn(arg, thread_no, num_threads);
+		}
+	}
+}
@@ -0,0 +1,1243 @@
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <assert.h>
+	#include <string.h>
+#endif
+
+#include "app/database/common.h"
+#include "app/database/selection.h"
+#include "app/database/simd.h"
+#include "app/database/parallel.h"
+#include "app/database/timing.h"
+
+#ifdef DB_SIMD
+	#include <immintrin.h>
+#endif
+
+// a word with fewer selected rows than this is compacted bit by bit instead of branch-free
+#define SEL_SPARSE_WORD (BV_UNIT_BITS / 4)
+
+sel_bitmap_t *
+sel_bitmap_create(col_table_t *t) {
+	size_t chunk_size = get_chunk_size(t);
+	sel_bitmap_t *bm = NEW(sel_bitmap_t);
+	MALLOC_CHECK(bm, "bitmap");
+	bm->num_chunks = t->num_chunks;
+	bm->chunk_size = chunk_size;
+	bm->chunks = NEWA(bit_vec_t, t->num_chunks);
+	MALLOC_CHECK(bm->chunks, "bitmap chunks");
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		bv_init(&bm->chunks[chunk_no], get_chunk_rows(t, chunk_no));
+		MALLOC_CHECK(bm->chunks[chunk_no].data, "bitmap chunk");
+		bv_reset(&bm->chunks[chunk_no]);
+	}
+	return bm;
+}
+
+void
+sel_bitmap_free(sel_bitmap_t *bm) {
+	for(size_t chunk_no = 0; chunk_no < bm->num_chunks; ++chunk_no) {
+		bv_free(&bm->chunks[chunk_no]);
+	}
+	my_free(bm->chunks);
+	my_free(bm);
+}
+
+size_t
+sel_bitmap_count(sel_bitmap_t *bm) {
+	size_t count = 0;
+	for(size_t chunk_no = 0; chunk_no < bm->num_chunks; ++chunk_no) {
+		count += bv_count(&bm->chunks[chunk_no]);
+	}
+	return count;
+}
+
+void
+sel_bitmap_and(sel_bitmap_t *dst, sel_bitmap_t *src) {
+	assert(dst->num_chunks == src->num_chunks);
+	for(size_t chunk_no = 0; chunk_no < dst->num_chunks; ++chunk_no) {
+		bv_and(&dst->chunks[chunk_no], &src->chunks[chunk_no]);
+	}
+}
+
+void
+sel_bitmap_or(sel_bitmap_t *dst, sel_bitmap_t *src) {
+	assert(dst->num_chunks == src->num_chunks);
+	for(size_t chunk_no = 0; chunk_no < dst->num_chunks; ++chunk_no) {
+		bv_or(&dst->chunks[chunk_no], &src->chunks[chunk_no]);
+	}
+}
+
+// Stores word, an expression of unit, into every full word bits[unit] for unit < num_words,
+// combined as asked. The switch is outside the loops, so each loop does one thing.
+#define SEL_EVAL_WORDS(bits, num_words, combine, word) do { \
+	switch(combine) { \
+	case SEL_SET: \
+		for(size_t unit = 0; unit < (num_words); ++unit) { \
+			(bits)[unit] = (word); \
+		} \
+		break; \
+	case SEL_AND: \
+		for(size_t unit = 0; unit < (num_words); ++unit) { \
+			(bits)[unit] &= (word); \
+		} \
+		break; \
+	case SEL_OR: \
+		for(size_t unit = 0; unit < (num_words); ++unit) { \
+			(bits)[unit] |= (word); \
+		} \
+		break; \
+	} \
+} while(0)
+
+static inline __attribute__((always_inline)) void
+combine_word(bit_unit_t *unit, bit_unit_t word, sel_combine_t combine) {
+	switch(combine) {
+	case SEL_SET: *unit  = word; break;
+	case SEL_AND: *unit &= word; break;
+	case SEL_OR:  *unit |= word; break;
+	}
+}
+
+// The right operand of a comparison: a constant or the values of another column.
+typedef enum {
+	SEL_OPERAND_CONST = 0,
+	SEL_OPERAND_ATT,
+	NUM_SEL_OPERANDS
+} sel_operand_t;
+
+// Evaluates a[i] <pred> b[i] for i < n into bits; b is only read by comparisons against a column.
+typedef void (*sel_chunk_fn_t)(const val_t *a, const val_t *b, const pred_args_t *p, size_t n, bit_unit_t *bits, sel_combine_t combine);
+
+// Chunk kernels are stamped out for every predicate form, operand and vector level.
+// The word functions take the operand as a constant argument and are always inlined,
+// so each copy is specialized and none switches on the predicate or operand in its loop.
+#define SEL_DEFINE_CHUNK_FN(name, level, TARGET, operand, ATT) \
+	static TARGET void \
+	sel_chunk_##name##_##level##_##operand(const val_t *a, const val_t *b, const pred_args_t *p, size_t n, bit_unit_t *bits, sel_combine_t combine) { \
+		/* a local copy, so the loop keeps the arguments in registers */ \
+		const pred_args_t args = *p; \
+		SEL_EVAL_WORDS(bits, n / BV_UNIT_BITS, combine, \
+					   sel_word_##name##_##level(a + unit * BV_UNIT_BITS, b + unit * BV_UNIT_BITS, &args, ATT)); \
+		if(n % BV_UNIT_BITS > 0) { \
+			size_t unit = n / BV_UNIT_BITS; \
+			combine_word(&bits[unit], \
+						 sel_bits_##name(a + unit * BV_UNIT_BITS, b + unit * BV_UNIT_BITS, &args, n % BV_UNIT_BITS, ATT), \
+						 combine); \
+		} \
+	}
+
+#define SEL_DEFINE_CHUNK_FNS(name, level, TARGET) \
+	SEL_DEFINE_CHUNK_FN(name, level, TARGET, const, false) \
+	SEL_DEFINE_CHUNK_FN(name, level, TARGET, att, true)
+
+#define SEL_DEFINE_SCALAR_KERNELS(name, MATCH) \
+	/* bit i is a[i] <pred> b[i], for the n < BV_UNIT_BITS values after the last full word */ \
+	static inline __attribute__((always_inline)) bit_unit_t \
+	sel_bits_##name(const val_t *a, const val_t *b, const pred_args_t *p, size_t n, bool att) { \
+		bit_unit_t word = 0; \
+		(void) b; (void) att; \
+		for(size_t i = 0; i < n; ++i) { \
+			word |= ((bit_unit_t) MATCH(a[i], att ? b[i] : p->val, p)) << i; \
+		} \
+		return word; \
+	} \
+	\
+	static inline __attribute__((always_inline)) bit_unit_t \
+	sel_word_##name##_scalar(const val_t *a, const val_t *b, const pred_args_t *p, bool att) { \
+		bit_unit_t word = 0; \
+		(void) b; (void) att; \
+		/* 8 independent compares per step, packed into one byte of the word */ \
+		for(size_t i = 0; i < BV_UNIT_BITS; i += 8) { \
+			bit_unit_t byte = 0; \
+			for(size_t j = 0; j < 8; ++j) { \
+				byte |= ((bit_unit_t) MATCH(a[i + j], att ? b[i + j] : p->val, p)) << j; \
+			} \
+			word |= byte << i; \
+		} \
+		return word; \
+	}
+
+SEL_DEFINE_SCALAR_KERNELS(eq, PRED_EQ_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(ne, PRED_NE_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(lt, PRED_LT_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(le, PRED_LE_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(gt, PRED_GT_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(ge, PRED_GE_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(between, PRED_BETWEEN_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(in_lookup, PRED_IN_LOOKUP_MATCH)
+SEL_DEFINE_SCALAR_KERNELS(in_list, PRED_IN_LIST_MATCH)
+
+SEL_DEFINE_CHUNK_FNS(eq, scalar, )
+SEL_DEFINE_CHUNK_FNS(ne, scalar, )
+SEL_DEFINE_CHUNK_FNS(lt, scalar, )
+SEL_DEFINE_CHUNK_FNS(le, scalar, )
+SEL_DEFINE_CHUNK_FNS(gt, scalar, )
+SEL_DEFINE_CHUNK_FNS(ge, scalar, )
+SEL_DEFINE_CHUNK_FN(between, scalar, , const, false)
+SEL_DEFINE_CHUNK_FN(in_lookup, scalar, , const, false)
+SEL_DEFINE_CHUNK_FN(in_list, scalar, , const, false)
+
+#ifdef DB_SIMD
+
+// Vector comparisons, all ones in the lanes where x <cmp> y.
+// There are only signed compares, so the order of unsigned values comes from max: x >= y iff max(x, y) == x.
+// NE, LT and GT are the complements of EQ, GE and LE, so their words are inverted instead.
+#define SSE42_EQ(x, y) _mm_cmpeq_epi32((x), (y))
+#define SSE42_GE(x, y) _mm_cmpeq_epi32(_mm_max_epu32((x), (y)), (x))
+#define SSE42_LE(x, y) SSE42_GE((y), (x))
+#define AVX2_EQ(x, y) _mm256_cmpeq_epi32((x), (y))
+#define AVX2_GE(x, y) _mm256_cmpeq_epi32(_mm256_max_epu32((x), (y)), (x))
+#define AVX2_LE(x, y) AVX2_GE((y), (x))
+
+#define SSE42_WORD_BITS(mask) ((bit_unit_t) _mm_movemask_ps(_mm_castsi128_ps(mask)))
+#define AVX2_WORD_BITS(mask) ((bit_unit_t) _mm256_movemask_ps(_mm256_castsi256_ps(mask)))
+
+#define SEL_DEFINE_VECTOR_KERNELS(name, VEC_CMP, INVERT) \
+	static inline __attribute__((always_inline, target("sse4.2"))) bit_unit_t \
+	sel_word_##name##_sse42(const val_t *a, const val_t *b, const pred_args_t *p, bool att) { \
+		const __m128i vals = _mm_set1_epi32(p->val); \
+		bit_unit_t word = 0; \
+		for(size_t i = 0; i < BV_UNIT_BITS; i += 4) { \
+			__m128i x = _mm_loadu_si128((const __m128i *) (a + i)); \
+			__m128i y = att ? _mm_loadu_si128((const __m128i *) (b + i)) : vals; \
+			word |= SSE42_WORD_BITS(SSE42_##VEC_CMP(x, y)) << i; \
+		} \
+		return INVERT ? ~word : word; \
+	} \
+	\
+	static inline __attribute__((always_inline, target("avx2"))) bit_unit_t \
+	sel_word_##name##_avx2(const val_t *a, const val_t *b, const pred_args_t *p, bool att) { \
+		const __m256i vals = _mm256_set1_epi32(p->val); \
+		bit_unit_t word = 0; \
+		for(size_t i = 0; i < BV_UNIT_BITS; i += 8) { \
+			__m256i x = _mm256_loadu_si256((const __m256i *) (a + i)); \
+			__m256i y = att ? _mm256_loadu_si256((const __m256i *) (b + i)) : vals; \
+			word |= AVX2_WORD_BITS(AVX2_##VEC_CMP(x, y)) << i; \
+		} \
+		return INVERT ? ~word : word; \
+	} \
+	\
+	SEL_DEFINE_CHUNK_FNS(name, sse42, __attribute__((target("sse4.2")))) \
+	SEL_DEFINE_CHUNK_FNS(name, avx2, __attribute__((target("avx2"))))
+
+SEL_DEFINE_VECTOR_KERNELS(eq, EQ, false)
+SEL_DEFINE_VECTOR_KERNELS(ne, EQ, true)
+SEL_DEFINE_VECTOR_KERNELS(lt, GE, true)
+SEL_DEFINE_VECTOR_KERNELS(le, LE, false)
+SEL_DEFINE_VECTOR_KERNELS(gt, LE, true)
+SEL_DEFINE_VECTOR_KERNELS(ge, GE, false)
+
+// BETWEEN is one compare after subtracting lo, as in PRED_BETWEEN_MATCH
+static inline __attribute__((always_inline, target("sse4.2"))) bit_unit_t
+sel_word_between_sse42(const val_t *a, const val_t *b, const pred_args_t *p, bool att) {
+	(void) b; (void) att;
+	const __m128i lo = _mm_set1_epi32(p->lo);
+	const __m128i range = _mm_set1_epi32(p->range);
+	bit_unit_t word = 0;
+	for(size_t i = 0; i < BV_UNIT_BITS; i += 4) {
+		__m128i x = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) (a + i)), lo);
+		word |= SSE42_WORD_BITS(SSE42_LE(x, range)) << i;
+	}
+	return word;
+}
+
+static inline __attribute__((always_inline, target("avx2"))) bit_unit_t
+sel_word_between_avx2(const val_t *a, const val_t *b, const pred_args_t *p, bool att) {
+	(void) b; (void) att;
+	const __m256i lo = _mm256_set1_epi32(p->lo);
+	const __m256i range = _mm256_set1_epi32(p->range);
+	bit_unit_t word = 0;
+	for(size_t i = 0; i < BV_UNIT_BITS; i += 8) {
+		__m256i x = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (a + i)), lo);
+		word |= AVX2_WORD_BITS(AVX2_LE(x, range)) << i;
+	}
+	return word;
+}
+
+// a lookup gathers the 32-bit word holding each value's bit
+static inline __attribute__((always_inline, target("avx2"))) bit_unit_t
+sel_word_in_lookup_avx2(const val_t *a, const val_t *b, const pred_args_t *p, bool att) {
+	(void) b; (void) att;
+	const __m256i past_max = _mm256_set1_epi32(p->lookup_max + 1);
+	const __m256i low_bits = _mm256_set1_epi32(31);
+	const int *lookup = (const int *) p->lookup.data;
+	bit_unit_t word = 0;
+	for(size_t i = 0; i < BV_UNIT_BITS; i += 8) {
+		__m256i bit = _mm256_min_epu32(_mm256_loadu_si256((const __m256i *) (a + i)), past_max);
+		__m256i words = _mm256_i32gather_epi32(lookup, _mm256_srli_epi32(bit, 5), 4);
+		// move each value's bit to the sign bit of its lane
+		__m256i found = _mm256_sllv_epi32(words, _mm256_sub_epi32(low_bits, _mm256_and_si256(bit, low_bits)));
+		word |= AVX2_WORD_BITS(found) << i;
+	}
+	return word;
+}
+
+static inline __attribute__((always_inline, target("sse4.2"))) bit_unit_t
+sel_word_in_list_sse42(const val_t *a, const val_t *b, const pred_args_t *p, bool att) {
+	(void) b; (void) att;
+	bit_unit_t word = 0;
+	for(size_t i = 0; i < BV_UNIT_BITS; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+		__m128i found = _mm_setzero_si128();
+		for(size_t k = 0; k < p->num_vals; ++k) {
+			found = _mm_or_si128(found, _mm_cmpeq_epi32(x, _mm_set1_epi32(p->vals[k])));
+		}
+		word |= SSE42_WORD_BITS(found) << i;
+	}
+	return word;
+}
+
+static inline __attribute__((always_inline, target("avx2"))) bit_unit_t
+sel_word_in_list_avx2(const val_t *a, const val_t *b, const pred_args_t *p, bool att) {
+	(void) b; (void) att;
+	bit_unit_t word = 0;
+	for(size_t i = 0; i < BV_UNIT_BITS; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+		__m256i found = _mm256_setzero_si256();
+		for(size_t k = 0; k < p->num_vals; ++k) {
+			found = _mm256_or_si256(found, _mm256_cmpeq_epi32(x, _mm256_set1_epi32(p->vals[k])));
+		}
+		word |= AVX2_WORD_BITS(found) << i;
+	}
+	return word;
+}
+
+SEL_DEFINE_CHUNK_FN(between, sse42, __attribute__((target("sse4.2"))), const, false)
+SEL_DEFINE_CHUNK_FN(between, avx2, __attribute__((target("avx2"))), const, false)
+SEL_DEFINE_CHUNK_FN(in_lookup, avx2, __attribute__((target("avx2"))), const, false)
+SEL_DEFINE_CHUNK_FN(in_list, sse42, __attribute__((target("sse4.2"))), const, false)
+SEL_DEFINE_CHUNK_FN(in_list, avx2, __attribute__((target("avx2"))), const, false)
+
+#define SEL_CHUNK_FNS(name, operand) \
+	{ sel_chunk_##name##_scalar_##operand, sel_chunk_##name##_sse42_##operand, sel_chunk_##name##_avx2_##operand }
+// SSE4.2 has no gather
+#define SEL_IN_LOOKUP_CHUNK_FNS \
+	{ sel_chunk_in_lookup_scalar_const, sel_chunk_in_lookup_scalar_const, sel_chunk_in_lookup_avx2_const }
+#else
+#define SEL_CHUNK_FNS(name, operand) \
+	{ sel_chunk_##name##_scalar_##operand, NULL, NULL }
+#define SEL_IN_LOOKUP_CHUNK_FNS SEL_CHUNK_FNS(in_lookup, const)
+#endif
+
+// sel_cmp_chunk_fns[cmp][operand][simd level]
+static sel_chunk_fn_t sel_cmp_chunk_fns[NUM_CMPS][NUM_SEL_OPERANDS][NUM_SIMD_LEVELS] = {
+		[CMP_EQ] = { SEL_CHUNK_FNS(eq, const), SEL_CHUNK_FNS(eq, att) },
+		[CMP_NE] = { SEL_CHUNK_FNS(ne, const), SEL_CHUNK_FNS(ne, att) },
+		[CMP_LT] = { SEL_CHUNK_FNS(lt, const), SEL_CHUNK_FNS(lt, att) },
+		[CMP_LE] = { SEL_CHUNK_FNS(le, const), SEL_CHUNK_FNS(le, att) },
+		[CMP_GT] = { SEL_CHUNK_FNS(gt, const), SEL_CHUNK_FNS(gt, att) },
+		[CMP_GE] = { SEL_CHUNK_FNS(ge, const), SEL_CHUNK_FNS(ge, att) },
+};
+
+// sel_form_chunk_fns[form][simd level], for every form but PRED_FORM_CMP
+static sel_chunk_fn_t sel_form_chunk_fns[NUM_PRED_FORMS][NUM_SIMD_LEVELS] = {
+		[PRED_FORM_BETWEEN]   = SEL_CHUNK_FNS(between, const),
+		[PRED_FORM_IN_LOOKUP] = SEL_IN_LOOKUP_CHUNK_FNS,
+		[PRED_FORM_IN_LIST]   = SEL_CHUNK_FNS(in_list, const),
+};
+
+int
+pred_prepare(const predicate_t *pred, pred_args_t *args) {
+	args->form = PRED_FORM_CMP;
+	args->cmp = pred->cmp;
+	args->val = pred->val;
+	args->lo = pred->lo;
+	args->range = pred->hi - pred->lo;
+	args->lookup.data = NULL;
+	args->lookup_max = 0;
+	args->vals = pred->vals;
+	args->num_vals = pred->num_vals;
+
+	switch(pred->kind) {
+	case PRED_CMP:
+		break;
+	case PRED_BETWEEN:
+		args->form = PRED_FORM_BETWEEN;
+		if(pred->lo > pred->hi) {
+			// nothing matches, as with an empty IN-list
+			args->form = PRED_FORM_IN_LIST;
+			args->num_vals = 0;
+		}
+		break;
+	case PRED_IN:
+		args->form = PRED_FORM_IN_LIST;
+		for(size_t k = 0; k < pred->num_vals; ++k) {
+			args->lookup_max = MAX(args->lookup_max, pred->vals[k]);
+		}
+		if(args->lookup_max <= PRED_LOOKUP_MAX_VAL) {
+			args->form = PRED_FORM_IN_LOOKUP;
+			bv_init(&args->lookup, args->lookup_max + 2);
+			MALLOC_CHECK_INT(args->lookup.data, "IN-list lookup");
+			bv_reset(&args->lookup);
+			for(size_t k = 0; k < pred->num_vals; ++k) {
+				args->lookup.data[pred->vals[k] / BV_UNIT_BITS] |= ((bit_unit_t) 1) << (pred->vals[k] % BV_UNIT_BITS);
+			}
+		}
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+void
+pred_release(pred_args_t *args) {
+	if(args->lookup.data) {
+		bv_free(&args->lookup);
+		args->lookup.data = NULL;
+	}
+}
+
+zone_match_t
+zone_match_cmp(cmp_op_t cmp, val_t a_min, val_t a_max, val_t b_min, val_t b_max) {
+	switch(cmp) {
+	case CMP_EQ:
+	case CMP_NE: {
+		zone_match_t eq = ZONE_SOME;
+		if(a_max < b_min || a_min > b_max) {
+			eq = ZONE_NONE;
+		} else if(a_min == a_max && b_min == b_max) {
+			eq = ZONE_ALL;
+		}
+		return cmp == CMP_EQ || eq == ZONE_SOME ? eq : (eq == ZONE_ALL ? ZONE_NONE : ZONE_ALL);
+	}
+	case CMP_LT:
+		return a_max <  b_min ? ZONE_ALL : a_min >= b_max ? ZONE_NONE : ZONE_SOME;
+	case CMP_LE:
+		return a_max <= b_min ? ZONE_ALL : a_min >  b_max ? ZONE_NONE : ZONE_SOME;
+	case CMP_GT:
+		return a_min >  b_max ? ZONE_ALL : a_max <= b_min ? ZONE_NONE : ZONE_SOME;
+	case CMP_GE:
+		return a_min >= b_max ? ZONE_ALL : a_max <  b_min ? ZONE_NONE : ZONE_SOME;
+	default:
+		return ZONE_SOME;
+	}
+}
+
+zone_match_t
+zone_match_pred(const pred_args_t *p, val_t min, val_t max) {
+	switch(p->form) {
+	case PRED_FORM_CMP:
+		return zone_match_cmp(p->cmp, min, max, p->val, p->val);
+	case PRED_FORM_BETWEEN: {
+		val_t hi = p->lo + p->range;
+		if(max < p->lo || min > hi) {
+			return ZONE_NONE;
+		}
+		return p->lo <= min && max <= hi ? ZONE_ALL : ZONE_SOME;
+	}
+	case PRED_FORM_IN_LOOKUP:
+	case PRED_FORM_IN_LIST: {
+		if(p->form == PRED_FORM_IN_LOOKUP && min > p->lookup_max) {
+			return ZONE_NONE;
+		}
+		bool any = false;
+		for(size_t k = 0; k < p->num_vals; ++k) {
+			any |= min <= p->vals[k] && p->vals[k] <= max;
+		}
+		if(!any) {
+			return ZONE_NONE;
+		}
+		// the only value in the chunk is in the list
+		return min == max ? ZONE_ALL : ZONE_SOME;
+	}
+	default:
+		return ZONE_SOME;
+	}
+}
+
+zone_match_t
+chunk_zone_match(const pred_args_t *p, const column_chunk_t *a, const column_chunk_t *b, bool att) {
+	if(!a->has_zone) {
+		return ZONE_SOME;
+	}
+	if(att) {
+		return b->has_zone ? zone_match_cmp(p->cmp, a->min, a->max, b->min, b->max) : ZONE_SOME;
+	}
+	return zone_match_pred(p, a->min, a->max);
+}
+
+// combines all bits of bv with all (every row selected) or !all (none)
+static void
+sel_fill_chunk(bit_vec_t *bv, bool all, sel_combine_t combine) {
+	if(all ? combine == SEL_AND : combine == SEL_OR) {
+		// nothing changes
+		return;
+	}
+	size_t num_units = bv_num_units(bv->n_bits);
+	for(size_t unit = 0; unit < num_units; ++unit) {
+		bv->data[unit] = all ? ~(bit_unit_t) 0 : 0;
+	}
+	if(all && bv->n_bits % BV_UNIT_BITS > 0) {
+		bv->data[num_units - 1] = (((bit_unit_t) 1) << (bv->n_bits % BV_UNIT_BITS)) - 1;
+	}
+}
+
+// evaluates chunk chunk_no of t[col_a] <pred> t[col_b] (t[col_a] <pred> if !att) into bv;
+// a chunk ruled in or out by its zone maps is not read
+static inline __attribute__((always_inline)) void
+sel_eval_chunk(col_table_t *t, size_t chunk_no, size_t col_a, size_t col_b, bool att, const pred_args_t *p,
+			   sel_chunk_fn_t eval_chunk, bit_vec_t *bv, sel_combine_t combine) {
+	column_chunk_t *a = t->chunks[chunk_no]->columns[col_a];
+	column_chunk_t *b = t->chunks[chunk_no]->columns[col_b];
+	zone_match_t zone = chunk_zone_match(p, a, b, att);
+	if(zone != ZONE_SOME) {
+		sel_fill_chunk(bv, zone == ZONE_ALL, combine);
+		return;
+	}
+	eval_chunk(a->data, b->data, p, bv->n_bits, bv->data, combine);
+}
+
+// evaluates t[col_a] <pred> t[col_b] (t[col_a] <pred> if !att) into bm, one chunk at a time
+static void
+sel_eval(col_table_t *t, size_t col_a, size_t col_b, bool att, const pred_args_t *p, sel_chunk_fn_t eval_chunk,
+		 sel_bitmap_t *bm, sel_combine_t combine) {
+	assert(bm->num_chunks == t->num_chunks);
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		sel_eval_chunk(t, chunk_no, col_a, col_b, att, p, eval_chunk, &bm->chunks[chunk_no], combine);
+	}
+}
+
+// the chunk kernel of a prepared predicate on one column, at the current vector level
+static sel_chunk_fn_t
+pred_chunk_fn(const pred_args_t *args) {
+	return args->form == PRED_FORM_CMP
+		? sel_cmp_chunk_fns[args->cmp][SEL_OPERAND_CONST][simd_get_level()]
+		: sel_form_chunk_fns[args->form][simd_get_level()];
+}
+
+void
+sel_cmp_const(col_table_t *t, size_t col, cmp_op_t cmp, val_t val, sel_bitmap_t *bm, sel_combine_t combine) {
+	predicate_t pred = { .kind = PRED_CMP, .cmp = cmp, .val = val };
+	sel_pred(t, col, &pred, bm, combine);
+}
+
+void
+sel_cmp_att(col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b, sel_bitmap_t *bm, sel_combine_t combine) {
+	predicate_t pred = { .kind = PRED_CMP, .cmp = cmp };
+	pred_args_t args;
+	pred_prepare(&pred, &args);
+	sel_eval(t, col_a, col_b, true, &args, sel_cmp_chunk_fns[cmp][SEL_OPERAND_ATT][simd_get_level()], bm, combine);
+}
+
+int
+sel_pred(col_table_t *t, size_t col, const predicate_t *pred, sel_bitmap_t *bm, sel_combine_t combine) {
+	pred_args_t args;
+	if(pred_prepare(pred, &args) != 0) {
+		return -1;
+	}
+	sel_eval(t, col, col, false, &args, pred_chunk_fn(&args), bm, combine);
+	pred_release(&args);
+	return 0;
+}
+
+// Appends the values of in[0:n] whose bits are set to column col of out,
+// starting at row *out_pos of chunk *out_chunk, and advances both.
+static void
+compact_column(const val_t *in, const bit_unit_t *bits, size_t n,
+			   col_table_t *out, size_t col, size_t *out_chunk, size_t *out_pos) {
+	size_t chunk_size = get_chunk_size(out);
+	size_t chunk_no = *out_chunk;
+	size_t pos = *out_pos;
+	val_t *out_data = out->chunks[chunk_no]->columns[col]->data;
+	size_t num_units = bv_num_units(n);
+
+	for(size_t unit = 0; unit < num_units; ++unit) {
+		bit_unit_t word = bits[unit];
+		if(word == 0) {
+			continue;
+		}
+		const val_t *src = in + unit * BV_UNIT_BITS;
+		size_t count = __builtin_popcountl(word);
+		bool full_word = (unit + 1) * BV_UNIT_BITS <= n;
+
+		if(pos + BV_UNIT_BITS <= chunk_size) {
+			// the whole word fits in this output chunk
+			if(count == BV_UNIT_BITS) {
+				memcpy(out_data + pos, src, BV_UNIT_BITS * sizeof(val_t));
+			} else if(count >= SEL_SPARSE_WORD && full_word) {
+				// branch-free: every value is written, and the position only advances past selected ones
+				val_t *dst = out_data + pos;
+				for(size_t i = 0; i < BV_UNIT_BITS; ++i) {
+					*dst = src[i];
+					dst += (word >> i) & 1;
+				}
+			} else {
+				val_t *dst = out_data + pos;
+				while(word) {
+					*dst++ = src[__builtin_ctzl(word)];
+					word &= word - 1;
+				}
+			}
+			pos += count;
+		} else {
+			// the word may cross into the next output chunk
+			while(word) {
+				if(pos == chunk_size) {
+					++chunk_no;
+					pos = 0;
+					out_data = out->chunks[chunk_no]->columns[col]->data;
+				}
+				out_data[pos++] = src[__builtin_ctzl(word)];
+				word &= word - 1;
+			}
+		}
+	}
+
+	*out_chunk = chunk_no;
+	*out_pos = pos;
+}
+
+col_table_t *
+sel_compact(col_table_t *t, sel_bitmap_t *bm) {
+	assert(bm->num_chunks == t->num_chunks);
+	col_table_t *out = create_col_table_empty(sel_bitmap_count(bm), get_chunk_size(t), t->num_cols);
+	MALLOC_CHECK(out, "selection output");
+
+	size_t out_chunk = 0;
+	size_t out_pos = 0;
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		bit_vec_t *bv = &bm->chunks[chunk_no];
+		size_t col_chunk = out_chunk;
+		size_t col_pos = out_pos;
+		// chunk by chunk, so the chunk's bitmap stays in cache for all of its columns
+		for(size_t col = 0; col < t->num_cols; ++col) {
+			col_chunk = out_chunk;
+			col_pos = out_pos;
+			compact_column(t->chunks[chunk_no]->columns[col]->data, bv->data, bv->n_bits,
+						   out, col, &col_chunk, &col_pos);
+		}
+		out_chunk = col_chunk;
+		out_pos = col_pos;
+	}
+	set_zone_maps(out);
+	out->sorted_col = t->sorted_col;
+
+	free_col_table(t);
+	return out;
+}
+
+size_t
+sel_count_chunk(col_table_t *t, size_t chunk_no, size_t col, const pred_args_t *p, bit_vec_t *bv) {
+	bv->n_bits = get_chunk_rows(t, chunk_no);
+	sel_eval_chunk(t, chunk_no, col, col, false, p, pred_chunk_fn(p), bv, SEL_SET);
+	return bv_count(bv);
+}
+
+// appends the count rows of chunk chunk_no of t selected in bv to out, as sel_append_chunk;
+// column col of out is column cols[col] of t, or column col if cols is NULL
+static void
+append_selected_rows(col_table_t *t, size_t chunk_no, bit_vec_t *bv, size_t count, const size_t *cols, col_table_t *out) {
+	size_t chunk_size = get_chunk_size(t);
+	if(count == 0) {
+		return;
+	}
+	while(out->num_chunks * chunk_size < out->num_rows + count) {
+		out->chunks[out->num_chunks] = create_table_chunk(chunk_size, out->num_cols);
+		MALLOC_CHECK_VOID(out->chunks[out->num_chunks], "output chunk");
+		++out->num_chunks;
+	}
+
+	size_t out_chunk = out->num_rows / chunk_size;
+	size_t out_pos = out->num_rows % chunk_size;
+	for(size_t col_no = 0; col_no < out->num_cols; ++col_no) {
+		size_t col_chunk = out_chunk;
+		size_t col_pos = out_pos;
+		size_t in_col = cols ? cols[col_no] : col_no;
+		compact_column(t->chunks[chunk_no]->columns[in_col]->data, bv->data, bv->n_bits, out, col_no, &col_chunk, &col_pos);
+	}
+	out->num_rows += count;
+}
+
+size_t
+sel_append_chunk(col_table_t *t, size_t chunk_no, size_t col, const pred_args_t *p, bit_vec_t *bv, col_table_t *out) {
+	size_t count = sel_count_chunk(t, chunk_no, col, p, bv);
+	append_selected_rows(t, chunk_no, bv, count, NULL, out);
+	return count;
+}
+
+// the first row of t, sorted on col, whose value in col is at least val, or above it if upper
+static size_t
+sorted_bound(col_table_t *t, size_t col, val_t val, bool upper) {
+	size_t chunk_size = get_chunk_size(t);
+	size_t lo = 0;
+	size_t hi = t->num_rows;
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		val_t x = t->chunks[mid / chunk_size]->columns[col]->data[mid % chunk_size];
+		if(upper ? x <= val : x < val) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+// The rows of t where pred holds on col, as [start[0]:stop[0]] followed by [start[1]:stop[1]],
+// if t is sorted on col and pred is a comparison or BETWEEN; false otherwise.
+static bool
+sorted_ranges(col_table_t *t, size_t col, const predicate_t *pred, size_t start[2], size_t stop[2]) {
+	if(t->sorted_col != col) {
+		return false;
+	}
+	start[0] = start[1] = 0;
+	stop[0] = stop[1] = 0;
+	switch(pred->kind) {
+	case PRED_CMP:
+		switch(pred->cmp) {
+		case CMP_EQ:
+			start[0] = sorted_bound(t, col, pred->val, false);
+			stop[0] = sorted_bound(t, col, pred->val, true);
+			break;
+		case CMP_NE:
+			stop[0] = sorted_bound(t, col, pred->val, false);
+			start[1] = sorted_bound(t, col, pred->val, true);
+			stop[1] = t->num_rows;
+			break;
+		case CMP_LT:
+			stop[0] = sorted_bound(t, col, pred->val, false);
+			break;
+		case CMP_LE:
+			stop[0] = sorted_bound(t, col, pred->val, true);
+			break;
+		case CMP_GT:
+			start[0] = sorted_bound(t, col, pred->val, true);
+			stop[0] = t->num_rows;
+			break;
+		case CMP_GE:
+			start[0] = sorted_bound(t, col, pred->val, false);
+			stop[0] = t->num_rows;
+			break;
+		default:
+			return false;
+		}
+		break;
+	case PRED_BETWEEN:
+		start[0] = sorted_bound(t, col, pred->lo, false);
+		stop[0] = MAX(start[0], sorted_bound(t, col, pred->hi, true));
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+col_table_t *
+sorted_selection(col_table_t *t, size_t col, const predicate_t *pred) {
+	size_t start[2], stop[2];
+	if(!sorted_ranges(t, col, pred, start, stop)) {
+		return NULL;
+	}
+	size_t chunk_size = get_chunk_size(t);
+	size_t num_rows = (stop[0] - start[0]) + (stop[1] - start[1]);
+	if(num_rows > 0 && start[1] == stop[1] && start[0] % chunk_size == 0) {
+		// one range from a chunk boundary: t keeps the chunks it spans and drops the rest
+		size_t first_chunk = start[0] / chunk_size;
+		size_t stop_chunk = (stop[0] + chunk_size - 1) / chunk_size;
+		for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+			if(chunk_no < first_chunk || chunk_no >= stop_chunk) {
+				free_table_chunk(t->chunks[chunk_no], t->num_cols);
+			} else {
+				t->chunks[chunk_no - first_chunk] = t->chunks[chunk_no];
+			}
+		}
+		t->num_chunks = stop_chunk - first_chunk;
+		t->num_rows = num_rows;
+		// only the last chunk can have lost rows
+		for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+			size_t n = get_chunk_rows(t, chunk_no);
+			for(size_t c = 0; c < t->num_cols; ++c) {
+				column_chunk_t *column = t->chunks[chunk_no]->columns[c];
+				if(!column->has_zone || chunk_no == t->num_chunks - 1) {
+					set_col_chunk_zone(column, n);
+				}
+			}
+		}
+		return t;
+	}
+	col_table_t *out = create_col_table_empty(num_rows, chunk_size, t->num_cols);
+	MALLOC_CHECK(out, "result");
+	copy_rows(t, start[0], out, 0, stop[0] - start[0]);
+	copy_rows(t, start[1], out, stop[0] - start[0], stop[1] - start[1]);
+	set_zone_maps(out);
+	out->sorted_col = col;
+	free_col_table(t);
+	return out;
+}
+
+col_table_t *
+bitmap_selection_const(col_table_t *t, size_t col, val_t val) {
+	predicate_t eq = { .kind = PRED_CMP, .cmp = CMP_EQ, .val = val };
+	return bitmap_selection_pred(t, col, &eq);
+}
+
+col_table_t *
+bitmap_selection_att(col_table_t *t, size_t col_a, cmp_op_t cmp, size_t col_b) {
+	sel_bitmap_t *bm = sel_bitmap_create(t);
+	MALLOC_CHECK(bm, "bitmap");
+	sel_cmp_att(t, col_a, cmp, col_b, bm, SEL_SET);
+	col_table_t *out = sel_compact(t, bm);
+	sel_bitmap_free(bm);
+	return out;
+}
+
+col_table_t *
+bitmap_selection_pred(col_table_t *t, size_t col, const predicate_t *pred) {
+	col_table_t *sorted = sorted_selection(t, col, pred);
+	if(sorted) {
+		return sorted;
+	}
+	sel_bitmap_t *bm = sel_bitmap_create(t);
+	MALLOC_CHECK(bm, "bitmap");
+	if(sel_pred(t, col, pred, bm, SEL_SET) != 0) {
+		sel_bitmap_free(bm);
+		free_col_table(t);
+		return NULL;
+	}
+	col_table_t *out = sel_compact(t, bm);
+	sel_bitmap_free(bm);
+	return out;
+}
+
+// Morsel-driven parallel selection.
+// Workers claim one input chunk (a morsel) at a time from a shared counter, so fast workers take more of them,
+// and compact its matching rows into output chunks of their own, with no locking.
+// The workers' outputs are then stitched into one table.
+
+// where the matching rows of one morsel went: rows [row:row + num_rows] of its worker's output
+typedef struct {
+	size_t thread_no;
+	size_t row;
+	size_t num_rows;
+} morsel_run_t;
+
+typedef struct {
+	col_table_t *t;
+	size_t col;
+	const pred_args_t *p;
+	size_t next_chunk; // the next morsel to claim
+	morsel_run_t *runs; // one per morsel
+	col_table_t *outs[MAX_THREADS]; // one per worker
+	col_table_t *out; // the stitched result
+} morsel_sel_args_t;
+
+static void
+morsel_select_worker(void *arg, size_t thread_no, __attribute__((unused)) size_t num_threads) {
+	morsel_sel_args_t *args = (morsel_sel_args_t *) arg;
+	col_table_t *t = args->t;
+	size_t chunk_size = get_chunk_size(t);
+
+	// no worker gets more rows than there are in t, so it needs no more chunks than t has
+	col_table_t *out = NEW(col_table_t);
+	MALLOC_CHECK_VOID(out, "worker output");
+	out->num_chunks = 0;
+	out->num_cols = t->num_cols;
+	out->num_rows = 0;
+	out->sorted_col = TABLE_UNSORTED;
+	out->chunks = NEWPA(table_chunk_t, t->num_chunks);
+	MALLOC_CHECK_VOID(out->chunks, "worker output chunks");
+	args->outs[thread_no] = out;
+
+	bit_vec_t bv;
+	bv_init(&bv, chunk_size);
+	MALLOC_CHECK_VOID(bv.data, "morsel bitmap");
+
+	size_t chunk_no;
+	while((chunk_no = __sync_fetch_and_add(&args->next_chunk, 1)) < t->num_chunks) {
+		args->runs[chunk_no].thread_no = thread_no;
+		args->runs[chunk_no].row = out->num_rows;
+		args->runs[chunk_no].num_rows = sel_append_chunk(t, chunk_no, args->col, args->p, &bv, out);
+	}
+	bv_free(&bv);
+}
+
+// copies the runs of a contiguous range of morsels to their place in the result, in morsel order
+static void
+morsel_ordered_stitch_worker(void *arg, size_t thread_no, size_t num_threads) {
+	morsel_sel_args_t *args = (morsel_sel_args_t *) arg;
+	size_t start, stop;
+	par_range(args->t->num_chunks, thread_no, num_threads, &start, &stop);
+
+	size_t out_row = 0;
+	for(size_t chunk_no = 0; chunk_no < start; ++chunk_no) {
+		out_row += args->runs[chunk_no].num_rows;
+	}
+	for(size_t chunk_no = start; chunk_no < stop; ++chunk_no) {
+		morsel_run_t *run = &args->runs[chunk_no];
+		copy_rows(args->outs[run->thread_no], run->row, args->out, out_row, run->num_rows);
+		out_row += run->num_rows;
+	}
+}
+
+static void
+morsel_zone_worker(void *arg, size_t thread_no, size_t num_threads) {
+	col_table_t *out = ((morsel_sel_args_t *) arg)->out;
+	size_t start, stop;
+	par_range(out->num_chunks, thread_no, num_threads, &start, &stop);
+	for(size_t chunk_no = start; chunk_no < stop; ++chunk_no) {
+		size_t n = get_chunk_rows(out, chunk_no);
+		for(size_t col = 0; col < out->num_cols; ++col) {
+			set_col_chunk_zone(out->chunks[chunk_no]->columns[col], n);
+		}
+	}
+}
+
+// Unordered: every worker's full chunks are moved into the result as they are,
+// and only the partly used last chunks are copied, into the result's last chunks.
+static void
+morsel_unordered_stitch(morsel_sel_args_t *args, size_t num_threads) {
+	col_table_t *out = args->out;
+	size_t chunk_size = get_chunk_size(args->t);
+	size_t out_chunk = 0;
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		col_table_t *worker_out = args->outs[thread_no];
+		size_t full_chunks = worker_out->num_rows / chunk_size;
+		for(size_t chunk_no = 0; chunk_no < full_chunks; ++chunk_no) {
+			out->chunks[out_chunk++] = worker_out->chunks[chunk_no];
+		}
+	}
+	for(size_t chunk_no = out_chunk; chunk_no < out->num_chunks; ++chunk_no) {
+		out->chunks[chunk_no] = create_table_chunk(chunk_size, out->num_cols);
+		MALLOC_CHECK_VOID(out->chunks[chunk_no], "result chunk");
+	}
+	size_t out_row = out_chunk * chunk_size;
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		col_table_t *worker_out = args->outs[thread_no];
+		size_t full_rows = worker_out->num_rows / chunk_size * chunk_size;
+		copy_rows(worker_out, full_rows, out, out_row, worker_out->num_rows - full_rows);
+		out_row += worker_out->num_rows - full_rows;
+	}
+}
+
+col_table_t *
+morsel_selection_pred(col_table_t *t, size_t col, const predicate_t *pred, size_t num_threads, bool keep_order) {
+	col_table_t *sorted = sorted_selection(t, col, pred);
+	if(sorted) {
+		return sorted;
+	}
+	num_threads = MAX(1, MIN(num_threads, MAX_THREADS));
+	size_t chunk_size = get_chunk_size(t);
+	pred_args_t p;
+	if(pred_prepare(pred, &p) != 0) {
+		free_col_table(t);
+		return NULL;
+	}
+
+	morsel_sel_args_t args;
+	args.t = t;
+	args.col = col;
+	args.p = &p;
+	args.next_chunk = 0;
+	args.runs = NEWA(morsel_run_t, t->num_chunks);
+	MALLOC_CHECK(args.runs, "morsel runs");
+	par_run(num_threads, morsel_select_worker, &args);
+
+	size_t num_rows = 0;
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		num_rows += args.outs[thread_no]->num_rows;
+	}
+	if(keep_order) {
+		args.out = create_col_table_empty(num_rows, chunk_size, t->num_cols);
+		MALLOC_CHECK(args.out, "result");
+		par_run(num_threads, morsel_ordered_stitch_worker, &args);
+	} else {
+		args.out = NEW(col_table_t);
+		MALLOC_CHECK(args.out, "result");
+		args.out->num_chunks = MAX(1, (num_rows + chunk_size - 1) / chunk_size);
+		args.out->num_cols = t->num_cols;
+		args.out->num_rows = num_rows;
+		args.out->sorted_col = TABLE_UNSORTED;
+		args.out->chunks = NEWPA(table_chunk_t, args.out->num_chunks);
+		MALLOC_CHECK(args.out->chunks, "result chunks array");
+		morsel_unordered_stitch(&args, num_threads);
+	}
+	par_run(num_threads, morsel_zone_worker, &args);
+	args.out->sorted_col = keep_order ? t->sorted_col : TABLE_UNSORTED;
+
+	for(size_t thread_no = 0; thread_no < num_threads; ++thread_no) {
+		col_table_t *worker_out = args.outs[thread_no];
+		// without order, the full chunks are in the result now
+		size_t moved_chunks = keep_order ? 0 : worker_out->num_rows / chunk_size;
+		for(size_t chunk_no = moved_chunks; chunk_no < worker_out->num_chunks; ++chunk_no) {
+			free_table_chunk(worker_out->chunks[chunk_no], worker_out->num_cols);
+		}
+		my_free(worker_out->chunks);
+		my_free(worker_out);
+	}
+	my_free(args.runs);
+	pred_release(&p);
+	free_col_table(t);
+	return args.out;
+}
+
+col_table_t *
+parallel_selection_pred(col_table_t *t, size_t col, const predicate_t *pred) {
+	return morsel_selection_pred(t, col, pred, par_threads, true);
+}
+
+// Filters.
+// Each node of the expression keeps statistics on how many of the rows it was evaluated on it passed,
+// and on the cycles that took. An AND evaluates its children cheapest per rejected row first,
+// and an OR cheapest per accepted row first, and both stop at the first child that settles the whole chunk.
+// The children are reordered every FILTER_REORDER_CHUNKS chunks, when the statistics are also halved,
+// so they follow the data as it changes along the table.
+// A child that has not been evaluated yet goes first, so it gets its statistics.
+#define FILTER_REORDER_CHUNKS 8
+
+typedef struct filter_node {
+	const filter_expr_t *expr;
+	pred_args_t args; // FILTER_PRED
+	struct filter_node *children;
+	size_t *order;    // the children in the order they are evaluated
+	size_t num_children;
+	size_t depth;
+	uint64_t cycles;
+	uint64_t rows;
+	uint64_t passed;
+} filter_node_t;
+
+// Prepares node for expr and its subtree; returns the deepest level that needs a bitmap, or -1 on failure.
+// Whatever was prepared before a failure is left for filter_release.
+static int
+filter_prepare(const filter_expr_t *expr, size_t depth, filter_node_t *node) {
+	node->expr = expr;
+	node->args.lookup.data = NULL;
+	node->children = NULL;
+	node->order = NULL;
+	node->num_children = 0;
+	node->depth = depth;
+	node->cycles = 0;
+	node->rows = 0;
+	node->passed = 0;
+	if(expr->kind == FILTER_PRED) {
+		if(pred_prepare(&expr->pred, &node->args) != 0) {
+			node->args.lookup.data = NULL;
+			return -1;
+		}
+		return (int) depth;
+	}
+
+	node->children = NEWA(filter_node_t, expr->num_children);
+	node->order = NEWA(size_t, expr->num_children);
+	if(expr->num_children > 0 && (!node->children || !node->order)) {
+		ERROR("Could not allocate the filter nodes\n");
+		return -1;
+	}
+	// the children's results go into the bitmap of the next level, even if there are none
+	int max_depth = (int) depth + 1;
+	for(size_t child = 0; child < expr->num_children; ++child) {
+		node->order[child] = child;
+		int child_depth = filter_prepare(&expr->children[child], depth + 1, &node->children[child]);
+		++node->num_children;
+		if(child_depth < 0) {
+			return -1;
+		}
+		max_depth = MAX(max_depth, child_depth);
+	}
+	return max_depth;
+}
+
+static void
+filter_release(filter_node_t *node) {
+	if(node->expr->kind == FILTER_PRED) {
+		pred_release(&node->args);
+		return;
+	}
+	for(size_t child = 0; child < node->num_children; ++child) {
+		filter_release(&node->children[child]);
+	}
+	my_free(node->children);
+	my_free(node->order);
+}
+
+// cycles per row decided: rejected by a child of an AND, accepted by a child of an OR
+static inline __attribute__((always_inline)) uint64_t
+filter_rank(const filter_node_t *child, bool and) {
+	if(child->rows == 0) {
+		return 0;
+	}
+	uint64_t decided = and ? child->rows - child->passed : child->passed;
+	return child->cycles / (decided + 1);
+}
+
+// reorders the children of node and those below it by rank and halves their statistics
+static void
+filter_reorder(filter_node_t *node) {
+	bool and = node->expr->kind == FILTER_AND;
+	// insertion sort, since there are few children
+	for(size_t i = 1; i < node->num_children; ++i) {
+		for(size_t j = i; j > 0; --j) {
+			size_t *a = &node->order[j - 1];
+			size_t *b = &node->order[j];
+			if(filter_rank(&node->children[*a], and) <= filter_rank(&node->children[*b], and)) {
+				break;
+			}
+			size_t tmp;
+			SWAP(*a, *b, tmp);
+		}
+	}
+	for(size_t child = 0; child < node->num_children; ++child) {
+		filter_node_t *c = &node->children[child];
+		c->cycles /= 2;
+		c->rows /= 2;
+		c->passed /= 2;
+		if(c->expr->kind != FILTER_PRED) {
+			filter_reorder(c);
+		}
+	}
+}
+
+// Evaluates node on chunk chunk_no of t into bv, with n_bits set to the rows of the chunk;
+// scratch[depth] for depth below node's is free to use, and has chunk_size bits each.
+// Returns the number of rows that pass.
+static size_t
+filter_eval_chunk(filter_node_t *node, col_table_t *t, size_t chunk_no, bit_vec_t *bv, bit_vec_t *scratch) {
+	const filter_expr_t *expr = node->expr;
+	if(expr->kind == FILTER_PRED) {
+		sel_eval_chunk(t, chunk_no, expr->col, expr->col, false, &node->args, pred_chunk_fn(&node->args), bv, SEL_SET);
+		return bv_count(bv);
+	}
+
+	bool and = expr->kind == FILTER_AND;
+	// no children: every row passes an AND and none an OR
+	sel_fill_chunk(bv, and, SEL_SET);
+	size_t count = and ? bv->n_bits : 0;
+	bit_vec_t *child_bv = &scratch[node->depth + 1];
+	child_bv->n_bits = bv->n_bits;
+	for(size_t i = 0; i < node->num_children; ++i) {
+		filter_node_t *child = &node->children[node->order[i]];
+		// the first child goes straight into bv
+		bit_vec_t *dst = i == 0 ? bv : child_bv;
+		uint64_t start, end;
+		rdtscll(start);
+		size_t child_count = filter_eval_chunk(child, t, chunk_no, dst, scratch);
+		rdtscll(end);
+		child->cycles += end - start;
+		child->rows += bv->n_bits;
+		child->passed += child_count;
+
+		if(i == 0) {
+			count = child_count;
+		} else {
+			if(and) {
+				bv_and(bv, child_bv);
+			} else {
+				bv_or(bv, child_bv);
+			}
+			count = bv_count(bv);
+		}
+		if(and ? count == 0 : count == bv->n_bits) {
+			break;
+		}
+	}
+	return count;
+}
+
+col_table_t *
+filter(col_table_t *t, const filter_expr_t *expr) {
+	size_t chunk_size = get_chunk_size(t);
+	filter_node_t root;
+	int max_depth = filter_prepare(expr, 0, &root);
+	if(max_depth < 0) {
+		filter_release(&root);
+		free_col_table(t);
+		return NULL;
+	}
+
+	// one bitmap for the result of each level
+	bit_vec_t *bvs = NEWA(bit_vec_t, max_depth + 1);
+	MALLOC_CHECK(bvs, "filter bitmaps");
+	for(int depth = 0; depth <= max_depth; ++depth) {
+		bv_init(&bvs[depth], chunk_size);
+		MALLOC_CHECK(bvs[depth].data, "filter bitmap");
+	}
+
+	col_table_t *out = NEW(col_table_t);
+	MALLOC_CHECK(out, "result");
+	out->num_cols = t->num_cols;
+	out->num_rows = 0;
+	out->num_chunks = 0;
+	out->sorted_col = t->sorted_col;
+	out->chunks = NEWPA(table_chunk_t, t->num_chunks);
+	MALLOC_CHECK(out->chunks, "result chunks array");
+
+	for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+		if(chunk_no % FILTER_REORDER_CHUNKS == 1 && root.expr->kind != FILTER_PRED) {
+			// after the first chunk, and every FILTER_REORDER_CHUNKS after that
+			filter_reorder(&root);
+		}
+		bvs[0].n_bits = get_chunk_rows(t, chunk_no);
+		size_t count = filter_eval_chunk(&root, t, chunk_no, &bvs[0], bvs);
+		append_selected_rows(t, chunk_no, &bvs[0], count, NULL, out);
+	}
+	if(out->num_chunks == 0) {
+		out->chunks[out->num_chunks++] = create_table_chunk(chunk_size, out->num_cols);
+		MALLOC_CHECK(out->chunks[0], "result chunk");
+	}
+	set_zone_maps(out);
+
+	for(int depth = 0; depth <= max_depth; ++depth) {
+		bv_free(&bvs[depth]);
+	}
+	my_free(bvs);
+	filter_release(&root);
+	free_col_table(t);
+	return out;
+}
+
+col_table_t *
+bitmap_select_project(col_table_t *t, size_t col, const predicate_t *pred, size_t *pos, size_t num_proj) {
+	bool identity = num_proj == t->num_cols;
+	for(size_t j = 0; j < num_proj && identity; ++j) {
+		identity = pos[j] == j;
+	}
+	if(identity) {
+		// nothing to leave out, so the default selection's own strategy choice applies
+		return default_impls[SELECTION_PRED](t, col, pred);
+	}
+	size_t chunk_size = get_chunk_size(t);
+	col_table_t *out;
+	size_t start[2], stop[2];
+	if(sorted_ranges(t, col, pred, start, stop)) {
+		out = create_col_table_empty((stop[0] - start[0]) + (stop[1] - start[1]), chunk_size, num_proj);
+		MALLOC_CHECK(out, "result");
+		copy_cols(t, pos, num_proj, start[0], out, 0, stop[0] - start[0]);
+		copy_cols(t, pos, num_proj, start[1], out, stop[0] - start[0], stop[1] - start[1]);
+	} else {
+		pred_args_t p;
+		if(pred_prepare(pred, &p) != 0) {
+			free_col_table(t);
+			return NULL;
+		}
+		bit_vec_t bv;
+		bv_init(&bv, chunk_size);
+		MALLOC_CHECK(bv.data, "selection bitmap");
+
+		out = NEW(col_table_t);
+		MALLOC_CHECK(out, "result");
+		out->num_cols = num_proj;
+		out->num_rows = 0;
+		out->num_chunks = 0;
+		out->chunks = NEWPA(table_chunk_t, t->num_chunks);
+		MALLOC_CHECK(out->chunks, "result chunks array");
+
+		// the chunk's bitmap stays in cache while its projected columns are compacted
+		for(size_t chunk_no = 0; chunk_no < t->num_chunks; ++chunk_no) {
+			size_t count = sel_count_chunk(t, chunk_no, col, &p, &bv);
+			append_selected_rows(t, chunk_no, &bv, count, pos, out);
+		}
+		if(out->num_chunks == 0) {
+			out->chunks[out->num_chunks++] = create_table_chunk(chunk_size, out->num_cols);
+			MALLOC_CHECK(out->chunks[0], "result chunk");
+		}
+		bv_free(&bv);
+		pred_release(&p);
+	}
+	set_zone_maps(out);
+	out->sorted_col = projected_sorted_col(t->sorted_col, pos, num_proj);
+	free_col_table(t);
+	return out;
+}
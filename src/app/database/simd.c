@@ -0,0 +1,245 @@
+#ifdef __NAUTILUS__
+	#include <nautilus/libccompat.h>
+#else
+	#include <stdbool.h>
+	#include <string.h>
+#endif
+
+#include "app/database/common.h"
+#include "app/database/simd.h"
+
+#ifdef DB_SIMD
+	#include <immintrin.h>
+#endif
+
+char *simd_level_names[] = {
+	"scalar",
+	"sse4.2",
+	"avx2",
+};
+
+static merge_pairs_fn_t merge_pairs_kernels[NUM_SIMD_LEVELS] = {
+	merge_pairs_scalar,
+#ifdef DB_SIMD
+	merge_pairs_sse42,
+	merge_pairs_avx2,
+#else
+	NULL,
+	NULL,
+#endif
+};
+
+// negative until the first merge_pairs() or simd_set_level()
+static int simd_level = -1;
+static merge_pairs_fn_t merge_pairs_kernel = merge_pairs_scalar;
+
+simd_level_t
+simd_detect() {
+	#ifdef DB_SIMD
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")) {
+			return SIMD_AVX2;
+		}
+		if(__builtin_cpu_supports("sse4.2")) {
+			return SIMD_SSE42;
+		}
+	#endif
+	return SIMD_NONE;
+}
+
+void
+simd_set_level(simd_level_t level) {
+	level = MIN(level, simd_detect());
+	merge_pairs_kernel = merge_pairs_kernels[level];
+	simd_level = level;
+}
+
+simd_level_t
+simd_get_level() {
+	if(simd_level < 0) {
+		simd_set_level(simd_detect());
+	}
+	return (simd_level_t) simd_level;
+}
+
+void
+merge_pairs(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out) {
+	if(simd_level < 0) {
+		simd_set_level(simd_detect());
+	}
+	merge_pairs_kernel(a, na, b, nb, out);
+}
+
+void
+merge_pairs_scalar(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out) {
+	const sort_pair_t *a_stop = a + na;
+	const sort_pair_t *b_stop = b + nb;
+	while(a < a_stop && b < b_stop) {
+		// branch-free: which run wins is data-dependent and unpredictable
+		sort_pair_t a_val = *a;
+		sort_pair_t b_val = *b;
+		bool take_b = b_val < a_val;
+		*out++ = take_b ? b_val : a_val;
+		a += !take_b;
+		b +=  take_b;
+	}
+	memmove(out, a, (a_stop - a) * sizeof(sort_pair_t));
+	out += a_stop - a;
+	memmove(out, b, (b_stop - b) * sizeof(sort_pair_t));
+}
+
+#ifdef DB_SIMD
+
+// Finishes a vector merge: buf[0:n_buf] is the sorted upper half left in the last register,
+// and the rest of a and b are shorter than one register.
+static void
+merge_pairs_tail(const sort_pair_t *buf, size_t n_buf,
+				 const sort_pair_t *a, const sort_pair_t *a_stop,
+				 const sort_pair_t *b, const sort_pair_t *b_stop,
+				 sort_pair_t *out) {
+	const sort_pair_t *buf_stop = buf + n_buf;
+	while(buf < buf_stop) {
+		// pairs are distinct, so there are no ties to break
+		if(a < a_stop && *a < *buf && (b == b_stop || *a < *b)) {
+			*out++ = *a++;
+		} else if(b < b_stop && *b < *buf) {
+			*out++ = *b++;
+		} else {
+			*out++ = *buf++;
+		}
+	}
+	merge_pairs_scalar(a, a_stop - a, b, b_stop - b, out);
+}
+
+// There is no unsigned 64-bit compare before AVX-512,
+// so both sides are biased into the signed range first.
+#define SIMD_SIGN_BIAS ((long long) 0x8000000000000000ULL)
+
+static inline __attribute__((always_inline, target("sse4.2"))) void
+minmax_sse42(__m128i x, __m128i y, __m128i *min, __m128i *max) {
+	const __m128i bias = _mm_set1_epi64x(SIMD_SIGN_BIAS);
+	__m128i x_gt_y = _mm_cmpgt_epi64(_mm_xor_si128(x, bias), _mm_xor_si128(y, bias));
+	*min = _mm_blendv_epi8(x, y, x_gt_y);
+	*max = _mm_blendv_epi8(y, x, x_gt_y);
+}
+
+// Bitonic merge network of two sorted registers: lo gets the 2 smallest pairs, hi the 2 largest.
+static inline __attribute__((always_inline, target("sse4.2"))) void
+bitonic_merge_sse42(__m128i *lo, __m128i *hi) {
+	__m128i min, max;
+	// reversing lo makes lo:hi bitonic; lo is the freshly loaded register,
+	// so the shuffle stays off the dependency chain through hi
+	minmax_sse42(_mm_shuffle_epi32(*lo, _MM_SHUFFLE(1, 0, 3, 2)), *hi, &min, &max);
+
+	__m128i l_min, l_max, h_min, h_max;
+	minmax_sse42(min, _mm_shuffle_epi32(min, _MM_SHUFFLE(1, 0, 3, 2)), &l_min, &l_max);
+	minmax_sse42(max, _mm_shuffle_epi32(max, _MM_SHUFFLE(1, 0, 3, 2)), &h_min, &h_max);
+	*lo = _mm_blend_epi16(l_min, l_max, 0xF0);
+	*hi = _mm_blend_epi16(h_min, h_max, 0xF0);
+}
+
+__attribute__((target("sse4.2"))) void
+merge_pairs_sse42(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out) {
+	const size_t width = 2;
+	if(na < width || nb < width) {
+		merge_pairs_scalar(a, na, b, nb, out);
+		return;
+	}
+	const sort_pair_t *a_stop = a + na;
+	const sort_pair_t *b_stop = b + nb;
+
+	__m128i lo = _mm_loadu_si128((const __m128i *) a);
+	__m128i hi = _mm_loadu_si128((const __m128i *) b);
+	a += width;
+	b += width;
+	bitonic_merge_sse42(&lo, &hi);
+	_mm_storeu_si128((__m128i *) out, lo);
+	out += width;
+
+	while(a + width <= a_stop && b + width <= b_stop) {
+		// hi is merged with the next register from the run whose head is smaller
+		bool take_b = *b < *a;
+		const sort_pair_t *next = take_b ? b : a;
+		a += take_b ? 0 : width;
+		b += take_b ? width : 0;
+		lo = _mm_loadu_si128((const __m128i *) next);
+		bitonic_merge_sse42(&lo, &hi);
+		_mm_storeu_si128((__m128i *) out, lo);
+		out += width;
+	}
+
+	sort_pair_t buf[2];
+	_mm_storeu_si128((__m128i *) buf, hi);
+	merge_pairs_tail(buf, width, a, a_stop, b, b_stop, out);
+}
+
+static inline __attribute__((always_inline, target("avx2"))) void
+minmax_avx2(__m256i x, __m256i y, __m256i *min, __m256i *max) {
+	const __m256i bias = _mm256_set1_epi64x(SIMD_SIGN_BIAS);
+	__m256i x_gt_y = _mm256_cmpgt_epi64(_mm256_xor_si256(x, bias), _mm256_xor_si256(y, bias));
+	*min = _mm256_blendv_epi8(x, y, x_gt_y);
+	*max = _mm256_blendv_epi8(y, x, x_gt_y);
+}
+
+// one level of the bitonic cleanup within a register: lane i is compared to lane i ^ distance,
+// which permuted holds
+#define BITONIC_LEVEL_AVX2(reg, permuted, blend) do { \
+	__m256i level_min, level_max; \
+	minmax_avx2((reg), (permuted), &level_min, &level_max); \
+	(reg) = _mm256_blend_epi32(level_min, level_max, (blend)); \
+} while(0)
+
+// Bitonic merge network of two sorted registers: lo gets the 4 smallest pairs, hi the 4 largest.
+static inline __attribute__((always_inline, target("avx2"))) void
+bitonic_merge_avx2(__m256i *lo, __m256i *hi) {
+	__m256i min, max;
+	// reversing lo makes lo:hi bitonic; lo is the freshly loaded register,
+	// so the permute stays off the dependency chain through hi
+	minmax_avx2(_mm256_permute4x64_epi64(*lo, _MM_SHUFFLE(0, 1, 2, 3)), *hi, &min, &max);
+
+	// distance 2 (swap the 128-bit halves): lanes 2, 3 take the max
+	BITONIC_LEVEL_AVX2(min, _mm256_permute2x128_si256(min, min, 1), 0xF0);
+	BITONIC_LEVEL_AVX2(max, _mm256_permute2x128_si256(max, max, 1), 0xF0);
+	// distance 1 (in-lane, so cheaper than a cross-lane permute): lanes 1, 3 take the max
+	BITONIC_LEVEL_AVX2(min, _mm256_shuffle_epi32(min, _MM_SHUFFLE(1, 0, 3, 2)), 0xCC);
+	BITONIC_LEVEL_AVX2(max, _mm256_shuffle_epi32(max, _MM_SHUFFLE(1, 0, 3, 2)), 0xCC);
+	*lo = min;
+	*hi = max;
+}
+
+__attribute__((target("avx2"))) void
+merge_pairs_avx2(const sort_pair_t *a, size_t na, const sort_pair_t *b, size_t nb, sort_pair_t *out) {
+	const size_t width = 4;
+	if(na < width || nb < width) {
+		merge_pairs_scalar(a, na, b, nb, out);
+		return;
+	}
+	const sort_pair_t *a_stop = a + na;
+	const sort_pair_t *b_stop = b + nb;
+
+	__m256i lo = _mm256_loadu_si256((const __m256i *) a);
+	__m256i hi = _mm256_loadu_si256((const __m256i *) b);
+	a += width;
+	b += width;
+	bitonic_merge_avx2(&lo, &hi);
+	_mm256_storeu_si256((__m256i *) out, lo);
+	out += width;
+
+	while(a + width <= a_stop && b + width <= b_stop) {
+		// hi is merged with the next register from the run whose head is smaller
+		bool take_b = *b < *a;
+		const sort_pair_t *next = take_b ? b : a;
+		a += take_b ? 0 : width;
+		b += take_b ? width : 0;
+		lo = _mm256_loadu_si256((const __m256i *) next);
+		bitonic_merge_avx2(&lo, &hi);
+		_mm256_storeu_si256((__m256i *) out, lo);
+		out += width;
+	}
+
+	sort_pair_t buf[4];
+	_mm256_storeu_si256((__m256i *) buf, hi);
+	merge_pairs_tail(buf, width, a, a_stop, b, b_stop, out);
+}
+
+#endif
@@ -14,6 +14,14 @@ void test() {
 	test_array();
 	test_deep_array();
 	test_db();
+	test_sort_threads();
+	test_sort();
+	test_selection();
+	test_selection_threads();
+	test_join();
+	test_group_by();
+	test_reduce();
+	test_distinct();
 }
 
 #ifdef __NAUTILUS__
@@ -10,11 +10,14 @@ void timer_initialize(timer_data_t* obj) {
 	timer_initialize_specific(obj);
 }
 
-void timer_print(timer_data_t* obj) {
+uint64_t timer_elapsed(timer_data_t* obj) {
 	uint64_t start_cycles = ((uint64_t)obj->start_hi << 32) | obj->start_lo;
 	uint64_t stop_cycles = ((uint64_t)obj->stop_hi << 32) | obj->stop_lo;
-	uint64_t elapsed_cycles = stop_cycles - start_cycles;
-	printf("%lu,", elapsed_cycles);
+	return stop_cycles - start_cycles;
+}
+
+void timer_print(timer_data_t* obj) {
+	printf("%lu,", timer_elapsed(obj));
 	for(unsigned int i = 0; i < PERF_EVENTS_SPECIFIC; ++i) {
 		uint64_t diff = obj->perf_event_stop[i] - obj->perf_event_start[i];
 		printf("%lu,", diff);
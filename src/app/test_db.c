@@ -3,6 +3,7 @@
 #else
 	#include <assert.h>
 	#include <stdbool.h>
+	#include <string.h>
 #endif
 
 #include "app/perf.h"
@@ -11,6 +12,12 @@
 #include "app/database/operators.h"
 #include "app/database/my_malloc.h"
 #include "app/database/rand.h"
+#include "app/database/parallel.h"
+#include "app/database/simd.h"
+#include "app/database/extsort.h"
+#include "app/database/selection.h"
+#include "app/database/join.h"
+#include "app/database/aggregate.h"
 
 typedef unsigned long ulong;
 
@@ -23,6 +30,9 @@ typedef unsigned long ulong;
 	#define domain_size 100
 	#define REPS       1
 	#define RAND_SEED 30145440
+	#define log_sort_chunk_size 10
+	#define log_sort_num_cols 2
+	#define log_num_threads_max 3
 #else
 	#define log_num_chunks 8
 	#define log_num_cols_min 1
@@ -32,6 +42,9 @@ typedef unsigned long ulong;
 	#define domain_size 100
 	#define REPS       5
 	#define RAND_SEED 0
+	#define log_sort_chunk_size 12
+	#define log_sort_num_cols 3
+	#define log_num_threads_max 5
 #endif
 
 #define LOG_SIZEOF_VAL_T 2
@@ -165,6 +178,1818 @@ void test_db() {
 	timer_finalize(&timer);
 }
 
+// true iff the first num_rows rows of a and b are equal
+static bool same_first_rows(col_table_t *a, col_table_t *b, size_t num_rows) {
+	size_t a_chunk_size = get_chunk_size(a);
+	size_t b_chunk_size = get_chunk_size(b);
+	for(size_t row = 0; row < num_rows; ++row) {
+		for(size_t col = 0; col < a->num_cols; ++col) {
+			if(a->chunks[row / a_chunk_size]->columns[col]->data[row % a_chunk_size] !=
+			   b->chunks[row / b_chunk_size]->columns[col]->data[row % b_chunk_size]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// swaps rows a and b in every column
+static void swap_rows(col_table_t *t, size_t a, size_t b) {
+	size_t chunk_size = get_chunk_size(t);
+	t->sorted_col = TABLE_UNSORTED;
+	for(size_t col = 0; col < t->num_cols; ++col) {
+		val_t *a_val = &t->chunks[a / chunk_size]->columns[col]->data[a % chunk_size];
+		val_t *b_val = &t->chunks[b / chunk_size]->columns[col]->data[b % chunk_size];
+		val_t tmp;
+		SWAP(*a_val, *b_val, tmp);
+	}
+}
+
+typedef enum {
+	ORDER_RANDOM = 0,
+	ORDER_SORTED,
+	ORDER_REVERSED,
+	ORDER_NEARLY_SORTED,
+	NUM_ORDERS
+} input_order_t;
+
+// a table whose sort_col is in the given order
+static col_table_t *create_ordered_table(size_t num_chunks, size_t chunk_size, size_t num_cols, size_t sort_col, input_order_t order) {
+	col_table_t *table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+	if(order == ORDER_RANDOM) {
+		return table;
+	}
+	table = radixsort(table, sort_col, domain_size);
+	size_t num_rows = table->num_rows;
+	if(order == ORDER_REVERSED) {
+		for(size_t row = 0; row < num_rows / 2; ++row) {
+			swap_rows(table, row, num_rows - 1 - row);
+		}
+	} else if(order == ORDER_NEARLY_SORTED) {
+		// 1% of the rows are moved
+		for(size_t swap = 0; swap < num_rows / 200; ++swap) {
+			swap_rows(table, rand_next(num_rows), rand_next(num_rows));
+		}
+	}
+	set_zone_maps(table);
+	return table;
+}
+
+void test_sort_threads() {
+	ulong num_chunks = 1 << log_num_chunks;
+	ulong chunk_size = 1 << log_sort_chunk_size;
+	ulong num_cols = 1 << log_sort_num_cols;
+	ulong sort_col = num_cols / 2;
+	ulong total_size = 1 << (log_num_chunks + log_sort_chunk_size + log_sort_num_cols + LOG_SIZEOF_VAL_T);
+	rand_seed(RAND_SEED);
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	printf("file: $parent_sort_threads_%lu_chunk.csv {\n", num_chunks);
+	printf("x threads,");
+	timer_print_header("sort (parallel countingmergesort)");
+	printf("\n");
+
+	for(ulong log_num_threads = 0; log_num_threads < log_num_threads_max; ++log_num_threads) {
+		ulong num_threads = 1 << log_num_threads;
+		par_set_threads(num_threads);
+
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			// the parallel sort needs one offset array per thread
+			ulong offset_arrays_size = num_threads * chunk_size * domain_size * sizeof(size_t);
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + offset_arrays_size + TOTAL_SIZE_EXTRA);
+
+			printf("%lu,", num_threads);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			col_table_t* table_copy = copy_col_table(table);
+
+			timer_start(&timer);
+			table_copy = parallelcountingmergesort(table_copy, sort_col, domain_size);
+			timer_stop_print(&timer);
+			if(!check_sorted(table_copy, sort_col, domain_size, table)) {
+				printf("table_copy not sorted;\n");
+				exit(1);
+			}
+
+			printf("\n");
+
+			free_col_table(table);
+			free_col_table(table_copy);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+	par_set_threads(1);
+	timer_finalize(&timer);
+}
+
+// tables' worth of arena used by one sort of the sort benchmark
+#define SORT_BENCH_TABLES 3
+
+void test_sort() {
+	ulong num_chunks = 1 << log_num_chunks;
+	ulong chunk_size = 1 << log_sort_chunk_size;
+	ulong num_cols = 1 << log_sort_num_cols;
+	ulong sort_col = num_cols / 2;
+	ulong total_size = 1 << (log_num_chunks + log_sort_chunk_size + log_sort_num_cols + LOG_SIZEOF_VAL_T);
+	op_implementation_info_t *sorts = &impl_infos[SORT];
+	rand_seed(RAND_SEED);
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	// every registered sort on the same input
+	printf("file: $parent_sort_%lu_chunk.csv {\n", num_chunks);
+	printf("x log chunk size,");
+	for(ulong impl = 0; impl < sorts->num_impls; ++impl) {
+		if(sorts->implementations[impl]) {
+			timer_print_header(sorts->names[impl]);
+		}
+	}
+	printf("\n");
+
+	for(ulong reps = 0; reps < REPS; ++reps) {
+		// nothing is freed until the next rep, so every sort needs room for its copy, its output and its scratch
+		my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + sorts->num_impls * SORT_BENCH_TABLES * total_size
+		               + chunk_size * domain_size * sizeof(size_t) * MAX_THREADS + TOTAL_SIZE_EXTRA);
+		col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+		printf("%u,", log_sort_chunk_size);
+
+		for(ulong impl = 0; impl < sorts->num_impls; ++impl) {
+			if(sorts->implementations[impl]) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = sorts->implementations[impl](table_copy, sort_col, domain_size);
+				timer_stop_print(&timer);
+				if(!check_sorted(table_copy, sort_col, domain_size, table)) {
+					printf("%s: table_copy not sorted;\n", sorts->names[impl]);
+					exit(1);
+				}
+				free_col_table(table_copy);
+			}
+		}
+		printf("\n");
+
+		free_col_table(table);
+		my_malloc_deinit();
+	}
+	printf("}\n");
+
+	// the pair merge kernel of latecountingmergesort at every vector level this machine supports
+	simd_level_t best_simd_level = simd_detect();
+	printf("file: $parent_sort_simd_%lu_chunk.csv {\n", num_chunks);
+	printf("x log chunk size,");
+	for(ulong level = 0; level <= best_simd_level; ++level) {
+		timer_print_header(simd_level_names[level]);
+	}
+	printf("\n");
+
+	for(ulong reps = 0; reps < REPS; ++reps) {
+		// as above, every level needs room for its copy, its output and its scratch
+		my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + (best_simd_level + 1) * SORT_BENCH_TABLES * total_size
+		               + chunk_size * domain_size * sizeof(size_t) * MAX_THREADS + TOTAL_SIZE_EXTRA);
+		col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+		printf("%u,", log_sort_chunk_size);
+
+		for(ulong level = 0; level <= best_simd_level; ++level) {
+			simd_set_level(level);
+			col_table_t* table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = latecountingmergesort(table_copy, sort_col, domain_size);
+			timer_stop_print(&timer);
+			if(!check_sorted(table_copy, sort_col, domain_size, table)) {
+				printf("%s: table_copy not sorted;\n", simd_level_names[level]);
+				exit(1);
+			}
+			free_col_table(table_copy);
+		}
+		printf("\n");
+
+		free_col_table(table);
+		my_malloc_deinit();
+	}
+	printf("}\n");
+	simd_set_level(best_simd_level);
+
+	// ORDER BY on a growing number of keys, alternating ASC and DESC
+	printf("file: $parent_sort_multikey_%lu_chunk.csv {\n", num_chunks);
+	printf("x num keys,");
+	timer_print_header("multikeysort");
+	printf("\n");
+	for(ulong num_keys = 1; num_keys <= num_cols; ++num_keys) {
+		sort_key_t keys[num_keys];
+		for(ulong key = 0; key < num_keys; ++key) {
+			keys[key].col = (sort_col + key) % num_cols;
+			keys[key].dir = key % 2 ? SORT_DESC : SORT_ASC;
+		}
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			// the normalized keys and the check's sort pairs take 28 bytes per row and key, up to two tables' worth
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + 2 * num_keys * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", num_keys);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			col_table_t* table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = multikeysort(table_copy, keys, num_keys);
+			timer_stop_print(&timer);
+			if(!check_multikey_sorted(table_copy, keys, num_keys, table)) {
+				printf("multikeysort: table_copy not sorted;\n");
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			free_col_table(table_copy);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// ORDER BY ... LIMIT k against sorting everything
+	printf("file: $parent_sort_topk_%lu_chunk.csv {\n", num_chunks);
+	printf("x log k,");
+	timer_print_header("topk (histogram)");
+	timer_print_header("topk (heap)");
+	timer_print_header("radixsort");
+	printf("\n");
+	for(ulong log_k = 0; log_k <= log_sort_chunk_size; log_k += 2) {
+		ulong k = 1 << log_k;
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			// three copies of the table stay around for the check, and radixsort adds its sort pairs
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + 2 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", log_k);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+
+			col_table_t* hist_top = copy_col_table(table);
+			timer_start(&timer);
+			hist_top = topk(hist_top, sort_col, domain_size, k);
+			timer_stop_print(&timer);
+
+			col_table_t* heap_top = copy_col_table(table);
+			timer_start(&timer);
+			heap_top = topk(heap_top, sort_col, 0, k);
+			timer_stop_print(&timer);
+
+			col_table_t* sorted = copy_col_table(table);
+			timer_start(&timer);
+			sorted = radixsort(sorted, sort_col, domain_size);
+			timer_stop_print(&timer);
+
+			if(!same_first_rows(hist_top, sorted, k) || !same_first_rows(heap_top, sorted, k)) {
+				printf("topk: not the first k rows;\n");
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			free_col_table(hist_top);
+			free_col_table(heap_top);
+			free_col_table(sorted);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+#ifndef __NAUTILUS__
+	// external sort with a memory budget of total_size / 2^x, against the in-memory radixsort
+	printf("file: $parent_sort_external_%lu_chunk.csv {\n", num_chunks);
+	printf("x log budget fraction,");
+	timer_print_header("externalsort");
+	timer_print_header("radixsort");
+	printf("\n");
+	for(ulong log_fraction = 0; log_fraction <= 4; ++log_fraction) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			// besides the external sort's budget and its output, radixsort takes another copy, output and sort pairs
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + 3 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", log_fraction);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+
+			col_table_t* table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = externalsort(table_copy, sort_col, total_size >> log_fraction);
+			timer_stop_print(&timer);
+			if(!table_copy || !check_sorted(table_copy, sort_col, domain_size, table)) {
+				printf("externalsort: table_copy not sorted;\n");
+				exit(1);
+			}
+			free_col_table(table_copy);
+
+			table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = radixsort(table_copy, sort_col, domain_size);
+			timer_stop_print(&timer);
+			free_col_table(table_copy);
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+#endif
+
+	// already sorted, reversed and nearly sorted inputs
+	printf("file: $parent_sort_presorted_%lu_chunk.csv {\n", num_chunks);
+	printf("x input order (random/sorted/reversed/nearly sorted),");
+	timer_print_header("adaptivesort");
+	timer_print_header("countingmergesort");
+	timer_print_header("radixsort");
+	printf("\n");
+	for(ulong order = 0; order < NUM_ORDERS; ++order) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			col_table_t* (*presorted_sorts[])(col_table_t*, size_t, size_t) = { adaptivesort, countingmergesort, radixsort };
+			ulong num_presorted_sorts = sizeof(presorted_sorts) / sizeof(presorted_sorts[0]);
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + num_presorted_sorts * SORT_BENCH_TABLES * total_size
+			               + chunk_size * domain_size * sizeof(size_t) + TOTAL_SIZE_EXTRA);
+			printf("%lu,", order);
+
+			col_table_t* table = create_ordered_table(num_chunks, chunk_size, num_cols, sort_col, order);
+			for(ulong impl = 0; impl < num_presorted_sorts; ++impl) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = presorted_sorts[impl](table_copy, sort_col, domain_size);
+				timer_stop_print(&timer);
+				if(!check_sorted(table_copy, sort_col, domain_size, table)) {
+					printf("presorted: table_copy not sorted;\n");
+					exit(1);
+				}
+				free_col_table(table_copy);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// radixsort does not depend on the domain
+	printf("file: $parent_sort_radix_%lu_chunk.csv {\n", num_chunks);
+	printf("x log domain size,");
+	timer_print_header("radixsort");
+	printf("\n");
+	for(ulong log_domain_size = 8; log_domain_size <= 32; log_domain_size += 8) {
+		unsigned int domain = log_domain_size == 32 ? UINT32_MAX : (1U << log_domain_size);
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+			printf("%lu,", log_domain_size);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain);
+			col_table_t* table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = radixsort(table_copy, sort_col, domain);
+			timer_stop_print(&timer);
+			if(!check_sorted(table_copy, sort_col, domain, table)) {
+				printf("radixsort: table_copy not sorted;\n");
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			free_col_table(table_copy);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	timer_finalize(&timer);
+}
+
+// true iff pred holds on a, where a PRED_CMP compares against b
+static bool pred_holds(const predicate_t *pred, val_t a, val_t b) {
+	bool match = false;
+	switch(pred->kind) {
+	case PRED_CMP:
+		switch(pred->cmp) {
+		case CMP_EQ: match = a == b; break;
+		case CMP_NE: match = a != b; break;
+		case CMP_LT: match = a <  b; break;
+		case CMP_LE: match = a <= b; break;
+		case CMP_GT: match = a >  b; break;
+		default:     match = a >= b; break;
+		}
+		break;
+	case PRED_BETWEEN:
+		match = pred->lo <= a && a <= pred->hi;
+		break;
+	default:
+		for(size_t k = 0; k < pred->num_vals; ++k) {
+			match |= a == pred->vals[k];
+		}
+		break;
+	}
+	return match;
+}
+
+// true iff expr holds on row row of t
+static bool filter_holds(const filter_expr_t *expr, col_table_t *t, size_t row) {
+	size_t chunk_size = get_chunk_size(t);
+	switch(expr->kind) {
+	case FILTER_PRED:
+		return pred_holds(&expr->pred, t->chunks[row / chunk_size]->columns[expr->col]->data[row % chunk_size], expr->pred.val);
+	case FILTER_AND:
+		for(size_t child = 0; child < expr->num_children; ++child) {
+			if(!filter_holds(&expr->children[child], t, row)) {
+				return false;
+			}
+		}
+		return true;
+	default:
+		for(size_t child = 0; child < expr->num_children; ++child) {
+			if(filter_holds(&expr->children[child], t, row)) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+// true iff row out_row of result is row row of in
+static bool same_row(col_table_t *result, size_t out_row, col_table_t *in, size_t row) {
+	size_t in_chunk_size = get_chunk_size(in);
+	size_t out_chunk_size = get_chunk_size(result);
+	table_chunk_t *in_chunk = in->chunks[row / in_chunk_size];
+	table_chunk_t *out_chunk = result->chunks[out_row / out_chunk_size];
+	for(size_t col = 0; col < in->num_cols; ++col) {
+		if(out_chunk->columns[col]->data[out_row % out_chunk_size] != in_chunk->columns[col]->data[row % in_chunk_size]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// true iff result holds exactly the rows of in where pred holds on in[col_a], in order;
+// if att, a PRED_CMP compares against in[col_b] instead of pred->val
+static bool check_selection(col_table_t *result, col_table_t *in, size_t col_a, const predicate_t *pred, size_t col_b, bool att) {
+	size_t in_chunk_size = get_chunk_size(in);
+	size_t out_row = 0;
+	for(size_t row = 0; row < in->num_rows; ++row) {
+		table_chunk_t *in_chunk = in->chunks[row / in_chunk_size];
+		val_t a = in_chunk->columns[col_a]->data[row % in_chunk_size];
+		val_t b = att ? in_chunk->columns[col_b]->data[row % in_chunk_size] : pred->val;
+		if(!pred_holds(pred, a, b)) {
+			continue;
+		}
+		if(out_row == result->num_rows || !same_row(result, out_row, in, row)) {
+			return false;
+		}
+		++out_row;
+	}
+	return out_row == result->num_rows;
+}
+
+// true iff result holds exactly the rows of in where expr holds, in order
+static bool check_filter(col_table_t *result, col_table_t *in, const filter_expr_t *expr) {
+	size_t out_row = 0;
+	for(size_t row = 0; row < in->num_rows; ++row) {
+		if(!filter_holds(expr, in, row)) {
+			continue;
+		}
+		if(out_row == result->num_rows || !same_row(result, out_row, in, row)) {
+			return false;
+		}
+		++out_row;
+	}
+	return out_row == result->num_rows;
+}
+
+// more than the adaptive selections' calibration tables and results take
+#define ADAPT_CALIBRATION_SIZE (64 * 1024 * 1024)
+
+void test_selection() {
+	ulong num_chunks = 1 << log_num_chunks;
+	ulong chunk_size = 1 << log_sort_chunk_size;
+	ulong num_cols = 1 << log_sort_num_cols;
+	ulong sel_col = num_cols / 2;
+	ulong other_col = (sel_col + 1) % num_cols;
+	ulong total_size = 1 << (log_num_chunks + log_sort_chunk_size + log_sort_num_cols + LOG_SIZEOF_VAL_T);
+	op_implementation_info_t *const_sels = &impl_infos[SELECTION_CONST];
+	op_implementation_info_t *att_sels = &impl_infos[SELECTION_ATT];
+	op_implementation_info_t *pred_sels = &impl_infos[SELECTION_PRED];
+	// the second IN-list has a value too large for a lookup bitmap, so it is evaluated as a list
+	val_t in_small[] = { 1, 3, 5, 7, 11, 13 };
+	val_t in_large[] = { 1, 3, 5, 7, 11, 1 << 20 };
+	predicate_t preds[] = {
+		{ .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 4 },
+		{ .kind = PRED_CMP, .cmp = CMP_LE, .val = domain_size / 2 },
+		{ .kind = PRED_BETWEEN, .lo = domain_size / 4, .hi = domain_size * 3 / 4 },
+		{ .kind = PRED_IN, .vals = in_small, .num_vals = sizeof(in_small) / sizeof(val_t) },
+		{ .kind = PRED_IN, .vals = in_large, .num_vals = sizeof(in_large) / sizeof(val_t) },
+		{ .kind = PRED_CMP, .cmp = CMP_NE, .val = domain_size / 2 },
+		{ .kind = PRED_CMP, .cmp = CMP_GT, .val = domain_size * 3 / 4 },
+		{ .kind = PRED_CMP, .cmp = CMP_GE, .val = domain_size / 4 },
+	};
+	// predicates whose row counts follow from the values being below domain_size alone
+	predicate_t edge_preds[] = {
+		{ .kind = PRED_CMP, .cmp = CMP_NE, .val = domain_size },
+		{ .kind = PRED_CMP, .cmp = CMP_GE, .val = 0 },
+		{ .kind = PRED_CMP, .cmp = CMP_GT, .val = domain_size - 1 },
+		{ .kind = PRED_BETWEEN, .lo = domain_size * 3 / 4, .hi = domain_size / 4 },
+		{ .kind = PRED_IN, .vals = NULL, .num_vals = 0 },
+	};
+	bool edge_preds_match_all[] = { true, true, false, false, false };
+	rand_seed(RAND_SEED);
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	// so that no timed call of an adaptive selection pays for calibrating it
+	my_malloc_init(ADAPT_CALIBRATION_SIZE);
+	adaptive_selection_calibrate();
+	my_malloc_deinit();
+
+	// col = 0 with a selectivity of 1 / 2^x
+	printf("file: $parent_selection_const_%lu_chunk.csv {\n", num_chunks);
+	printf("x log domain size,");
+	for(ulong impl = 0; impl < const_sels->num_impls; ++impl) {
+		timer_print_header(const_sels->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_domain_size = 0; log_domain_size <= 8; log_domain_size += 2) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + const_sels->num_impls * 2 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", log_domain_size);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, 1 << log_domain_size);
+			for(ulong impl = 0; impl < const_sels->num_impls; ++impl) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = const_sels->implementations[impl](table_copy, sel_col, 0);
+				timer_stop_print(&timer);
+				predicate_t eq_zero = { .kind = PRED_CMP, .cmp = CMP_EQ, .val = 0 };
+				if(!check_selection(table_copy, table, sel_col, &eq_zero, 0, false)) {
+					printf("%s: wrong selection;\n", const_sels->names[impl]);
+					exit(1);
+				}
+				free_col_table(table_copy);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// col_a <cmp> col_b for every comparison
+	printf("file: $parent_selection_att_%lu_chunk.csv {\n", num_chunks);
+	printf("x comparison (=/<>/</<=/>/>=),");
+	for(ulong impl = 0; impl < att_sels->num_impls; ++impl) {
+		timer_print_header(att_sels->names[impl]);
+	}
+	printf("\n");
+	for(ulong cmp = 0; cmp < NUM_CMPS; ++cmp) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + att_sels->num_impls * 2 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", cmp);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			for(ulong impl = 0; impl < att_sels->num_impls; ++impl) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = att_sels->implementations[impl](table_copy, sel_col, (cmp_op_t) cmp, other_col);
+				timer_stop_print(&timer);
+				predicate_t att_cmp = { .kind = PRED_CMP, .cmp = (cmp_op_t) cmp };
+				if(!check_selection(table_copy, table, sel_col, &att_cmp, other_col, true)) {
+					printf("%s (%s): wrong selection;\n", att_sels->names[impl], cmp_op_names[cmp]);
+					exit(1);
+				}
+				free_col_table(table_copy);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// col <pred> for range, BETWEEN and IN-list predicates
+	printf("file: $parent_selection_pred_%lu_chunk.csv {\n", num_chunks);
+	printf("x predicate (</<=/between/in lookup/in list/<>/>/>=),");
+	for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+		timer_print_header(pred_sels->names[impl]);
+	}
+	printf("\n");
+	for(ulong pred = 0; pred < sizeof(preds) / sizeof(predicate_t); ++pred) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + pred_sels->num_impls * 2 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", pred);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = pred_sels->implementations[impl](table_copy, sel_col, &preds[pred]);
+				timer_stop_print(&timer);
+				if(!table_copy || !check_selection(table_copy, table, sel_col, &preds[pred], 0, false)) {
+					printf("%s (predicate %lu): wrong selection;\n", pred_sels->names[impl], pred);
+					exit(1);
+				}
+				free_col_table(table_copy);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// every implementation on predicates that match all rows or none, against those row counts
+	for(ulong pred = 0; pred < sizeof(edge_preds) / sizeof(predicate_t); ++pred) {
+		my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + pred_sels->num_impls * 2 * total_size + TOTAL_SIZE_EXTRA);
+		col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+		ulong expected_rows = edge_preds_match_all[pred] ? table->num_rows : 0;
+		for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+			col_table_t* table_copy = copy_col_table(table);
+			table_copy = pred_sels->implementations[impl](table_copy, sel_col, &edge_preds[pred]);
+			if(!table_copy || table_copy->num_rows != expected_rows
+			   || !check_selection(table_copy, table, sel_col, &edge_preds[pred], 0, false)) {
+				printf("%s (edge predicate %lu): wrong selection;\n", pred_sels->names[impl], pred);
+				exit(1);
+			}
+			free_col_table(table_copy);
+		}
+		free_col_table(table);
+		my_malloc_deinit();
+	}
+
+	// col < val, then a projection onto that column:
+	// the default selection and projection against a position list and a gather of the one column
+	printf("file: $parent_selection_late_%lu_chunk.csv {\n", num_chunks);
+	printf("x selectivity (%%),");
+	timer_print_header("early");
+	timer_print_header("late");
+	printf("\n");
+	for(ulong percent = 1; percent <= 100; percent *= 10) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+			printf("%lu,", percent);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * percent / 100 };
+
+			col_table_t* table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = default_impls[SELECTION_PRED](table_copy, sel_col, &lt);
+			col_table_t* early = default_impls[PROJECTION](table_copy, &sel_col, 1);
+			timer_stop_print(&timer);
+
+			table_copy = copy_col_table(table);
+			timer_start(&timer);
+			pos_list_t* pl = poslist_selection_pred(table_copy, sel_col, &lt);
+			col_table_t* late = poslist_projection(pl, &sel_col, 1);
+			free_pos_list(pl);
+			free_col_table(table_copy);
+			timer_stop_print(&timer);
+
+			if(early->num_rows != late->num_rows || !same_first_rows(early, late, late->num_rows)) {
+				printf("late materialization: wrong selection;\n");
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(early);
+			free_col_table(late);
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// col < val, then a stable sort on col and a projection onto two other columns:
+	// the default selection, radixsort and the default projection against sorting the position list
+	printf("file: $parent_selection_late_sort_%lu_chunk.csv {\n", num_chunks);
+	printf("x selectivity (%%),");
+	timer_print_header("early");
+	timer_print_header("late");
+	printf("\n");
+	for(ulong percent = 1; percent <= 100; percent *= 10) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + 4 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", percent);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * percent / 100 };
+			// rows with equal keys differ in these, so they show whether the sort kept their order
+			size_t proj[] = { other_col, 0 };
+			size_t num_proj = sizeof(proj) / sizeof(size_t);
+
+			col_table_t* table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = default_impls[SELECTION_PRED](table_copy, sel_col, &lt);
+			table_copy = radixsort(table_copy, sel_col, domain_size);
+			col_table_t* early = default_impls[PROJECTION](table_copy, proj, num_proj);
+			timer_stop_print(&timer);
+
+			table_copy = copy_col_table(table);
+			timer_start(&timer);
+			pos_list_t* pl = poslist_selection_pred(table_copy, sel_col, &lt);
+			col_table_t* late = poslist_sort(pl, sel_col, proj, num_proj);
+			free_pos_list(pl);
+			free_col_table(table_copy);
+			timer_stop_print(&timer);
+
+			if(early->num_rows != late->num_rows || !same_first_rows(early, late, late->num_rows)) {
+				printf("late materialization: wrong sort;\n");
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(early);
+			free_col_table(late);
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// every aggregate over another column where col < val:
+	// the default selection and a reduction of the result against aggregating over the position list
+	printf("file: $parent_selection_late_aggregate_%lu_chunk.csv {\n", num_chunks);
+	printf("x selectivity (%%),");
+	timer_print_header("early");
+	timer_print_header("late");
+	printf("\n");
+	for(ulong percent = 1; percent <= 100; percent *= 10) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+			printf("%lu,", percent);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * percent / 100 };
+			uint64_t early[NUM_AGGS];
+			uint64_t late[NUM_AGGS];
+
+			col_table_t* table_copy = copy_col_table(table);
+			timer_start(&timer);
+			table_copy = default_impls[SELECTION_PRED](table_copy, sel_col, &lt);
+			for(ulong agg = 0; agg < NUM_AGGS; ++agg) {
+				early[agg] = column_reduce(table_copy, other_col, (agg_op_t) agg);
+			}
+			free_col_table(table_copy);
+			timer_stop_print(&timer);
+
+			table_copy = copy_col_table(table);
+			timer_start(&timer);
+			pos_list_t* pl = poslist_selection_pred(table_copy, sel_col, &lt);
+			for(ulong agg = 0; agg < NUM_AGGS; ++agg) {
+				late[agg] = poslist_aggregate(pl, other_col, (agg_op_t) agg);
+			}
+			free_pos_list(pl);
+			free_col_table(table_copy);
+			timer_stop_print(&timer);
+
+			for(ulong agg = 0; agg < NUM_AGGS; ++agg) {
+				if(early[agg] != late[agg]) {
+					printf("late materialization: wrong aggregate %lu;\n", agg);
+					exit(1);
+				}
+			}
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// col < val on a table sorted on col, so the zone maps skip or copy every chunk but one
+	printf("file: $parent_selection_zone_%lu_chunk.csv {\n", num_chunks);
+	printf("x selectivity (%%),");
+	for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+		timer_print_header(pred_sels->names[impl]);
+	}
+	printf("\n");
+	for(ulong percent = 0; percent <= 100; percent += 25) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + pred_sels->num_impls * 2 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", percent);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			table = radixsort(table, sel_col, domain_size);
+			// so that it is the zone maps, not a binary search, which skip the chunks
+			table->sorted_col = TABLE_UNSORTED;
+			predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * percent / 100 };
+			for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = pred_sels->implementations[impl](table_copy, sel_col, &lt);
+				timer_stop_print(&timer);
+				if(!table_copy || !check_selection(table_copy, table, sel_col, &lt, 0, false)) {
+					printf("%s (%lu%%): wrong selection;\n", pred_sels->names[impl], percent);
+					exit(1);
+				}
+				free_col_table(table_copy);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// col_0 < 90% AND col_1 < 50% AND col_2 < x%, written least selective first:
+	// one default selection per predicate, each copying what passes, against one filter
+	printf("file: $parent_filter_%lu_chunk.csv {\n", num_chunks);
+	printf("x selectivity of the last predicate (%%),");
+	timer_print_header("chained");
+	timer_print_header("filter");
+	printf("\n");
+	for(ulong percent = 1; percent <= 100; percent *= 10) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+			printf("%lu,", percent);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			filter_expr_t terms[] = {
+				{ .kind = FILTER_PRED, .col = 0, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * 9 / 10 } },
+				{ .kind = FILTER_PRED, .col = 1, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 2 } },
+				{ .kind = FILTER_PRED, .col = 2, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * percent / 100 } },
+			};
+			filter_expr_t conj = { .kind = FILTER_AND, .children = terms, .num_children = sizeof(terms) / sizeof(filter_expr_t) };
+
+			col_table_t* chained = copy_col_table(table);
+			timer_start(&timer);
+			for(ulong term = 0; term < conj.num_children; ++term) {
+				chained = default_impls[SELECTION_PRED](chained, terms[term].col, &terms[term].pred);
+			}
+			timer_stop_print(&timer);
+
+			col_table_t* filtered = copy_col_table(table);
+			timer_start(&timer);
+			filtered = default_impls[FILTER](filtered, &conj);
+			timer_stop_print(&timer);
+
+			if(!filtered || chained->num_rows != filtered->num_rows || !same_first_rows(chained, filtered, filtered->num_rows)
+			   || !check_filter(filtered, table, &conj)) {
+				printf("filter (%lu%%): wrong selection;\n", percent);
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(chained);
+			free_col_table(filtered);
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// ORs and ANDs nested in each other, each result checked against evaluating the expression on every row:
+	// 0: col_0 < 10% OR col_1 >= 90% OR col_2 IN (1, 3, 5)
+	// 1: (col_0 < 30% OR col_1 < 30%) AND col_2 BETWEEN 20% AND 80%
+	// 2: (col_0 < 50% AND col_1 < 50%) OR (col_2 >= 50% AND (col_3 = 7 OR col_0 > 90%))
+	// 3: (an empty AND) OR col_0 < 1%, which holds on every row
+	// 4: (an empty OR) AND col_0 < 50%, which holds on none
+	val_t in_odd[] = { 1, 3, 5 };
+	filter_expr_t any_of[] = {
+		{ .kind = FILTER_PRED, .col = 0, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 10 } },
+		{ .kind = FILTER_PRED, .col = 1, .pred = { .kind = PRED_CMP, .cmp = CMP_GE, .val = domain_size * 9 / 10 } },
+		{ .kind = FILTER_PRED, .col = 2, .pred = { .kind = PRED_IN, .vals = in_odd, .num_vals = sizeof(in_odd) / sizeof(val_t) } },
+	};
+	filter_expr_t either_low[] = {
+		{ .kind = FILTER_PRED, .col = 0, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * 3 / 10 } },
+		{ .kind = FILTER_PRED, .col = 1, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * 3 / 10 } },
+	};
+	filter_expr_t either_low_and_middle[] = {
+		{ .kind = FILTER_OR, .children = either_low, .num_children = sizeof(either_low) / sizeof(filter_expr_t) },
+		{ .kind = FILTER_PRED, .col = 2, .pred = { .kind = PRED_BETWEEN, .lo = domain_size / 5, .hi = domain_size * 4 / 5 } },
+	};
+	filter_expr_t both_low[] = {
+		{ .kind = FILTER_PRED, .col = 0, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 2 } },
+		{ .kind = FILTER_PRED, .col = 1, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 2 } },
+	};
+	filter_expr_t seven_or_high[] = {
+		{ .kind = FILTER_PRED, .col = 3, .pred = { .kind = PRED_CMP, .cmp = CMP_EQ, .val = 7 } },
+		{ .kind = FILTER_PRED, .col = 0, .pred = { .kind = PRED_CMP, .cmp = CMP_GT, .val = domain_size * 9 / 10 } },
+	};
+	filter_expr_t high_and_seven_or_high[] = {
+		{ .kind = FILTER_PRED, .col = 2, .pred = { .kind = PRED_CMP, .cmp = CMP_GE, .val = domain_size / 2 } },
+		{ .kind = FILTER_OR, .children = seven_or_high, .num_children = sizeof(seven_or_high) / sizeof(filter_expr_t) },
+	};
+	filter_expr_t both_branches[] = {
+		{ .kind = FILTER_AND, .children = both_low, .num_children = sizeof(both_low) / sizeof(filter_expr_t) },
+		{ .kind = FILTER_AND, .children = high_and_seven_or_high, .num_children = sizeof(high_and_seven_or_high) / sizeof(filter_expr_t) },
+	};
+	filter_expr_t empty_and_or_low[] = {
+		{ .kind = FILTER_AND, .children = NULL, .num_children = 0 },
+		{ .kind = FILTER_PRED, .col = 0, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 100 } },
+	};
+	filter_expr_t empty_or_and_low[] = {
+		{ .kind = FILTER_OR, .children = NULL, .num_children = 0 },
+		{ .kind = FILTER_PRED, .col = 0, .pred = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 2 } },
+	};
+	filter_expr_t nested[] = {
+		{ .kind = FILTER_OR, .children = any_of, .num_children = sizeof(any_of) / sizeof(filter_expr_t) },
+		{ .kind = FILTER_AND, .children = either_low_and_middle, .num_children = sizeof(either_low_and_middle) / sizeof(filter_expr_t) },
+		{ .kind = FILTER_OR, .children = both_branches, .num_children = sizeof(both_branches) / sizeof(filter_expr_t) },
+		{ .kind = FILTER_OR, .children = empty_and_or_low, .num_children = sizeof(empty_and_or_low) / sizeof(filter_expr_t) },
+		{ .kind = FILTER_AND, .children = empty_or_and_low, .num_children = sizeof(empty_or_and_low) / sizeof(filter_expr_t) },
+	};
+	printf("file: $parent_filter_nested_%lu_chunk.csv {\n", num_chunks);
+	printf("x expression,");
+	timer_print_header("filter");
+	printf("\n");
+	for(ulong expr = 0; expr < sizeof(nested) / sizeof(filter_expr_t); ++expr) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+			printf("%lu,", expr);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			col_table_t* filtered = copy_col_table(table);
+			timer_start(&timer);
+			filtered = default_impls[FILTER](filtered, &nested[expr]);
+			timer_stop_print(&timer);
+
+			if(!filtered || !check_filter(filtered, table, &nested[expr])) {
+				printf("filter (expression %lu): wrong selection;\n", expr);
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(filtered);
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// lo <= col <= hi on a table sorted on col, matching x% of the domain in its middle:
+	// the default selection scanning (with the zone maps) against a binary search for the matching range
+	printf("file: $parent_selection_sorted_%lu_chunk.csv {\n", num_chunks);
+	printf("x selectivity (%%),");
+	timer_print_header("scan");
+	timer_print_header("binary search");
+	printf("\n");
+	for(ulong percent = 1; percent <= 100; percent *= 10) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+			printf("%lu,", percent);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			table = countingmergesort(table, sel_col, domain_size);
+			ulong width = domain_size * percent / 100;
+			predicate_t between = { .kind = PRED_BETWEEN, .lo = (domain_size - width) / 2, .hi = (domain_size + width) / 2 - 1 };
+
+			col_table_t* scanned = copy_col_table(table);
+			scanned->sorted_col = TABLE_UNSORTED;
+			timer_start(&timer);
+			scanned = default_impls[SELECTION_PRED](scanned, sel_col, &between);
+			timer_stop_print(&timer);
+
+			col_table_t* searched = copy_col_table(table);
+			timer_start(&timer);
+			searched = default_impls[SELECTION_PRED](searched, sel_col, &between);
+			timer_stop_print(&timer);
+
+			if(!check_selection(searched, table, sel_col, &between, 0, false)
+			   || scanned->num_rows != searched->num_rows || !same_first_rows(scanned, searched, searched->num_rows)) {
+				printf("sorted selection (%lu%%): wrong selection;\n", percent);
+				exit(1);
+			}
+			printf("\n");
+
+			free_col_table(scanned);
+			free_col_table(searched);
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// col < val over tables of 1 to num_cols columns, since the best strategy depends on the width too
+	for(ulong width = 1; width <= num_cols; width *= 2) {
+		printf("file: $parent_selection_adaptive_%lu_cols.csv {\n", width);
+		printf("x selectivity (%%),");
+		for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+			timer_print_header(pred_sels->names[impl]);
+		}
+		printf("\n");
+		for(ulong percent = 1; percent < 100; percent += percent < 10 ? 9 : 20) {
+			for(ulong reps = 0; reps < REPS; ++reps) {
+				my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + pred_sels->num_impls * 2 * total_size + TOTAL_SIZE_EXTRA);
+				printf("%lu,", percent);
+
+				col_table_t* table = create_col_table(num_chunks, chunk_size, width, domain_size);
+				predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * percent / 100 };
+				for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+					col_table_t* table_copy = copy_col_table(table);
+					timer_start(&timer);
+					table_copy = pred_sels->implementations[impl](table_copy, 0, &lt);
+					timer_stop_print(&timer);
+					if(!table_copy || !check_selection(table_copy, table, 0, &lt, 0, false)) {
+						printf("%s (%lu columns, %lu%%): wrong selection;\n", pred_sels->names[impl], width, percent);
+						exit(1);
+					}
+					free_col_table(table_copy);
+				}
+				printf("\n");
+
+				free_col_table(table);
+				my_malloc_deinit();
+			}
+		}
+		printf("}\n");
+	}
+
+	// col < 10% on a table where the first x% of the chunks have values below 12.5% instead:
+	// about 80% of those rows match and 10% of the rest, so the adaptive selections switch strategies part way
+	printf("file: $parent_selection_drift_%lu_chunk.csv {\n", num_chunks);
+	printf("x drifted chunks (%%),");
+	for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+		timer_print_header(pred_sels->names[impl]);
+	}
+	printf("\n");
+	for(ulong percent = 25; percent < 100; percent += 25) {
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + pred_sels->num_impls * 2 * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", percent);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			for(ulong chunk_no = 0; chunk_no < num_chunks * percent / 100; ++chunk_no) {
+				val_t *data = table->chunks[chunk_no]->columns[sel_col]->data;
+				for(ulong row = 0; row < chunk_size; ++row) {
+					data[row] /= 8;
+				}
+			}
+			set_zone_maps(table);
+			predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 10 };
+			for(ulong impl = 0; impl < pred_sels->num_impls; ++impl) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = pred_sels->implementations[impl](table_copy, sel_col, &lt);
+				timer_stop_print(&timer);
+				if(!table_copy || !check_selection(table_copy, table, sel_col, &lt, 0, false)) {
+					printf("%s (%lu%% drifted): wrong selection;\n", pred_sels->names[impl], percent);
+					exit(1);
+				}
+				free_col_table(table_copy);
+			}
+			printf("\n");
+
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+
+	// the last column where col_0 < val, over tables of 1 to num_cols columns:
+	// every implementation of SELECT_PROJECT, the first being a selection followed by a projection
+	op_implementation_info_t *sel_projs = &impl_infos[SELECT_PROJECT];
+	for(ulong width = 1; width <= num_cols; width *= 2) {
+		printf("file: $parent_select_project_%lu_cols.csv {\n", width);
+		printf("x selectivity (%%),");
+		for(ulong impl = 0; impl < sel_projs->num_impls; ++impl) {
+			timer_print_header(sel_projs->names[impl]);
+		}
+		printf("\n");
+		for(ulong percent = 1; percent <= 100; percent *= 10) {
+			for(ulong reps = 0; reps < REPS; ++reps) {
+				my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+				printf("%lu,", percent);
+
+				col_table_t* table = create_col_table(num_chunks, chunk_size, width, domain_size);
+				predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size * percent / 100 };
+				ulong proj_col = width - 1;
+				col_table_t* expected = NULL;
+				for(ulong impl = 0; impl < sel_projs->num_impls; ++impl) {
+					col_table_t* table_copy = copy_col_table(table);
+					timer_start(&timer);
+					table_copy = sel_projs->implementations[impl](table_copy, 0, &lt, &proj_col, 1);
+					timer_stop_print(&timer);
+					if(!table_copy || (expected && (expected->num_rows != table_copy->num_rows
+													|| !same_first_rows(expected, table_copy, table_copy->num_rows)))) {
+						printf("%s (%lu columns, %lu%%): wrong selection;\n", sel_projs->names[impl], width, percent);
+						exit(1);
+					}
+					if(expected) {
+						free_col_table(table_copy);
+					} else {
+						expected = table_copy;
+					}
+				}
+				printf("\n");
+
+				free_col_table(expected);
+				free_col_table(table);
+				my_malloc_deinit();
+			}
+		}
+		printf("}\n");
+	}
+
+	timer_finalize(&timer);
+}
+
+// true iff a and b hold the same rows, as many times each, in any order; neither is consumed
+static bool same_rows_unordered(col_table_t *a, col_table_t *b) {
+	if(a->num_rows != b->num_rows) {
+		return false;
+	}
+	sort_key_t keys[a->num_cols];
+	for(ulong col = 0; col < a->num_cols; ++col) {
+		keys[col].col = col;
+		keys[col].dir = SORT_ASC;
+	}
+	col_table_t *a_sorted = multikeysort(copy_col_table(a), keys, a->num_cols);
+	col_table_t *b_sorted = multikeysort(copy_col_table(b), keys, b->num_cols);
+	bool same = same_first_rows(a_sorted, b_sorted, a->num_rows);
+	free_col_table(a_sorted);
+	free_col_table(b_sorted);
+	return same;
+}
+
+void test_selection_threads() {
+	ulong num_chunks = 1 << log_num_chunks;
+	ulong chunk_size = 1 << log_sort_chunk_size;
+	ulong num_cols = 1 << log_sort_num_cols;
+	ulong sel_col = num_cols / 2;
+	ulong total_size = 1 << (log_num_chunks + log_sort_chunk_size + log_sort_num_cols + LOG_SIZEOF_VAL_T);
+	// about half of the rows match
+	predicate_t lt = { .kind = PRED_CMP, .cmp = CMP_LT, .val = domain_size / 2 };
+	rand_seed(RAND_SEED);
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	// throughput is input rows per thousand cycles
+	printf("file: $parent_selection_threads_%lu_chunk.csv {\n", num_chunks);
+	printf("x threads,");
+	timer_print_header("ordered");
+	printf("ordered (rows/kcycle),");
+	timer_print_header("unordered");
+	printf("unordered (rows/kcycle),");
+	printf("\n");
+
+	for(ulong log_num_threads = 0; log_num_threads < log_num_threads_max; ++log_num_threads) {
+		ulong num_threads = 1 << log_num_threads;
+
+		for(ulong reps = 0; reps < REPS; ++reps) {
+			// the check sorts both results on every column, which takes up to two tables' worth per column and result
+			my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + 4 * num_cols * total_size + TOTAL_SIZE_EXTRA);
+			printf("%lu,", num_threads);
+
+			col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+			col_table_t* ordered = NULL;
+			for(ulong unordered = 0; unordered <= 1; ++unordered) {
+				col_table_t* table_copy = copy_col_table(table);
+				timer_start(&timer);
+				table_copy = morsel_selection_pred(table_copy, sel_col, &lt, num_threads, !unordered);
+				timer_stop_print(&timer);
+				printf("%lu,", table->num_rows * 1000 / MAX(1, timer_elapsed(&timer)));
+				// without order, the rows are checked as a multiset against the ordered result
+				if(unordered ? !same_rows_unordered(table_copy, ordered)
+				             : !check_selection(table_copy, table, sel_col, &lt, 0, false)) {
+					printf("morsel selection (%lu threads): wrong selection;\n", num_threads);
+					exit(1);
+				}
+				if(unordered) {
+					free_col_table(table_copy);
+				} else {
+					ordered = table_copy;
+				}
+			}
+			printf("\n");
+
+			free_col_table(ordered);
+			free_col_table(table);
+			my_malloc_deinit();
+		}
+	}
+	printf("}\n");
+	timer_finalize(&timer);
+}
+
+// A build table for the join benchmarks: column 0 has every key in [0:num_rows / copies] copies times, in random order,
+// and the last column is the row's id, its row number as created.
+static col_table_t *create_join_build(ulong num_chunks, ulong chunk_size, ulong num_cols, ulong copies) {
+	col_table_t *t = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+	// inside-out Fisher-Yates
+	for(ulong row = 0; row < t->num_rows; ++row) {
+		ulong other = rand_next(row + 1);
+		val_t *a = &t->chunks[row / chunk_size]->columns[0]->data[row % chunk_size];
+		val_t *b = &t->chunks[other / chunk_size]->columns[0]->data[other % chunk_size];
+		*a = *b;
+		*b = row / copies;
+		t->chunks[row / chunk_size]->columns[num_cols - 1]->data[row % chunk_size] = row;
+	}
+	set_zone_maps(t);
+	return t;
+}
+
+// A probe table for the join benchmarks: column 0 is one of the keys [0:num_keys] with probability percent%,
+// and above them otherwise, and the last column is the row's id, its row number as created.
+static col_table_t *create_join_probe(ulong num_chunks, ulong chunk_size, ulong num_cols, ulong num_keys, ulong percent) {
+	col_table_t *t = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+	for(ulong row = 0; row < t->num_rows; ++row) {
+		bool match = rand_next(100) < percent;
+		t->chunks[row / chunk_size]->columns[0]->data[row % chunk_size] = match ? rand_next(num_keys) : num_keys + rand_next(num_keys);
+		t->chunks[row / chunk_size]->columns[num_cols - 1]->data[row % chunk_size] = row;
+	}
+	set_zone_maps(t);
+	return t;
+}
+
+static inline val_t table_val(col_table_t *t, ulong row, ulong col) {
+	ulong chunk_size = get_chunk_size(t);
+	return t->chunks[row / chunk_size]->columns[col]->data[row % chunk_size];
+}
+
+// true iff result is the join of build and probe on column 0 in some order, as built by create_join_build and
+// create_join_probe: every result row is a build row followed by a probe row with the same key, found by their ids,
+// and every such pair occurs exactly once. No key may occur more than 64 times in build.
+static bool check_join(col_table_t *result, col_table_t *build, col_table_t *probe) {
+	ulong build_rows = build->num_rows;
+	ulong probe_rows = probe->num_rows;
+	ulong build_id_col = build->num_cols - 1;
+	ulong probe_id_col = probe->num_cols - 1;
+	// the rows of the (maybe sorted) inputs by id; the number of build rows with each key,
+	// which are below build_rows; each build row's rank among those; and the ranks each probe row was paired with
+	ulong *build_row = NEWA(ulong, build_rows);
+	ulong *probe_row = NEWA(ulong, probe_rows);
+	ulong *copies = NEWA(ulong, build_rows);
+	uint8_t *rank = NEWA(uint8_t, build_rows);
+	uint64_t *paired = NEWA(uint64_t, probe_rows);
+	memset(copies, 0, build_rows * sizeof(ulong));
+	memset(paired, 0, probe_rows * sizeof(uint64_t));
+	for(ulong row = 0; row < build_rows; ++row) {
+		val_t id = table_val(build, row, build_id_col);
+		val_t key = table_val(build, row, 0);
+		build_row[id] = row;
+		rank[id] = copies[key]++;
+		assert(copies[key] <= 64);
+	}
+	for(ulong row = 0; row < probe_rows; ++row) {
+		probe_row[table_val(probe, row, probe_id_col)] = row;
+	}
+
+	bool ok = true;
+	for(ulong row = 0; ok && row < result->num_rows; ++row) {
+		val_t build_id = table_val(result, row, build_id_col);
+		val_t probe_id = table_val(result, row, build->num_cols + probe_id_col);
+		if(build_id >= build_rows || probe_id >= probe_rows
+		   || table_val(result, row, 0) != table_val(result, row, build->num_cols)
+		   || (paired[probe_id] & ((uint64_t) 1 << rank[build_id]))) {
+			ok = false;
+			break;
+		}
+		paired[probe_id] |= (uint64_t) 1 << rank[build_id];
+		for(ulong col = 0; ok && col < build->num_cols; ++col) {
+			ok = table_val(result, row, col) == table_val(build, build_row[build_id], col);
+		}
+		for(ulong col = 0; ok && col < probe->num_cols; ++col) {
+			ok = table_val(result, row, build->num_cols + col) == table_val(probe, probe_row[probe_id], col);
+		}
+	}
+	// every probe row paired with every build row of its key
+	for(ulong id = 0; ok && id < probe_rows; ++id) {
+		val_t key = table_val(probe, probe_row[id], 0);
+		ulong expected = key < build_rows ? copies[key] : 0;
+		ok = paired[id] == (expected == 64 ? UINT64_MAX : ((uint64_t) 1 << expected) - 1);
+	}
+
+	my_free(build_row);
+	my_free(probe_row);
+	my_free(copies);
+	my_free(rank);
+	my_free(paired);
+	return ok;
+}
+
+// (hash, row) pairs and their scratch, or the pairs of a radixsort
+#define JOIN_BENCH_ROW_BYTES (2 * sizeof(sort_pair_t))
+
+// REPS rows of a join benchmark at x: every JOIN implementation on a build table of build_chunks chunks
+// with each key copies times and a probe table of probe_chunks chunks, with percent% of the probe rows
+// matching copies build rows each; both are sorted on their key beforehand, untimed, if presorted
+static void bench_join(timer_data_t *timer, ulong x, ulong build_chunks, ulong probe_chunks, ulong percent, ulong copies,
+                       bool presorted) {
+	ulong chunk_size = 1 << log_sort_chunk_size;
+	// per side, so a result is no wider than the other benchmarks' tables
+	ulong num_cols = 1 << (log_sort_num_cols - 1);
+	op_implementation_info_t *joins = &impl_infos[JOIN];
+
+	for(ulong reps = 0; reps < REPS; ++reps) {
+		// Every implementation allocates copies of both inputs and maybe sorted copies of those,
+		// up to JOIN_BENCH_ROW_BYTES per input row for its partitions or runs,
+		// and the result with up to twice as many bytes per row for its matches.
+		// The inputs may be sorted twice, and the check takes up to 17 bytes per input row.
+		ulong build_rows = build_chunks * chunk_size;
+		ulong probe_rows = probe_chunks * chunk_size;
+		ulong inputs_size = (build_rows + probe_rows) * num_cols * sizeof(val_t);
+		ulong result_rows = probe_rows * copies;
+		ulong result_size = result_rows * 2 * num_cols * sizeof(val_t) + result_rows * 4 * sizeof(row_loc_t);
+		my_malloc_init(joins->num_impls * (2 * inputs_size + (build_rows + probe_rows) * JOIN_BENCH_ROW_BYTES + result_size)
+		               + 2 * inputs_size + (build_rows + probe_rows) * 17 + TOTAL_SIZE_EXTRA);
+		printf("%lu,", x);
+
+		col_table_t* build = create_join_build(build_chunks, chunk_size, num_cols, copies);
+		col_table_t* probe = create_join_probe(probe_chunks, chunk_size, num_cols, build->num_rows / copies, percent);
+		if(presorted) {
+			build = radixsort(build, 0, domain_size);
+			probe = radixsort(probe, 0, domain_size);
+		}
+		for(ulong impl = 0; impl < joins->num_impls; ++impl) {
+			col_table_t* build_copy = copy_col_table(build);
+			col_table_t* probe_copy = copy_col_table(probe);
+			timer_start(timer);
+			col_table_t* result = joins->implementations[impl](build_copy, 0, probe_copy, 0);
+			timer_stop_print(timer);
+			if(!result || !check_join(result, build, probe)) {
+				printf("%s (%lu x %lu chunks, %lu%%, %lu copies): wrong join;\n", joins->names[impl], build_chunks, probe_chunks, percent, copies);
+				exit(1);
+			}
+			free_col_table(result);
+		}
+		printf("\n");
+
+		free_col_table(build);
+		free_col_table(probe);
+		my_malloc_deinit();
+	}
+}
+
+void test_join() {
+	ulong num_chunks = 1 << log_num_chunks;
+	op_implementation_info_t *joins = &impl_infos[JOIN];
+	rand_seed(RAND_SEED);
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	// build tables of 2^x chunks against a probe table of num_chunks chunks, every probe row matching
+	printf("file: $parent_join_build_%lu_chunk.csv {\n", num_chunks);
+	printf("x log build chunks,");
+	for(ulong impl = 0; impl < joins->num_impls; ++impl) {
+		timer_print_header(joins->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_build_chunks = 0; log_build_chunks <= log_num_chunks; log_build_chunks += 2) {
+		bench_join(&timer, log_build_chunks, 1 << log_build_chunks, num_chunks, 100, 1, false);
+	}
+	printf("}\n");
+
+	// probe tables of 2^x chunks against a build table of num_chunks / 4 chunks, every probe row matching
+	printf("file: $parent_join_probe_%lu_chunk.csv {\n", num_chunks);
+	printf("x log probe chunks,");
+	for(ulong impl = 0; impl < joins->num_impls; ++impl) {
+		timer_print_header(joins->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_probe_chunks = 0; log_probe_chunks <= log_num_chunks; log_probe_chunks += 2) {
+		bench_join(&timer, log_probe_chunks, num_chunks / 4, 1 << log_probe_chunks, 100, 1, false);
+	}
+	printf("}\n");
+
+	// num_chunks / 4 build chunks against num_chunks probe chunks, x% of the probe rows matching
+	printf("file: $parent_join_match_%lu_chunk.csv {\n", num_chunks);
+	printf("x match rate (%%),");
+	for(ulong impl = 0; impl < joins->num_impls; ++impl) {
+		timer_print_header(joins->names[impl]);
+	}
+	printf("\n");
+	for(ulong percent = 0; percent <= 100; percent += 25) {
+		bench_join(&timer, percent, num_chunks / 4, num_chunks, percent, 1, false);
+	}
+	printf("}\n");
+
+	// num_chunks / 4 build chunks with each key 2^x times against num_chunks / 4 probe chunks, every probe row matching:
+	// probe keys repeat as well, so each key joins a group of build rows with a group of probe rows
+	printf("file: $parent_join_duplicates_%lu_chunk.csv {\n", num_chunks);
+	printf("x log copies of each build key,");
+	for(ulong impl = 0; impl < joins->num_impls; ++impl) {
+		timer_print_header(joins->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_copies = 0; log_copies <= 3; ++log_copies) {
+		bench_join(&timer, log_copies, num_chunks / 4, num_chunks / 4, 100, 1 << log_copies, false);
+	}
+	printf("}\n");
+
+	// the same, with both sides already sorted on their key
+	printf("file: $parent_join_sorted_match_%lu_chunk.csv {\n", num_chunks);
+	printf("x match rate (%%),");
+	for(ulong impl = 0; impl < joins->num_impls; ++impl) {
+		timer_print_header(joins->names[impl]);
+	}
+	printf("\n");
+	for(ulong percent = 0; percent <= 100; percent += 25) {
+		bench_join(&timer, percent, num_chunks / 4, num_chunks, percent, 1, true);
+	}
+	printf("}\n");
+
+	// num_chunks / 4 build chunks with each key 2^x times against num_chunks / 16 probe chunks, every probe row matching,
+	// with both sides already sorted on their key: for sortmerge, no more than merging groups of equal keys
+	printf("file: $parent_join_sorted_duplicates_%lu_chunk.csv {\n", num_chunks);
+	printf("x log copies of each build key,");
+	for(ulong impl = 0; impl < joins->num_impls; ++impl) {
+		timer_print_header(joins->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_copies = 0; log_copies <= 6; log_copies += 2) {
+		bench_join(&timer, log_copies, num_chunks / 4, num_chunks / 16, 100, 1 << log_copies, true);
+	}
+	printf("}\n");
+
+	timer_finalize(&timer);
+}
+
+// A hashed GROUP_BY partial, and so the hash set of a DISTINCT, takes about this many bytes per input row at most:
+// one group per row, with its count, accumulators, keys and slots, and the arrays it outgrew.
+#define GROUP_BY_ROW_BYTES 256
+#define GROUP_BY_MAX_GROUP_COLS 4
+
+// true iff rows a and b of t agree on its first num_cols columns
+static bool same_group(col_table_t *t, ulong a, ulong b, ulong num_cols) {
+	for(ulong col = 0; col < num_cols; ++col) {
+		if(table_val(t, a, col) != table_val(t, b, col)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// agg over column col of rows [start:stop] of t, as a GROUP_BY gives it
+static val_t group_aggregate(col_table_t *t, ulong start, ulong stop, const aggregate_t *agg) {
+	uint64_t sum = 0;
+	val_t min = (val_t) -1;
+	val_t max = 0;
+	for(ulong row = start; row < stop; ++row) {
+		val_t val = table_val(t, row, agg->col);
+		sum += val;
+		min = MIN(min, val);
+		max = MAX(max, val);
+	}
+	switch(agg->agg) {
+	case AGG_COUNT: return stop - start;
+	case AGG_SUM:   return (val_t) sum;
+	case AGG_MIN:   return min;
+	case AGG_MAX:   return max;
+	default:        return sum / (stop - start);
+	}
+}
+
+// true iff result is the GROUP_BY for aggs of t on its first num_group_cols columns, in any order,
+// where sorted is t sorted on those columns: each run of rows with the same group there is aggregated anew
+// and compared with the result's row for that group. With no aggs, this is the check of a DISTINCT:
+// every row of result is a different combination of the input's and none is missing. result is not consumed.
+static bool check_group_by(col_table_t *result, col_table_t *sorted, ulong num_group_cols, const aggregate_t *aggs, ulong num_aggs) {
+	if(result->num_cols != num_group_cols + num_aggs) {
+		return false;
+	}
+	sort_key_t keys[num_group_cols];
+	for(ulong col = 0; col < num_group_cols; ++col) {
+		keys[col].col = col;
+		keys[col].dir = SORT_ASC;
+	}
+	col_table_t *out = multikeysort(copy_col_table(result), keys, num_group_cols);
+
+	bool ok = true;
+	ulong out_row = 0;
+	for(ulong start = 0; ok && start < sorted->num_rows; ++out_row) {
+		ulong stop = start + 1;
+		while(stop < sorted->num_rows && same_group(sorted, start, stop, num_group_cols)) {
+			++stop;
+		}
+		ok = out_row < out->num_rows;
+		for(ulong col = 0; ok && col < num_group_cols; ++col) {
+			ok = table_val(out, out_row, col) == table_val(sorted, start, col);
+		}
+		for(ulong agg = 0; ok && agg < num_aggs; ++agg) {
+			ok = table_val(out, out_row, num_group_cols + agg) == group_aggregate(sorted, start, stop, &aggs[agg]);
+		}
+		start = stop;
+	}
+	ok = ok && out_row == out->num_rows;
+
+	free_col_table(out);
+	return ok;
+}
+
+// REPS rows of a GROUP_BY or DISTINCT benchmark at x: every implementation of op on the first num_group_cols columns,
+// with values in [0:group_domain], and for a GROUP_BY, COUNT, SUM, MIN, MAX and AVG of the columns after them;
+// the last chunk is half full if partial
+static void bench_grouping(timer_data_t *timer, ulong x, operator_t op, ulong num_group_cols, ulong group_domain, bool partial) {
+	ulong num_chunks = 1 << log_num_chunks;
+	ulong chunk_size = 1 << log_sort_chunk_size;
+	ulong num_cols = 1 << log_sort_num_cols;
+	ulong total_size = 1 << (log_num_chunks + log_sort_chunk_size + log_sort_num_cols + LOG_SIZEOF_VAL_T);
+	op_implementation_info_t *impls = &impl_infos[op];
+
+	size_t group_cols[GROUP_BY_MAX_GROUP_COLS];
+	// for the check
+	sort_key_t keys[GROUP_BY_MAX_GROUP_COLS];
+	for(ulong k = 0; k < num_group_cols; ++k) {
+		group_cols[k] = k;
+		keys[k].col = k;
+		keys[k].dir = SORT_ASC;
+	}
+	aggregate_t aggs[] = {
+		{ AGG_COUNT, 0 },
+		{ AGG_SUM, num_group_cols % num_cols },
+		{ AGG_MIN, (num_group_cols + 1) % num_cols },
+		{ AGG_MAX, (num_group_cols + 1) % num_cols },
+		{ AGG_AVG, (num_group_cols + 2) % num_cols },
+	};
+	ulong num_aggs = op == GROUP_BY ? sizeof(aggs) / sizeof(aggs[0]) : 0;
+
+	for(ulong reps = 0; reps < REPS; ++reps) {
+		// The input is not consumed, so every implementation needs room just for its partials (or hash set) and result.
+		// The check sorts a copy of the input and of every result on the group columns,
+		// which takes up to two tables' worth per group column each.
+		ulong num_rows = num_chunks * chunk_size - (partial ? chunk_size / 2 : 0);
+		my_malloc_init(((ulong) (total_size * TOTAL_SIZE_EXTRA_FACTOR)) + 2 * impls->num_impls * num_rows * GROUP_BY_ROW_BYTES
+		               + (1 + impls->num_impls) * 2 * num_group_cols * total_size + TOTAL_SIZE_EXTRA);
+		printf("%lu,", x);
+
+		col_table_t* table = create_col_table(num_chunks, chunk_size, num_cols, domain_size);
+		table->num_rows = num_rows;
+		for(ulong row = 0; row < num_rows; ++row) {
+			for(ulong k = 0; k < num_group_cols; ++k) {
+				table->chunks[row / chunk_size]->columns[k]->data[row % chunk_size] = rand_next(group_domain);
+			}
+		}
+		set_zone_maps(table);
+		col_table_t* sorted = multikeysort(copy_col_table(table), keys, num_group_cols);
+
+		for(ulong impl = 0; impl < impls->num_impls; ++impl) {
+			timer_start(timer);
+			col_table_t* result = op == GROUP_BY
+				? impls->implementations[impl](table, group_cols, num_group_cols, aggs, num_aggs)
+				: impls->implementations[impl](table, group_cols, num_group_cols);
+			timer_stop_print(timer);
+			if(!result || !check_group_by(result, sorted, num_group_cols, aggs, num_aggs)) {
+				printf("%s (%lu columns of %lu values): wrong %s;\n", impls->names[impl], num_group_cols, group_domain, op_names[op]);
+				exit(1);
+			}
+			free_col_table(result);
+		}
+		printf("\n");
+
+		free_col_table(sorted);
+		free_col_table(table);
+		my_malloc_deinit();
+	}
+}
+
+void test_group_by() {
+	ulong num_chunks = 1 << log_num_chunks;
+	op_implementation_info_t *group_bys = &impl_infos[GROUP_BY];
+	rand_seed(RAND_SEED);
+	par_set_threads(1 << (log_num_threads_max - 1));
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	// one group column with 2^x values; direct arrays up to GROUP_DIRECT_MAX_GROUPS
+	printf("file: $parent_group_by_groups_%lu_chunk.csv {\n", num_chunks);
+	printf("x log groups,");
+	for(ulong impl = 0; impl < group_bys->num_impls; ++impl) {
+		timer_print_header(group_bys->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_groups = 0; log_groups <= 20; log_groups += 2) {
+		bench_grouping(&timer, log_groups, GROUP_BY, 1, 1 << log_groups, false);
+	}
+	printf("}\n");
+
+	// x group columns with domain_size values each
+	printf("file: $parent_group_by_cols_%lu_chunk.csv {\n", num_chunks);
+	printf("x group columns,");
+	for(ulong impl = 0; impl < group_bys->num_impls; ++impl) {
+		timer_print_header(group_bys->names[impl]);
+	}
+	printf("\n");
+	for(ulong num_group_cols = 1; num_group_cols <= GROUP_BY_MAX_GROUP_COLS; ++num_group_cols) {
+		bench_grouping(&timer, num_group_cols, GROUP_BY, num_group_cols, domain_size, false);
+	}
+	printf("}\n");
+
+	// the same as the first, on a table whose last chunk is half full: direct arrays below 2^16 groups, hashed above
+	printf("file: $parent_group_by_partial_%lu_chunk.csv {\n", num_chunks);
+	printf("x log groups,");
+	for(ulong impl = 0; impl < group_bys->num_impls; ++impl) {
+		timer_print_header(group_bys->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_groups = 4; log_groups <= 20; log_groups += 16) {
+		bench_grouping(&timer, log_groups, GROUP_BY, 1, 1 << log_groups, true);
+	}
+	printf("}\n");
+
+	par_set_threads(1);
+	timer_finalize(&timer);
+}
+
+void test_distinct() {
+	ulong num_chunks = 1 << log_num_chunks;
+	op_implementation_info_t *distincts = &impl_infos[DISTINCT];
+	rand_seed(RAND_SEED);
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	// one column with 2^x values; adaptive takes the bitmap up to DISTINCT_BITMAP_BITS_PER_ROW bits per row
+	printf("file: $parent_distinct_values_%lu_chunk.csv {\n", num_chunks);
+	printf("x log values,");
+	for(ulong impl = 0; impl < distincts->num_impls; ++impl) {
+		timer_print_header(distincts->names[impl]);
+	}
+	printf("\n");
+	for(ulong log_values = 0; log_values <= 28; log_values += 2) {
+		bench_grouping(&timer, log_values, DISTINCT, 1, 1 << log_values, false);
+	}
+	printf("}\n");
+
+	// x columns with domain_size values each
+	printf("file: $parent_distinct_cols_%lu_chunk.csv {\n", num_chunks);
+	printf("x columns,");
+	for(ulong impl = 0; impl < distincts->num_impls; ++impl) {
+		timer_print_header(distincts->names[impl]);
+	}
+	printf("\n");
+	for(ulong num_cols = 1; num_cols <= GROUP_BY_MAX_GROUP_COLS; ++num_cols) {
+		bench_grouping(&timer, num_cols, DISTINCT, num_cols, domain_size, false);
+	}
+	printf("}\n");
+
+	// x columns with 2^16 values each: adaptive takes the hash set from two on, with more combinations than bits it may use
+	printf("file: $parent_distinct_wide_%lu_chunk.csv {\n", num_chunks);
+	printf("x columns,");
+	for(ulong impl = 0; impl < distincts->num_impls; ++impl) {
+		timer_print_header(distincts->names[impl]);
+	}
+	printf("\n");
+	for(ulong num_cols = 1; num_cols <= GROUP_BY_MAX_GROUP_COLS; ++num_cols) {
+		bench_grouping(&timer, num_cols, DISTINCT, num_cols, 1 << 16, false);
+	}
+	printf("}\n");
+
+	timer_finalize(&timer);
+}
+
+// Whole-column reductions are bound by memory bandwidth once the column is out of cache,
+// so they are timed next to reading the same bytes with memcpy and one value at a time.
+#define REDUCE_LOG_CHUNK_SIZE_MIN 8
+#define REDUCE_LOG_CHUNK_SIZE_MAX 16
+
+// The timed column has domain_size values; the other one is within domain_size of UINT32_MAX,
+// so any 32-bit accumulator of its sum overflows on the second value.
+#define REDUCE_NUM_COLS 2
+#define REDUCE_WIDE_COL 1
+
+// true iff every aggregate of every column of t is expected[col][agg], serially or in parallel
+static bool check_reduce(col_table_t *t, uint64_t expected[REDUCE_NUM_COLS][NUM_AGGS], bool parallel) {
+	for(ulong col = 0; col < REDUCE_NUM_COLS; ++col) {
+		for(ulong agg = 0; agg < NUM_AGGS; ++agg) {
+			uint64_t result = parallel ? parallel_column_reduce(t, col, agg) : column_reduce(t, col, agg);
+			if(result != expected[col][agg]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// REPS rows of the reduction benchmark on column 0 of a table of 2^log_chunk_size-row chunks
+static void bench_reduce(timer_data_t *timer, ulong log_chunk_size, bool by_simd_level) {
+	ulong num_chunks = 1 << log_num_chunks;
+	ulong chunk_size = 1 << log_chunk_size;
+	ulong total_size = 1 << (log_num_chunks + log_chunk_size + LOG_SIZEOF_VAL_T);
+	simd_level_t best_simd_level = simd_detect();
+	agg_op_t aggs[] = { AGG_SUM, AGG_MIN, AGG_MAX, AGG_AVG };
+	ulong num_aggs = sizeof(aggs) / sizeof(aggs[0]);
+
+	for(ulong reps = 0; reps < REPS; ++reps) {
+		my_malloc_init(((ulong) (REDUCE_NUM_COLS * total_size * TOTAL_SIZE_EXTRA_FACTOR)) + TOTAL_SIZE_EXTRA);
+		col_table_t* table = create_col_table(num_chunks, chunk_size, REDUCE_NUM_COLS, domain_size);
+		for(ulong row = 0; row < table->num_rows; ++row) {
+			table->chunks[row / chunk_size]->columns[REDUCE_WIDE_COL]->data[row % chunk_size] = UINT32_MAX - rand_next(domain_size);
+		}
+		set_zone_maps(table);
+		printf("%lu,", log_chunk_size);
+
+		uint64_t expected[REDUCE_NUM_COLS][NUM_AGGS];
+		for(ulong col = 0; col < REDUCE_NUM_COLS; ++col) {
+			uint64_t *e = expected[col];
+			e[AGG_COUNT] = table->num_rows;
+			e[AGG_SUM] = 0;
+			e[AGG_MIN] = (val_t) -1;
+			e[AGG_MAX] = 0;
+			for(ulong row = 0; row < table->num_rows; ++row) {
+				val_t val = table->chunks[row / chunk_size]->columns[col]->data[row % chunk_size];
+				e[AGG_SUM] += val;
+				e[AGG_MIN] = MIN(e[AGG_MIN], val);
+				e[AGG_MAX] = MAX(e[AGG_MAX], val);
+			}
+			e[AGG_AVG] = e[AGG_SUM] / table->num_rows;
+		}
+
+		if(by_simd_level) {
+			for(ulong level = 0; level <= best_simd_level; ++level) {
+				simd_set_level(level);
+				timer_start(timer);
+				uint64_t result = column_reduce(table, 0, AGG_SUM);
+				timer_stop_print(timer);
+				if(result != expected[0][AGG_SUM] || !check_reduce(table, expected, false) || !check_reduce(table, expected, true)) {
+					printf("%s: wrong reduction;\n", simd_level_names[level]);
+					exit(1);
+				}
+			}
+			simd_set_level(best_simd_level);
+		} else {
+			val_t *copy = NEWA(val_t, chunk_size);
+			timer_start(timer);
+			for(ulong chunk_no = 0; chunk_no < num_chunks; ++chunk_no) {
+				memcpy(copy, table->chunks[chunk_no]->columns[0]->data, chunk_size * sizeof(val_t));
+			}
+			timer_stop_print(timer);
+			my_free(copy);
+
+			timer_start(timer);
+			#pragma GCC diagnostic push
+			#pragma GCC diagnostic ignored "-Wunused-variable"
+			for(ulong chunk_no = 0; chunk_no < num_chunks; ++chunk_no) {
+				for(val_t *src = table->chunks[chunk_no]->columns[0]->data, *stop = src + chunk_size;
+					src < stop; src++) {
+					volatile val_t dst = *src;
+				}
+			}
+			#pragma GCC diagnostic pop
+			timer_stop_print(timer);
+
+			for(ulong a = 0; a < num_aggs; ++a) {
+				timer_start(timer);
+				uint64_t result = column_reduce(table, 0, aggs[a]);
+				timer_stop_print(timer);
+				if(result != expected[0][aggs[a]]) {
+					printf("aggregate %u: wrong reduction;\n", aggs[a]);
+					exit(1);
+				}
+			}
+
+			timer_start(timer);
+			uint64_t result = parallel_column_reduce(table, 0, AGG_SUM);
+			timer_stop_print(timer);
+			if(result != expected[0][AGG_SUM] || !check_reduce(table, expected, false) || !check_reduce(table, expected, true)) {
+				printf("parallel: wrong reduction;\n");
+				exit(1);
+			}
+		}
+		printf("\n");
+
+		free_col_table(table);
+		my_malloc_deinit();
+	}
+}
+
+void test_reduce() {
+	ulong num_chunks = 1 << log_num_chunks;
+	rand_seed(RAND_SEED);
+	par_set_threads(1 << (log_num_threads_max - 1));
+
+	timer_data_t timer;
+	timer_initialize(&timer);
+
+	printf("file: $parent_reduce_%lu_chunk.csv {\n", num_chunks);
+	printf("x log chunk size,");
+	timer_print_header("copy (memcpy)");
+	timer_print_header("get");
+	timer_print_header("sum");
+	timer_print_header("min");
+	timer_print_header("max");
+	timer_print_header("avg");
+	timer_print_header("sum (parallel)");
+	printf("\n");
+	for(ulong log_chunk_size = REDUCE_LOG_CHUNK_SIZE_MIN; log_chunk_size <= REDUCE_LOG_CHUNK_SIZE_MAX; log_chunk_size += 2) {
+		bench_reduce(&timer, log_chunk_size, false);
+	}
+	printf("}\n");
+
+	// SUM at every vector level this machine supports
+	simd_level_t best_simd_level = simd_detect();
+	printf("file: $parent_reduce_simd_%lu_chunk.csv {\n", num_chunks);
+	printf("x log chunk size,");
+	for(ulong level = 0; level <= best_simd_level; ++level) {
+		timer_print_header(simd_level_names[level]);
+	}
+	printf("\n");
+	for(ulong log_chunk_size = REDUCE_LOG_CHUNK_SIZE_MIN; log_chunk_size <= REDUCE_LOG_CHUNK_SIZE_MAX; log_chunk_size += 2) {
+		bench_reduce(&timer, log_chunk_size, true);
+	}
+	printf("}\n");
+
+	par_set_threads(1);
+	timer_finalize(&timer);
+}
+
 void test_just_sort(uint8_t log_num_chunks_, uint8_t log_chunk_size_, uint8_t log_num_cols_, size_t reps) {
 	uint8_t log_total_size = log_num_chunks_ + log_chunk_size_ + log_num_cols_ + LOG_SIZEOF_VAL_T;
 	size_t total_size = ((ulong) ((1 << log_total_size) * (1 + reps * 1.3))) + TOTAL_SIZE_EXTRA;